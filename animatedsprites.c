@@ -8,9 +8,11 @@
 
 #include <stdlib.h>
 
+#include "mem.h"
+
 struct animatedsprites* animatedsprites_create()
 {
-	struct animatedsprites* as = (struct animatedsprites*)malloc(sizeof(struct animatedsprites));
+	struct animatedsprites* as = (struct animatedsprites*)engine_malloc(MEM_GRAPHICS, sizeof(struct animatedsprites));
 	as->sprite_todraw_count = 0;
 	spritebatch_create(&as->spritebatch);
 	return as;
@@ -19,7 +21,7 @@ struct animatedsprites* animatedsprites_create()
 void animatedsprites_destroy(struct animatedsprites* animatedsprites)
 {
 	spritebatch_destroy(&animatedsprites->spritebatch);
-	free(animatedsprites);
+	engine_free(animatedsprites);
 }
 
 void animatedsprites_update(struct animatedsprites* animatedsprites, struct atlas* atlas, float delta_time)
@@ -59,21 +61,41 @@ void animatedsprites_update(struct animatedsprites* animatedsprites, struct atla
 			}
 		}
 
-		int index = current_sprite->state.frame_current;
+		const struct atlas_frame* frame = &atlas->frames[current_sprite->state.frame_current];
 
 		vec2 tex_pos;
-		tex_pos[0] = (atlas->frames[index].x) / (float)atlas->width;
-		tex_pos[1] = (atlas->frames[index].y) / (float)atlas->height;
+		tex_pos[0] = frame->uv[0];
+		tex_pos[1] = frame->uv[1];
 
 		vec2 tex_bounds;
-		tex_bounds[0] = (atlas->frames[index].width) / (float)atlas->width;
-		tex_bounds[1] = (atlas->frames[index].height) / (float)atlas->height;
+		tex_bounds[0] = frame->uv[2];
+		tex_bounds[1] = frame->uv[3];
 
 		vec2 scale;
-		scale[0] = atlas->frames[index].width * current_sprite->scale[0];
-		scale[1] = atlas->frames[index].height * current_sprite->scale[1];
+		scale[0] = frame->width * current_sprite->scale[0];
+		scale[1] = frame->height * current_sprite->scale[1];
+
+		/* Trimmed frames are smaller than the sprite, move them to where
+		 * they were cut from (offset is y down, the world y up). */
+		vec3 position;
+		position[0] = current_sprite->position[0] + frame->offset[0] * current_sprite->scale[0];
+		position[1] = current_sprite->position[1] - frame->offset[1] * current_sprite->scale[1];
+		position[2] = current_sprite->position[2];
 
-		spritebatch_add(&animatedsprites->spritebatch, current_sprite->position, scale, tex_pos, tex_bounds);
+		const struct atlas_hull* hull = atlas->hulls != NULL ? &atlas->hulls[current_sprite->state.frame_current] : NULL;
+
+		if (hull != NULL && hull->count > 0)
+		{
+			spritebatch_add_polygon(&animatedsprites->spritebatch, position, scale, tex_pos, tex_bounds, frame->rotated, hull->points, hull->count);
+		}
+		else if (frame->rotated)
+		{
+			spritebatch_add_rotated(&animatedsprites->spritebatch, position, scale, tex_pos, tex_bounds);
+		}
+		else
+		{
+			spritebatch_add(&animatedsprites->spritebatch, position, scale, tex_pos, tex_bounds);
+		}
 	}
 
 	spritebatch_end(&animatedsprites->spritebatch);
@@ -84,6 +106,15 @@ void animatedsprites_sort(struct animatedsprites* animatedsprites, spritebatch_s
 	spritebatch_sort(&animatedsprites->spritebatch, sorting_function);
 }
 
+/**
+ * Draw sprites whose frames have a hull (see struct atlas_hull) as polygons
+ * instead of quads, see spritebatch_set_polygons().
+ */
+void animatedsprites_set_polygons(struct animatedsprites* animatedsprites, int enabled)
+{
+	spritebatch_set_polygons(&animatedsprites->spritebatch, enabled);
+}
+
 void animatedsprites_render(struct animatedsprites* animatedsprites, struct shader *s, struct graphics *g, GLuint tex, mat4 transform)
 {
 	spritebatch_render(&animatedsprites->spritebatch, s, g, tex, transform);
@@ -56,6 +56,7 @@ void animatedsprites_render(struct animatedsprites* animatedsprites, struct shad
 void animatedsprites_add(struct animatedsprites* animatedsprites, struct sprite* sprite);
 void animatedsprites_clear(struct animatedsprites* animatedsprites);
 void animatedsprites_sort(struct animatedsprites* animatedsprites, spritebatch_sort_fn sorting_function);
+void animatedsprites_set_polygons(struct animatedsprites* animatedsprites, int enabled);
 
 void animatedsprites_setanim(struct anim* anim, int looping, int frame_start, int frame_count, float frame_length);
 
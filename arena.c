@@ -0,0 +1,126 @@
+/**
+ * Linear (bump) allocator for short-lived allocations.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+struct arena_overflow {
+	struct arena_overflow	*next;
+	size_t					size;
+};
+
+static uintptr_t arena_align_up(uintptr_t n, size_t align)
+{
+	return (n + align - 1) & ~((uintptr_t) align - 1);
+}
+
+/**
+ * @param arena	The arena to initialize.
+ * @param size	Size of the memory block to allocate from. If 0, every
+ *				allocation is an overflow allocation.
+ * @return		ARENA_OK on success, ARENA_ERROR if out of memory.
+ */
+int arena_init(struct arena *arena, size_t size)
+{
+	memset(arena, 0, sizeof(struct arena));
+
+	if(size == 0) {
+		return ARENA_OK;
+	}
+
+	arena->base = (char *) malloc(size);
+	if(arena->base == NULL) {
+		arena_error("Out of memory (%lu bytes)\n", (unsigned long) size);
+		return ARENA_ERROR;
+	}
+	arena->size = size;
+
+	return ARENA_OK;
+}
+
+void arena_free(struct arena *arena)
+{
+	arena_reset(arena);
+	free(arena->base);
+	arena->base = NULL;
+	arena->size = 0;
+}
+
+static void* arena_alloc_overflow(struct arena *arena, size_t size, size_t align)
+{
+	size_t header = arena_align_up(sizeof(struct arena_overflow), sizeof(void *));
+	struct arena_overflow *o = (struct arena_overflow *) malloc(header + align - 1 + size);
+	if(o == NULL) {
+		arena_error("Out of memory (%lu bytes)\n", (unsigned long) size);
+		return NULL;
+	}
+	o->next = arena->overflow;
+	o->size = size;
+	arena->overflow = o;
+	arena->overflow_used += size;
+	arena->overflow_count++;
+	return (void *) arena_align_up((uintptr_t) o + header, align);
+}
+
+/**
+ * Allocate memory from an arena. The memory is valid until the next call to
+ * arena_reset().
+ *
+ * @param size	The number of bytes to allocate.
+ * @param align	Alignment of the returned pointer. Must be a power of two.
+ * @return		A pointer to the allocated memory, or NULL if out of memory.
+ */
+void* arena_alloc(struct arena *arena, size_t size, size_t align)
+{
+	void *ptr = NULL;
+
+	if(align == 0) {
+		align = 1;
+	}
+
+	uintptr_t start = arena_align_up((uintptr_t) arena->base + arena->used, align);
+	size_t end = (start - (uintptr_t) arena->base) + size;
+
+	if(arena->base != NULL && end <= arena->size) {
+		ptr = (void *) start;
+		arena->used = end;
+	} else {
+		ptr = arena_alloc_overflow(arena, size, align);
+	}
+
+	size_t total = arena->used + arena->overflow_used;
+	if(total > arena->peak) {
+		arena->peak = total;
+	}
+
+	return ptr;
+}
+
+/**
+ * Release all allocations made from an arena.
+ */
+void arena_reset(struct arena *arena)
+{
+	struct arena_overflow *o = arena->overflow;
+	while(o != NULL) {
+		struct arena_overflow *next = o->next;
+		free(o);
+		o = next;
+	}
+	arena->overflow = NULL;
+	arena->overflow_used = 0;
+	arena->used = 0;
+}
+
+/**
+ * Reset the high-water mark and overflow counter.
+ */
+void arena_reset_stats(struct arena *arena)
+{
+	arena->peak = arena->used + arena->overflow_used;
+	arena->overflow_count = 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * Linear (bump) allocator for short-lived allocations.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdlib.h>
+
+#include "log.h"
+
+#define arena_debug(...) debugf("Arena", __VA_ARGS__)
+#define arena_error(...) errorf("Arena", __VA_ARGS__)
+
+#define ARENA_OK		0
+#define ARENA_ERROR		-1
+
+struct arena_overflow;
+
+/**
+ * Allocations are carved linearly from one block of memory and are all
+ * released at once by arena_reset(). When the block is full, allocations fall
+ * back to malloc() and are freed on the next reset.
+ */
+struct arena {
+	char					*base;				/* Start of the memory block. */
+	size_t					size;				/* Size of the memory block. */
+	size_t					used;				/* Bytes used in the memory block. */
+	size_t					overflow_used;		/* Bytes allocated in overflow blocks. */
+	size_t					overflow_count;		/* Number of overflow allocations since arena_reset_stats(). */
+	size_t					peak;				/* Highest used + overflow_used since arena_reset_stats(). */
+	struct arena_overflow	*overflow;			/* Overflow blocks to free on reset. */
+};
+
+int		arena_init(struct arena *arena, size_t size);
+void	arena_free(struct arena *arena);
+void*	arena_alloc(struct arena *arena, size_t size, size_t align);
+void	arena_reset(struct arena *arena);
+void	arena_reset_stats(struct arena *arena);
+
+#endif
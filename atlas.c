@@ -4,162 +4,930 @@
  * Specifically, will parse JSON as outputted by TexturePacker when "Data
  * Format" is set to "JSON (Array)".
  *
- * The parsing is slimmed down by default, to parse _all_ the information define
- * ATLAS_FATTY.
+ * The JSON is compiled into a single blob (see cook.h) holding the frames with
+ * precomputed texture coordinates, the rest of the frame data, a string pool
+ * and a hash table of frame names. generate_assets stores atlases compiled in
+ * assets.pack, so loading them is a copy; JSON atlases, like the ones hot
+ * reloaded during development, are compiled when they are loaded.
+ *
+ * The JSON is read twice with the streaming reader (see json.h): once to size
+ * the blob, and once to fill it in.
  *
  * Author: Tim Sjöstrand <tim.sjostrand@gmail.com>
  */
 
 #include <stdlib.h>
 #include <string.h>
-#include <cjson/cJSON.h>
+#include <math.h>
 
 #include "atlas.h"
+#include "cook.h"
+#include "hash.h"
+#include "json.h"
 #include "str.h"
+#include "mem.h"
+
+/* Hulls have to save at least 1 / ATLAS_HULL_MIN_SAVING of the quad to be
+ * worth the extra triangles. */
+#define ATLAS_HULL_MIN_SAVING	8
+
+/* A frame as read from the JSON. */
+struct atlas_json_frame {
+	int					x;
+	int					y;
+	int					width;
+	int					height;
+	int					rotated;
+	int					trimmed;
+	int					source_x;		/* "spriteSourceSize", the frame if not trimmed. */
+	int					source_y;
+	int					source_width;	/* "sourceSize", the frame if not trimmed. */
+	int					source_height;
+	struct json_token	name;
+};
+
+/* Everything but the frames, as read from the JSON. */
+struct atlas_json {
+	struct json_token	image;
+	struct json_token	format;
+	int					width;
+	int					height;
+	int					frames_count;	/* Frames read so far. */
+	size_t				names_size;		/* Decoded size of the frame names read so far, \0 included. */
+};
+
+typedef int (*atlas_frame_fn)(const struct atlas_json *atlas, const struct atlas_json_frame *frame, void *userdata);
 
-static int atlas_parse_str(char *dst, cJSON *item, const char *key);
-static int atlas_parse_int(int *dst, cJSON *item, const char *key);
+/* A compiled atlas being filled in. */
+struct atlas_compiler {
+	struct cook_atlas_header	header;
+	struct atlas_frame			*frames;
+	struct atlas_frame_info		*info;
+	uint32_t					*index;
+	char						*names;
+	uint32_t					names_capacity;
+};
 
-static int atlas_parse_str(char *dst, cJSON *item, const char *key)
+void atlas_print(struct atlas *atlas)
 {
-	if(item == NULL) {
-		atlas_error("item == NULL\n");
+	printf("====\n");
+	printf("image:        %32s\n", atlas->image);
+	printf("format:       %32s\n", atlas->format);
+	printf("width:        % 32d\n", atlas->width);
+	printf("height:       % 32d\n", atlas->height);
+	printf("frames_count: % 32d\n", atlas->frames_count);
+	if(atlas->frames_count > 0) {
+		printf("first frame:  % 8d% 8d% 8d% 8d\n",
+				atlas->frames[0].x,
+				atlas->frames[0].y,
+				atlas->frames[0].width,
+				atlas->frames[0].height);
+		printf("last frame:   % 8d% 8d% 8d% 8d\n",
+				atlas->frames[atlas->frames_count-1].x,
+				atlas->frames[atlas->frames_count-1].y,
+				atlas->frames[atlas->frames_count-1].width,
+				atlas->frames[atlas->frames_count-1].height);
+	}
+	printf("====\n");
+}
+
+static int atlas_read_int(int *dst, const struct json_token *value, const char *key)
+{
+	if(value->type == JSON_NUMBER) {
+		*dst = (int) value->number;
+	} else if(value->type == JSON_TRUE || value->type == JSON_FALSE) {
+		*dst = (value->type == JSON_TRUE);
+	} else {
+		atlas_error("Value \"%s\" type != number (%d)\n", key, value->type);
 		return ATLAS_ERROR;
 	}
-	cJSON *value = cJSON_GetObjectItem(item, key);
-	if(value == NULL) {
+	return ATLAS_OK;
+}
+
+static int atlas_read_str(struct json_token *dst, const struct json_token *value, const char *key)
+{
+	if(value->type != JSON_STRING) {
+		atlas_error("Value \"%s\" type != string (%d)\n", key, value->type);
+		return ATLAS_ERROR;
+	}
+	if(json_string(value, NULL, 0) >= ATLAS_STR_MAX) {
+		atlas_error("Value \"%s\" too long\n", key);
+		return ATLAS_ERROR;
+	}
+	(*dst) = (*value);
+	return ATLAS_OK;
+}
+
+static int atlas_require(int found, const char *key)
+{
+	if(!found) {
 		atlas_error("Invalid key \"%s\"\n", key);
 		return ATLAS_ERROR;
 	}
-	if(value->type != cJSON_String) {
-		atlas_error("Value \"%s\" type != string (%d)\n", key, value->type);
+	return ATLAS_OK;
+}
+
+#define ATLAS_TRY(e) if((e) != ATLAS_OK) return ATLAS_ERROR
+
+/**
+ * Read a {"x": 0, "y": 0, "w": 16, "h": 16} leaf. Keys with a NULL
+ * destination are not required.
+ */
+static int atlas_read_rect(struct json_reader *r, const struct json_token *value, const char *key,
+		int *x, int *y, int *w, int *h)
+{
+	const char *keys[4] = { "x", "y", "w", "h" };
+	int *dst[4] = { x, y, w, h };
+	int found[4] = { 0 };
+	struct json_token k, v;
+	int ret;
+
+	if(value->type != JSON_OBJECT) {
+		atlas_error("Value \"%s\" type != object (%d)\n", key, value->type);
+		return ATLAS_ERROR;
+	}
+
+	while((ret = json_object_next(r, &k)) > 0) {
+		int i = 0;
+		json_next(r, &v);
+		while(i < 4 && (dst[i] == NULL || !json_equals(&k, keys[i]))) {
+			i++;
+		}
+		if(i < 4) {
+			ATLAS_TRY(atlas_read_int(dst[i], &v, keys[i]));
+			found[i] = 1;
+		} else if(json_skip(r, &v) != JSON_OK) {
+			return ATLAS_ERROR;
+		}
+	}
+	if(ret < 0) {
 		return ATLAS_ERROR;
 	}
-	strncpy(dst, value->valuestring, ATLAS_STR_MAX);
+
+	for(int i=0; i<4; i++) {
+		if(dst[i] != NULL) {
+			ATLAS_TRY(atlas_require(found[i], keys[i]));
+		}
+	}
 	return ATLAS_OK;
 }
 
-static int atlas_parse_int(int *dst, cJSON *item, const char *key)
+static int atlas_read_frame(struct json_reader *r, const struct json_token *value, struct atlas_json_frame *f)
 {
-	if(item == NULL) {
-		atlas_error("item == NULL\n");
+	struct json_token k, v;
+	int found_name = 0, found_frame = 0, found_rotated = 0, found_trimmed = 0;
+	int found_source = 0, found_source_size = 0;
+	int ret;
+
+	if(value->type != JSON_OBJECT) {
+		atlas_error("Frame type != object (%d)\n", value->type);
 		return ATLAS_ERROR;
 	}
-	cJSON *value = cJSON_GetObjectItem(item, key);
-	if(value == NULL) {
-		atlas_error("Invalid key \"%s\"\n", key);
+
+	while((ret = json_object_next(r, &k)) > 0) {
+		json_next(r, &v);
+		if(json_equals(&k, "filename")) {
+			ATLAS_TRY(atlas_read_str(&f->name, &v, "filename"));
+			found_name = 1;
+		} else if(json_equals(&k, "frame")) {
+			ATLAS_TRY(atlas_read_rect(r, &v, "frame", &f->x, &f->y, &f->width, &f->height));
+			found_frame = 1;
+		} else if(json_equals(&k, "rotated")) {
+			ATLAS_TRY(atlas_read_int(&f->rotated, &v, "rotated"));
+			found_rotated = 1;
+		} else if(json_equals(&k, "trimmed")) {
+			ATLAS_TRY(atlas_read_int(&f->trimmed, &v, "trimmed"));
+			found_trimmed = 1;
+		} else if(json_equals(&k, "spriteSourceSize")) {
+			ATLAS_TRY(atlas_read_rect(r, &v, "spriteSourceSize", &f->source_x, &f->source_y, NULL, NULL));
+			found_source = 1;
+		} else if(json_equals(&k, "sourceSize")) {
+			ATLAS_TRY(atlas_read_rect(r, &v, "sourceSize", NULL, NULL, &f->source_width, &f->source_height));
+			found_source_size = 1;
+		} else if(json_skip(r, &v) != JSON_OK) {
+			return ATLAS_ERROR;
+		}
+	}
+	if(ret < 0) {
 		return ATLAS_ERROR;
 	}
-	if(value->type != cJSON_Number
-			&& value->type != cJSON_False
-			&& value->type != cJSON_True) {
-		atlas_error("Value \"%s\" type != number (%d)\n", key, value->type);
+
+	ATLAS_TRY(atlas_require(found_frame, "frame"));
+	ATLAS_TRY(atlas_require(found_rotated, "rotated"));
+	ATLAS_TRY(atlas_require(found_trimmed, "trimmed"));
+	ATLAS_TRY(atlas_require(found_name, "filename"));
+
+	/* Untrimmed frames may leave out their source. */
+	if(!found_source) {
+		f->source_x = 0;
+		f->source_y = 0;
+	}
+	if(!found_source_size) {
+		f->source_width = f->source_x + f->width;
+		f->source_height = f->source_y + f->height;
+	}
+	return ATLAS_OK;
+}
+
+static int atlas_read_meta(struct json_reader *r, const struct json_token *value, struct atlas_json *atlas)
+{
+	struct json_token k, v;
+	int found_image = 0, found_format = 0, found_size = 0;
+	int ret;
+
+	if(value->type != JSON_OBJECT) {
+		atlas_error("Value \"meta\" type != object (%d)\n", value->type);
+		return ATLAS_ERROR;
+	}
+
+	while((ret = json_object_next(r, &k)) > 0) {
+		json_next(r, &v);
+		if(json_equals(&k, "image")) {
+			ATLAS_TRY(atlas_read_str(&atlas->image, &v, "image"));
+			found_image = 1;
+		} else if(json_equals(&k, "format")) {
+			ATLAS_TRY(atlas_read_str(&atlas->format, &v, "format"));
+			found_format = 1;
+		} else if(json_equals(&k, "size")) {
+			ATLAS_TRY(atlas_read_rect(r, &v, "size", NULL, NULL, &atlas->width, &atlas->height));
+			found_size = 1;
+		} else if(json_skip(r, &v) != JSON_OK) {
+			return ATLAS_ERROR;
+		}
+	}
+	if(ret < 0) {
 		return ATLAS_ERROR;
 	}
-	*dst = value->valueint;
+
+	ATLAS_TRY(atlas_require(found_image, "image"));
+	ATLAS_TRY(atlas_require(found_format, "format"));
+	ATLAS_TRY(atlas_require(found_size, "size"));
 	return ATLAS_OK;
 }
 
-void atlas_print(struct atlas *atlas)
+/**
+ * Read a whole JSON atlas, handing each frame to fn (if not NULL) as soon as it
+ * is read. Frames may come before "meta", so fn can not rely on it.
+ */
+static int atlas_read(const void *json, size_t json_len, struct atlas_json *atlas,
+		atlas_frame_fn fn, void *userdata)
 {
-	printf("====\n");
-	printf("image:        %32s\n", atlas->image);
-	printf("format:       %32s\n", atlas->format);
-	printf("width:        % 32d\n", atlas->width);
-	printf("height:       % 32d\n", atlas->height);
-	printf("frames_count: % 32d\n", atlas->frames_count);
-	printf("first frame:  % 8d% 8d% 8d% 8d\n",
-			atlas->frames[0].x,
-			atlas->frames[0].y,
-			atlas->frames[0].width,
-			atlas->frames[0].height);
-	printf("last frame:   % 8d% 8d% 8d% 8d\n",
-			atlas->frames[atlas->frames_count-1].x,
-			atlas->frames[atlas->frames_count-1].y,
-			atlas->frames[atlas->frames_count-1].width,
-			atlas->frames[atlas->frames_count-1].height);
-	printf("====\n");
+	struct json_reader r;
+	struct json_token k, v;
+	int found_frames = 0, found_meta = 0;
+	int ret;
+
+	memset(atlas, 0, sizeof(struct atlas_json));
+	json_init(&r, json, json_len);
+
+	if(json_next(&r, &v) != JSON_OBJECT) {
+		atlas_error("Atlas is not a JSON object\n");
+		return ATLAS_ERROR;
+	}
+
+	while((ret = json_object_next(&r, &k)) > 0) {
+		json_next(&r, &v);
+		if(json_equals(&k, "frames") && v.type == JSON_ARRAY) {
+			while((ret = json_array_next(&r, &v)) > 0) {
+				struct atlas_json_frame frame = { 0 };
+				ATLAS_TRY(atlas_read_frame(&r, &v, &frame));
+				if(fn != NULL) {
+					ATLAS_TRY(fn(atlas, &frame, userdata));
+				}
+				atlas->frames_count++;
+				atlas->names_size += json_string(&frame.name, NULL, 0) + 1;
+			}
+			if(ret < 0) {
+				return ATLAS_ERROR;
+			}
+			found_frames = 1;
+		} else if(json_equals(&k, "meta")) {
+			ATLAS_TRY(atlas_read_meta(&r, &v, atlas));
+			found_meta = 1;
+		} else if(json_skip(&r, &v) != JSON_OK) {
+			return ATLAS_ERROR;
+		}
+	}
+	if(ret < 0 || json_next(&r, &v) != JSON_END) {
+		return ATLAS_ERROR;
+	}
+
+	ATLAS_TRY(atlas_require(found_frames, "frames"));
+	ATLAS_TRY(atlas_require(found_meta, "meta"));
+
+	if(atlas->width <= 0 || atlas->height <= 0) {
+		atlas_error("Invalid size %dx%d\n", atlas->width, atlas->height);
+		return ATLAS_ERROR;
+	}
+
+	return ATLAS_OK;
 }
 
-#define ATLAS_TRY(e) if((ret = e) != ATLAS_OK) goto bail
+/**
+ * Size of the hash table for the given number of frames: a power of two, at
+ * most half full.
+ */
+static uint32_t atlas_index_size(uint32_t frames_count)
+{
+	uint32_t size = 2;
+	while(size < frames_count * 2) {
+		size *= 2;
+	}
+	return size;
+}
 
-int atlas_load(struct atlas *atlas, void *data, size_t data_len)
+static size_t atlas_blob_size(const struct cook_atlas_header *header)
 {
-	int ret = 0;
+	return sizeof(struct cook_atlas_header)
+		+ (size_t) header->frames_count * (sizeof(struct atlas_frame) + sizeof(struct atlas_frame_info))
+		+ (size_t) header->index_size * sizeof(uint32_t)
+		+ (header->hulls ? (size_t) header->frames_count * sizeof(struct atlas_hull) : 0)
+		+ header->names_size;
+}
 
-	/* FIXME: isn't there a parse(data,len)? */
-	cJSON *root = cJSON_Parse(data);
-	cJSON *meta = cJSON_GetObjectItem(root, "meta");
-	cJSON *frames = cJSON_GetObjectItem(root, "frames");
+/**
+ * Decode a string into the pool being built.
+ *
+ * @return The offset of the string in the pool.
+ */
+static uint32_t atlas_add_name(struct atlas_compiler *c, const struct json_token *s)
+{
+	uint32_t offset = c->header.names_size;
+	size_t len = json_string(s, c->names + offset, c->names_capacity - offset);
+	c->header.names_size += (uint32_t) len + 1;
+	return offset;
+}
 
-	/* Parse atlas meta information. */
-	ATLAS_TRY(atlas_parse_str(atlas->image, meta, "image"));
-	ATLAS_TRY(atlas_parse_str(atlas->format, meta, "format"));
+/**
+ * Copy a \0 terminated string into the pool being built.
+ *
+ * @return The offset of the string in the pool.
+ */
+static uint32_t atlas_add_str(struct atlas_compiler *c, const char *s)
+{
+	uint32_t offset = c->header.names_size;
+	size_t len = strlen(s);
+	memcpy(c->names + offset, s, len + 1);
+	c->header.names_size += (uint32_t) len + 1;
+	return offset;
+}
 
-	/* "meta.size" leaf. */
-	cJSON *meta_size = cJSON_GetObjectItem(meta, "size");
-	ATLAS_TRY(atlas_parse_int(&atlas->width, meta_size, "w"));
-	ATLAS_TRY(atlas_parse_int(&atlas->height, meta_size, "h"));
+/**
+ * Allocate the blob for c->header (names_size being the full size of the
+ * string pool) and point the compiler into it. The pool is then filled from
+ * the start again.
+ */
+static char* atlas_compiler_alloc(struct atlas_compiler *c)
+{
+	c->header.magic = COOK_ATLAS_MAGIC;
+	c->header.version = COOK_ATLAS_VERSION;
+	c->header.index_size = atlas_index_size(c->header.frames_count);
+
+	char *data = (char *) engine_calloc(MEM_GRAPHICS, 1, atlas_blob_size(&c->header));
+	if(data == NULL) {
+		atlas_error("Out of memory\n");
+		return NULL;
+	}
+
+	c->frames = (struct atlas_frame *) (data + sizeof(struct cook_atlas_header));
+	c->info = (struct atlas_frame_info *) (c->frames + c->header.frames_count);
+	c->index = (uint32_t *) (c->info + c->header.frames_count);
+	c->names = (char *) (c->index + c->header.index_size);
+	c->names_capacity = c->header.names_size;
+	c->header.names_size = 0;
+
+	return data;
+}
+
+/**
+ * Fill in frame i, whose name has already been added to the pool.
+ */
+static void atlas_compiler_add(struct atlas_compiler *c, int i, const struct atlas_json_frame *frame,
+		uint32_t name_offset)
+{
+	/* Rotated frames take up height * width in the image. */
+	int region_width = frame->rotated ? frame->height : frame->width;
+	int region_height = frame->rotated ? frame->width : frame->height;
 
-	/* Count elements in "frames" array. */
-	atlas->frames_count = cJSON_GetArraySize(frames);
+	struct atlas_frame *f = &c->frames[i];
+	f->x = frame->x;
+	f->y = frame->y;
+	f->width = frame->width;
+	f->height = frame->height;
+	f->uv[0] = frame->x / (float) c->header.width;
+	f->uv[1] = frame->y / (float) c->header.height;
+	f->uv[2] = region_width / (float) c->header.width;
+	f->uv[3] = region_height / (float) c->header.height;
+	f->offset[0] = frame->source_x + frame->width * 0.5f - frame->source_width * 0.5f;
+	f->offset[1] = frame->source_y + frame->height * 0.5f - frame->source_height * 0.5f;
+	f->rotated = frame->rotated;
 
-#ifdef ATLAS_FATTY
-	ATLAS_TRY(atlas_parse_str(atlas->scale, meta, "scale"));
-	ATLAS_TRY(atlas_parse_str(atlas->generator, meta, "app"));
-	ATLAS_TRY(atlas_parse_str(atlas->generator_version, meta, "version"));
-#endif
+	struct atlas_frame_info *fi = &c->info[i];
+	fi->trimmed = frame->trimmed;
+	fi->source_x = frame->source_x;
+	fi->source_y = frame->source_y;
+	fi->source_width = frame->source_width;
+	fi->source_height = frame->source_height;
+	fi->name = name_offset;
 
-	/* Parse frames. */
-	atlas->frames = (struct atlas_frame *) calloc(atlas->frames_count, sizeof(struct atlas_frame));
+	/* Index the frame, the first one wins if names repeat. */
+	const char *name = c->names + fi->name;
+	uint32_t mask = c->header.index_size - 1;
+	uint32_t slot = hash_fnv1a_str(name) & mask;
+	while(c->index[slot] != 0 && !str_equals(c->names + c->info[c->index[slot] - 1].name, name)) {
+		slot = (slot + 1) & mask;
+	}
+	if(c->index[slot] == 0) {
+		c->index[slot] = i + 1;
+	}
+}
+
+static int atlas_compile_frame(const struct atlas_json *atlas, const struct atlas_json_frame *frame, void *userdata)
+{
+	struct atlas_compiler *c = (struct atlas_compiler *) userdata;
+	int i = atlas->frames_count;
 
-	if(atlas->frames == NULL) {
+	if(i >= (int) c->header.frames_count) {
+		atlas_error("Frame count mismatch\n");
 		return ATLAS_ERROR;
 	}
 
-	for(int i=0; i<atlas->frames_count; i++) {
-		struct atlas_frame *f = &(atlas->frames[i]);
+	atlas_compiler_add(c, i, frame, atlas_add_name(c, &frame->name));
+	return ATLAS_OK;
+}
 
-		/* Iterate JSON array. */
-		cJSON *elem = cJSON_GetArrayItem(frames, i);
+/**
+ * Compile a JSON atlas into the format loaded by atlas_load() (see cook.h).
+ *
+ * @param json		TexturePacker JSON (Array), does not need to be \0
+ *					terminated.
+ * @param blob		Set to the compiled atlas, to be released with
+ *					engine_free().
+ * @param blob_size	Set to the size of blob.
+ * @return			ATLAS_OK on success, ATLAS_ERROR if the JSON is not a valid
+ *					atlas.
+ */
+int atlas_compile(const void *json, size_t json_len, void **blob, size_t *blob_size)
+{
+	struct atlas_json atlas;
+	struct atlas_compiler c = { 0 };
 
-		/* "frame" leaf. */
-		cJSON *elem_frame = cJSON_GetObjectItem(elem, "frame");
-		ATLAS_TRY(atlas_parse_int(&f->x, elem_frame, "x"));
-		ATLAS_TRY(atlas_parse_int(&f->y, elem_frame, "y"));
-		ATLAS_TRY(atlas_parse_int(&f->width, elem_frame, "w"));
-		ATLAS_TRY(atlas_parse_int(&f->height, elem_frame, "h"));
+	/* First pass: size the blob. */
+	ATLAS_TRY(atlas_read(json, json_len, &atlas, NULL, NULL));
 
-		/* Rest of params. */
-		ATLAS_TRY(atlas_parse_int(&f->rotated, elem, "rotated"));
-		ATLAS_TRY(atlas_parse_int(&f->trimmed, elem, "trimmed"));
+	c.header.width = atlas.width;
+	c.header.height = atlas.height;
+	c.header.frames_count = atlas.frames_count;
+	c.header.names_size = (uint32_t) (json_string(&atlas.image, NULL, 0) + 1
+		+ json_string(&atlas.format, NULL, 0) + 1
+		+ atlas.names_size);
 
-		ATLAS_TRY(atlas_parse_str(f->name, elem, "filename"));
+	char *data = atlas_compiler_alloc(&c);
+	if(data == NULL) {
+		return ATLAS_ERROR;
+	}
 
-#ifdef ATLAS_FATTY
-		/* "sourceSize" leaf. */
-		cJSON *elem_src = cJSON_GetObjectItem(elem, "sourceSize");
-		ATLAS_TRY(atlas_parse_int(&f->src_size_w, elem_src, "w"));
-		ATLAS_TRY(atlas_parse_int(&f->src_size_h, elem_src, "h"));
+	c.header.image = atlas_add_name(&c, &atlas.image);
+	c.header.format = atlas_add_name(&c, &atlas.format);
 
-		/* "spriteSourceSize" leaf. */
-		cJSON *elem_sprite_src = cJSON_GetObjectItem(elem, "spriteSourceSize");
-		ATLAS_TRY(atlas_parse_int(&f->sprite_src_x, elem_sprite_src, "x"));
-		ATLAS_TRY(atlas_parse_int(&f->sprite_src_y, elem_sprite_src, "y"));
-		ATLAS_TRY(atlas_parse_int(&f->sprite_src_w, elem_sprite_src, "w"));
-		ATLAS_TRY(atlas_parse_int(&f->sprite_src_h, elem_sprite_src, "h"));
-#endif
+	/* Second pass: fill in the frames. */
+	if(atlas_read(json, json_len, &atlas, atlas_compile_frame, &c) != ATLAS_OK) {
+		engine_free(data);
+		return ATLAS_ERROR;
 	}
 
-	/* Clean up. */
-	cJSON_Delete(root);
+	memcpy(data, &c.header, sizeof(struct cook_atlas_header));
 
+	*blob = data;
+	*blob_size = atlas_blob_size(&c.header);
+	return ATLAS_OK;
+}
+
+static double atlas_cross(const double o[2], const double a[2], const double b[2])
+{
+	return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+static int atlas_point_cmp(const void *a, const void *b)
+{
+	const double *pa = (const double *) a;
+	const double *pb = (const double *) b;
+	if(pa[0] != pb[0]) {
+		return pa[0] < pb[0] ? -1 : 1;
+	}
+	if(pa[1] != pb[1]) {
+		return pa[1] < pb[1] ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * Convex hull of points (Andrew's monotone chain), replacing points.
+ *
+ * @return The number of points on the hull.
+ */
+static int atlas_convex_hull(double (*points)[2], int count, double (*tmp)[2])
+{
+	int n = 0;
+
+	if(count < 3) {
+		return count;
+	}
+	qsort(points, count, sizeof(points[0]), atlas_point_cmp);
+
+	/* Lower hull, then upper hull. */
+	for(int i=0; i<count; i++) {
+		while(n >= 2 && atlas_cross(tmp[n-2], tmp[n-1], points[i]) <= 0) {
+			n--;
+		}
+		memcpy(tmp[n++], points[i], sizeof(points[0]));
+	}
+	for(int i=count-2, lower=n+1; i>=0; i--) {
+		while(n >= lower && atlas_cross(tmp[n-2], tmp[n-1], points[i]) <= 0) {
+			n--;
+		}
+		memcpy(tmp[n++], points[i], sizeof(points[0]));
+	}
+	n--;	/* The first point is repeated last. */
+
+	memcpy(points, tmp, n * sizeof(points[0]));
+	return n;
+}
+
+/**
+ * Remove edges from a convex polygon until it has at most max points, by
+ * extending the edges on both sides of the removed one until they meet. The
+ * polygon only grows, and never past width * height.
+ *
+ * @return The number of points left, or -1 if it can not be reduced.
+ */
+static int atlas_hull_reduce(double (*p)[2], int n, int max, double width, double height)
+{
+	while(n > max) {
+		int best = -1;
+		double best_area = 0.0;
+		double best_point[2] = { 0.0, 0.0 };
+
+		for(int i=0; i<n; i++) {
+			const double *prev = p[(i + n - 1) % n];
+			const double *a = p[i];
+			const double *b = p[(i + 1) % n];
+			const double *next = p[(i + 2) % n];
+			double d1[2] = { a[0] - prev[0], a[1] - prev[1] };
+			double d2[2] = { b[0] - next[0], b[1] - next[1] };
+			double ab[2] = { b[0] - a[0], b[1] - a[1] };
+			double denom = d1[0] * d2[1] - d1[1] * d2[0];
+			if(denom > -1e-9 && denom < 1e-9) {
+				continue;
+			}
+			/* a + t * d1 == b + s * d2, both rays pointing away from the edge. */
+			double t = (ab[0] * d2[1] - ab[1] * d2[0]) / denom;
+			double s = (ab[0] * d1[1] - ab[1] * d1[0]) / denom;
+			if(t <= 0.0 || s <= 0.0) {
+				continue;
+			}
+			double q[2] = { a[0] + t * d1[0], a[1] + t * d1[1] };
+			if(q[0] < -1e-6 || q[0] > width + 1e-6 || q[1] < -1e-6 || q[1] > height + 1e-6) {
+				continue;
+			}
+			double area = 0.5 * fabs(atlas_cross(a, b, q));
+			if(best < 0 || area < best_area) {
+				best = i;
+				best_area = area;
+				best_point[0] = q[0];
+				best_point[1] = q[1];
+			}
+		}
+		if(best < 0) {
+			return -1;
+		}
+
+		/* Replace the edge ends with the point where the neighbours meet. */
+		int b = (best + 1) % n;
+		memcpy(p[best], best_point, sizeof(best_point));
+		memmove(p[b], p[b + 1], (n - b - 1) * sizeof(p[0]));
+		n--;
+	}
+	return n;
+}
+
+/**
+ * Trace the hull of the pixels of a frame with non-zero alpha.
+ */
+static int atlas_hull_trace(struct atlas_hull *hull, const struct atlas_frame *f,
+		const uint8_t *pixels, int width, int height)
+{
+	/* Rotated frames are height wide and width high in the image. */
+	int region_width = f->rotated ? f->height : f->width;
+	int region_height = f->rotated ? f->width : f->height;
+
+	memset(hull, 0, sizeof(struct atlas_hull));
+	if(f->x < 0 || f->y < 0 || f->width <= 0 || f->height <= 0
+			|| f->x + region_width > width || f->y + region_height > height) {
+		return ATLAS_OK;
+	}
+
+	/* Four points per row, and room for the hull of them (one more). */
+	double (*points)[2] = (double (*)[2]) engine_malloc(MEM_GRAPHICS, ((size_t) region_height * 8 + 1) * sizeof(double[2]));
+	if(points == NULL) {
+		atlas_error("Out of memory\n");
+		return ATLAS_ERROR;
+	}
+	double (*tmp)[2] = points + (size_t) region_height * 4;
+
+	/* The corners of the first and last opaque pixel of each row. */
+	int n = 0;
+	for(int y=0; y<region_height; y++) {
+		const uint8_t *row = pixels + ((size_t) (f->y + y) * width + f->x) * 4;
+		int left = 0, right = region_width - 1;
+		while(left < region_width && row[left * 4 + 3] == 0) {
+			left++;
+		}
+		if(left == region_width) {
+			continue;
+		}
+		while(row[right * 4 + 3] == 0) {
+			right--;
+		}
+		const int xs[4] = { left, left, right + 1, right + 1 };
+		for(int i=0; i<4; i++) {
+			int py = y + (i & 1);
+			/* To sprite pixels: rotated frames are turned clockwise. */
+			points[n][0] = f->rotated ? py : xs[i];
+			points[n][1] = f->rotated ? region_width - xs[i] : py;
+			n++;
+		}
+	}
+
+	n = atlas_convex_hull(points, n, tmp);
+	n = atlas_hull_reduce(points, n, ATLAS_HULL_MAX, f->width, f->height);
+
+	/* Leave frames that are (nearly) all opaque or all transparent as quads. */
+	if(n >= 3) {
+		hull->count = n;
+		for(int i=0; i<n; i++) {
+			double x = points[i][0] / f->width;
+			double y = points[i][1] / f->height;
+			hull->points[i][0] = (float) (x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x));
+			hull->points[i][1] = (float) (y < 0.0 ? 0.0 : (y > 1.0 ? 1.0 : y));
+		}
+		if(atlas_hull_area(hull) > 1.0f - 1.0f / ATLAS_HULL_MIN_SAVING) {
+			hull->count = 0;
+		}
+	}
+
+	engine_free(points);
+	return ATLAS_OK;
+}
+
+/**
+ * @return The area of a hull as a fraction of its frame, 1 if it has no hull.
+ */
+float atlas_hull_area(const struct atlas_hull *hull)
+{
+	if(hull == NULL || hull->count < 3) {
+		return 1.0f;
+	}
+	float area = 0.0f;
+	for(uint32_t i=0; i<hull->count; i++) {
+		const float *a = hull->points[i];
+		const float *b = hull->points[(i + 1) % hull->count];
+		area += a[0] * b[1] - b[0] * a[1];
+	}
+	return fabsf(area) * 0.5f;
+}
+
+/**
+ * Add the hull of every frame (see struct atlas_hull) to a compiled atlas,
+ * tracing the alpha of the atlas image.
+ *
+ * @param blob		A compiled atlas from atlas_compile(), replaced on success.
+ * @param pixels	The atlas image, width * height RGBA.
+ * @return			ATLAS_OK on success, ATLAS_ERROR if the image does not match
+ *					the atlas.
+ */
+int atlas_add_hulls(void **blob, size_t *blob_size, const uint8_t *pixels, int width, int height)
+{
+	struct atlas atlas;
+
+	if(atlas_load(&atlas, *blob, *blob_size) != ATLAS_OK) {
+		return ATLAS_ERROR;
+	}
+	if(atlas.width != width || atlas.height != height) {
+		atlas_error("Image is %dx%d, atlas is %dx%d\n", width, height, atlas.width, atlas.height);
+		atlas_free(&atlas);
+		return ATLAS_ERROR;
+	}
+
+	struct cook_atlas_header header = *(const struct cook_atlas_header *) atlas.blob;
+	header.hulls = 1;
+	size_t size = atlas_blob_size(&header);
+	char *data = (char *) engine_malloc(MEM_GRAPHICS, size);
+	if(data == NULL) {
+		atlas_error("Out of memory\n");
+		atlas_free(&atlas);
+		return ATLAS_ERROR;
+	}
+
+	/* Everything up to the hulls is unchanged, the names move past them. */
+	size_t head = (const char *) (atlas.index + atlas.index_size) - (const char *) atlas.blob;
+	memcpy(data, atlas.blob, head);
+	memcpy(data, &header, sizeof(header));
+	struct atlas_hull *hulls = (struct atlas_hull *) (data + head);
+	memcpy(hulls + atlas.frames_count, atlas.names, header.names_size);
+
+	for(int i=0; i<atlas.frames_count; i++) {
+		if(atlas_hull_trace(&hulls[i], &atlas.frames[i], pixels, width, height) != ATLAS_OK) {
+			engine_free(data);
+			atlas_free(&atlas);
+			return ATLAS_ERROR;
+		}
+	}
+
+	atlas_free(&atlas);
+	engine_free(*blob);
+	*blob = data;
+	*blob_size = size;
+	return ATLAS_OK;
+}
+
+/**
+ * @return 1 if data is a compiled atlas (see cook.h), 0 otherwise.
+ */
+int atlas_is_compiled(const void *data, size_t data_len)
+{
+	const struct cook_atlas_header *header = (const struct cook_atlas_header *) data;
+	return data_len >= sizeof(struct cook_atlas_header)
+		&& header->magic == COOK_ATLAS_MAGIC;
+}
+
+/**
+ * Point an atlas into a compiled blob, taking ownership of it.
+ */
+static int atlas_attach(struct atlas *atlas, void *blob, size_t blob_size)
+{
+	const struct cook_atlas_header *header = (const struct cook_atlas_header *) blob;
+
+	if(header->version != COOK_ATLAS_VERSION) {
+		atlas_error("Unsupported version %u\n", header->version);
+		goto bail;
+	}
+	if(header->frames_count > blob_size / (sizeof(struct atlas_frame) + sizeof(struct atlas_frame_info))
+			|| header->index_size > blob_size / sizeof(uint32_t)
+			|| header->names_size > blob_size
+			|| header->index_size == 0
+			|| (header->index_size & (header->index_size - 1)) != 0
+			|| header->index_size <= header->frames_count
+			|| header->names_size == 0
+			|| header->hulls > 1
+			|| atlas_blob_size(header) != blob_size) {
+		atlas_error("Corrupt atlas (%lu bytes)\n", (unsigned long) blob_size);
+		goto bail;
+	}
+
+	char *data = (char *) blob;
+	atlas->frames = (struct atlas_frame *) (data + sizeof(struct cook_atlas_header));
+	atlas->info = (const struct atlas_frame_info *) (atlas->frames + header->frames_count);
+	atlas->index = (const uint32_t *) (atlas->info + header->frames_count);
+	atlas->hulls = header->hulls ? (const struct atlas_hull *) (atlas->index + header->index_size) : NULL;
+	atlas->names = atlas->hulls ? (const char *) (atlas->hulls + header->frames_count)
+		: (const char *) (atlas->index + header->index_size);
+
+	/* Keep every lookup inside the blob. */
+	if(atlas->names[header->names_size - 1] != '\0'
+			|| header->image >= header->names_size
+			|| header->format >= header->names_size) {
+		atlas_error("Corrupt atlas string pool\n");
+		goto bail;
+	}
+	for(uint32_t i=0; i<header->frames_count; i++) {
+		if(atlas->info[i].name >= header->names_size) {
+			atlas_error("Corrupt atlas frame %u\n", i);
+			goto bail;
+		}
+	}
+	/* Lookups probe until an empty slot, so there must be one: at most one
+	 * slot per frame, and index_size > frames_count. */
+	uint32_t used = 0;
+	for(uint32_t i=0; i<header->index_size; i++) {
+		if(atlas->index[i] > header->frames_count) {
+			atlas_error("Corrupt atlas index\n");
+			goto bail;
+		}
+		used += (atlas->index[i] != 0);
+	}
+	if(used > header->frames_count) {
+		atlas_error("Corrupt atlas index\n");
+		goto bail;
+	}
+	for(uint32_t i=0; atlas->hulls != NULL && i<header->frames_count; i++) {
+		const struct atlas_hull *hull = &atlas->hulls[i];
+		int ok = hull->count <= ATLAS_HULL_MAX && hull->count != 1 && hull->count != 2;
+		for(uint32_t j=0; ok && j<hull->count; j++) {
+			/* NaN fails too. */
+			ok = hull->points[j][0] >= 0.0f && hull->points[j][0] <= 1.0f
+				&& hull->points[j][1] >= 0.0f && hull->points[j][1] <= 1.0f;
+		}
+		if(!ok) {
+			atlas_error("Corrupt atlas hull %u\n", i);
+			goto bail;
+		}
+	}
+
+	atlas->width = header->width;
+	atlas->height = header->height;
+	atlas->image = atlas->names + header->image;
+	atlas->format = atlas->names + header->format;
+	atlas->frames_count = header->frames_count;
+	atlas->index_size = header->index_size;
+	atlas->blob = blob;
+	atlas->blob_size = blob_size;
 	return ATLAS_OK;
 
 bail:
-	cJSON_Delete(root);
-	atlas_free(atlas);
-	return ret;
+	memset(atlas, 0, sizeof(struct atlas));
+	engine_free(blob);
+	return ATLAS_ERROR;
+}
+
+/**
+ * Load an atlas from JSON or from a compiled atlas (see atlas_compile()).
+ *
+ * The atlas does not reference data once this returns.
+ */
+int atlas_load(struct atlas *atlas, const void *data, size_t data_len)
+{
+	memset(atlas, 0, sizeof(struct atlas));
+
+	if(atlas_is_compiled(data, data_len)) {
+		void *blob = engine_malloc(MEM_GRAPHICS, data_len);
+		if(blob == NULL) {
+			atlas_error("Out of memory\n");
+			return ATLAS_ERROR;
+		}
+		memcpy(blob, data, data_len);
+		return atlas_attach(atlas, blob, data_len);
+	}
+
+	void *blob = NULL;
+	size_t blob_size = 0;
+	if(atlas_compile(data, data_len, &blob, &blob_size) != ATLAS_OK) {
+		return ATLAS_ERROR;
+	}
+	return atlas_attach(atlas, blob, blob_size);
+}
+
+/**
+ * Build an atlas from frames placed at runtime (see atlaspack.h), rather than
+ * from a TexturePacker JSON.
+ *
+ * @param image		Name of the atlas image.
+ * @param entries	The frames, in order.
+ * @param count		Number of entries.
+ */
+int atlas_build(struct atlas *atlas, int width, int height, const char *image,
+		const struct atlas_entry *entries, int count)
+{
+	struct atlas_compiler c = { 0 };
+	size_t names_size = strlen(image) + 1 + strlen(ATLAS_BUILD_FORMAT) + 1;
+
+	memset(atlas, 0, sizeof(struct atlas));
+
+	if(width <= 0 || height <= 0 || count < 0) {
+		atlas_error("Invalid size %dx%d (%d frames)\n", width, height, count);
+		return ATLAS_ERROR;
+	}
+	for(int i=0; i<count; i++) {
+		names_size += strlen(entries[i].name) + 1;
+	}
+
+	c.header.width = width;
+	c.header.height = height;
+	c.header.frames_count = count;
+	c.header.names_size = (uint32_t) names_size;
+
+	char *data = atlas_compiler_alloc(&c);
+	if(data == NULL) {
+		return ATLAS_ERROR;
+	}
+
+	c.header.image = atlas_add_str(&c, image);
+	c.header.format = atlas_add_str(&c, ATLAS_BUILD_FORMAT);
+	for(int i=0; i<count; i++) {
+		const struct atlas_entry *e = &entries[i];
+		struct atlas_json_frame frame = { 0 };
+		frame.x = e->x;
+		frame.y = e->y;
+		frame.width = e->width;
+		frame.height = e->height;
+		frame.source_width = e->width;
+		frame.source_height = e->height;
+		atlas_compiler_add(&c, i, &frame, atlas_add_str(&c, e->name));
+	}
+
+	memcpy(data, &c.header, sizeof(struct cook_atlas_header));
+
+	return atlas_attach(atlas, data, atlas_blob_size(&c.header));
 }
 
 void atlas_free(struct atlas *atlas)
@@ -167,7 +935,8 @@ void atlas_free(struct atlas *atlas)
 	if(atlas == NULL) {
 		return;
 	}
-	free(atlas->frames);
+	engine_free(atlas->blob);
+	memset(atlas, 0, sizeof(struct atlas));
 }
 
 /**
@@ -175,11 +944,47 @@ void atlas_free(struct atlas *atlas)
  */
 int atlas_frame_index(struct atlas *atlas, const char *name)
 {
-	for(int i=0; i<atlas->frames_count; i++) {
-		if(str_equals(atlas->frames[i].name, name)) {
-			return i;
+	if(atlas->index_size > 0) {
+		uint32_t mask = atlas->index_size - 1;
+		for(uint32_t slot = hash_fnv1a_str(name) & mask; atlas->index[slot] != 0; slot = (slot + 1) & mask) {
+			int i = atlas->index[slot] - 1;
+			if(str_equals(atlas->names + atlas->info[i].name, name)) {
+				return i;
+			}
 		}
 	}
 	atlas_debug("Could not find frame \"%s\"\n", name);
 	return -1;
 }
+
+/**
+ * Look up several frame names at once, for example all the frames used by a
+ * set of animations.
+ *
+ * @param names		The frame names to look for.
+ * @param indices	Set to the index of each frame, or -1 if it was not found.
+ * @param count		Number of names.
+ * @return			ATLAS_OK if all frames were found, ATLAS_ERROR otherwise.
+ */
+int atlas_frame_indices(struct atlas *atlas, const char **names, int *indices, int count)
+{
+	int ret = ATLAS_OK;
+	for(int i=0; i<count; i++) {
+		indices[i] = atlas_frame_index(atlas, names[i]);
+		if(indices[i] < 0) {
+			ret = ATLAS_ERROR;
+		}
+	}
+	return ret;
+}
+
+/**
+ * @return The name of a frame, or NULL if index is out of range.
+ */
+const char* atlas_frame_name(struct atlas *atlas, int index)
+{
+	if(index < 0 || index >= atlas->frames_count) {
+		return NULL;
+	}
+	return atlas->names + atlas->info[index].name;
+}
@@ -2,6 +2,7 @@
 #define _ATLAS_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "log.h"
 
@@ -13,47 +14,101 @@
 
 #define ATLAS_STR_MAX	256
 
+/* Most points in a frame hull (see struct atlas_hull). */
+#define ATLAS_HULL_MAX	8
+
+/* Pixel format of atlases built with atlas_build(). */
+#define ATLAS_BUILD_FORMAT	"RGBA8888"
+
+/**
+ * What sprites need every frame. Everything else about a frame is kept apart
+ * in struct atlas_frame_info, so the frames stay densely packed.
+ *
+ * Rotated frames are stored turned 90 degrees clockwise in the atlas image:
+ * width and height are those of the sprite, the region in the image is height
+ * wide and width high.
+ *
+ * NOTE: Stored as is in compiled atlases (see cook.h), so any change to this
+ * struct must bump COOK_ATLAS_VERSION.
+ */
 struct atlas_frame {
-	int		x;
-	int		y;
-	int		width;
-	int		height;
-	int		rotated;
-	int		trimmed;
-	char	name[ATLAS_STR_MAX];
-#ifdef ATLAS_FATTY
-	int		src_size_w;
-	int		src_size_h;
-	int		sprite_src_x;
-	int		sprite_src_y;
-	int		sprite_src_w;
-	int		sprite_src_h;
-#endif
+	int32_t		x;
+	int32_t		y;
+	int32_t		width;
+	int32_t		height;
+	float		uv[4];		/* Region in the image: x, y, width, height normalized to the atlas size. */
+	float		offset[2];	/* Center of the (trimmed) frame relative to the center of the untrimmed sprite, in pixels, y down. */
+	int32_t		rotated;
+	uint32_t	reserved;	/* Zero. */
+};
+
+/**
+ * NOTE: Stored as is in compiled atlases, like struct atlas_frame.
+ */
+struct atlas_frame_info {
+	uint32_t	name;			/* Offset of the name in names. */
+	int32_t		trimmed;
+	int32_t		source_x;		/* Where the frame was cut from the untrimmed sprite. */
+	int32_t		source_y;
+	int32_t		source_width;	/* Size of the untrimmed sprite. */
+	int32_t		source_height;
 };
 
 /**
- * NOTE: Workaround for GCC Bug 53119 (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=53119),
- * the first member of the struct must not be an array if the zero initializer:
- *     struct example e = { 0 };
- * is to be used.
+ * The convex hull of the opaque pixels of a frame, so sprites can be drawn as
+ * a small polygon instead of a quad that is mostly transparent. Traced
+ * offline by generate_assets (see atlas_add_hulls()).
+ *
+ * NOTE: Stored as is in compiled atlases, like struct atlas_frame.
+ */
+struct atlas_hull {
+	uint32_t	count;		/* Number of points, 0 to draw the whole quad. */
+	float		points[ATLAS_HULL_MAX][2];	/* 0 to 1 from the top-left of the sprite, y down. */
+};
+
+/**
+ * An atlas is a single compiled blob (see cook.h): frames, info, index and
+ * names all point into it. JSON atlases are compiled into the same layout when
+ * loaded, compiled atlases are only validated and copied.
  */
 struct atlas {
 	int					width;
 	int					height;
-	char				image[ATLAS_STR_MAX];
-	char				format[ATLAS_STR_MAX];
+	const char			*image;
+	const char			*format;
 	int					frames_count;
 	struct atlas_frame	*frames;
-#ifdef ATLAS_FATTY
-	char				scale[ATLAS_STR_MAX];
-	char				generator[ATLAS_STR_MAX];
-	char				generator_version[ATLAS_STR_MAX];
-#endif
+	const struct atlas_frame_info	*info;	/* Per frame, like frames. */
+	const struct atlas_hull	*hulls;		/* Per frame, or NULL if the atlas has none. */
+	const uint32_t		*index;			/* Hash table of frames by name (index + 1, 0 if empty). */
+	uint32_t			index_size;		/* Number of slots in index (power of two). */
+	const char			*names;			/* NULL-terminated frame names. */
+	void				*blob;			/* The compiled atlas, owned by the atlas. */
+	size_t				blob_size;
+};
+
+/**
+ * A frame placed at runtime, see atlas_build().
+ */
+struct atlas_entry {
+	const char	*name;
+	int			x;
+	int			y;
+	int			width;
+	int			height;
 };
 
-int		atlas_load(struct atlas *atlas, void *data, size_t data_len);
+int		atlas_load(struct atlas *atlas, const void *data, size_t data_len);
+int		atlas_compile(const void *json, size_t json_len, void **blob, size_t *blob_size);
+int		atlas_build(struct atlas *atlas, int width, int height, const char *image,
+				const struct atlas_entry *entries, int count);
+int		atlas_add_hulls(void **blob, size_t *blob_size, const uint8_t *pixels, int width, int height);
+float	atlas_hull_area(const struct atlas_hull *hull);
+int		atlas_is_compiled(const void *data, size_t data_len);
 void	atlas_free(struct atlas *atlas);
 void	atlas_print(struct atlas *atlas);
 int		atlas_frame_index(struct atlas *atlas, const char *name);
+int		atlas_frame_indices(struct atlas *atlas, const char **names, int *indices, int count);
+const char*	atlas_frame_name(struct atlas *atlas, int index);
 
 #endif
@@ -0,0 +1,523 @@
+/**
+ * Runtime texture atlas of loose images, see atlaspack.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <GL/glew.h>
+
+#include "atlaspack.h"
+#include "texture.h"
+#include "vfs.h"
+#include "mem.h"
+#include "str.h"
+
+/* Pixels decoded by atlaspack_decode(). */
+struct atlaspack_decoded {
+	uint8_t		*pixels;
+	int			width;
+	int			height;
+	int			cooked;		/* pixels are from image_load_cooked(), not image_load(). */
+};
+
+void atlaspack_init(struct atlaspack *pack, int page_width, int page_height)
+{
+	memset(pack, 0, sizeof(struct atlaspack));
+	pack->page_width = page_width;
+	pack->page_height = page_height;
+}
+
+void atlaspack_free(struct atlaspack *pack)
+{
+	for(int i=0; i<pack->pages_count; i++) {
+		struct atlaspack_page *page = &pack->pages[i];
+		texture_free(page->texture);
+		engine_free(page->pixels);
+		atlas_free(&page->atlas);
+	}
+	memset(pack, 0, sizeof(struct atlaspack));
+}
+
+static void atlaspack_skyline_reset(struct atlaspack *pack, struct atlaspack_skyline *skyline, int *count)
+{
+	skyline[0].x = 0;
+	skyline[0].y = 0;
+	skyline[0].width = pack->page_width;
+	*count = 1;
+}
+
+/**
+ * Where a width * height rectangle would go if its left edge is at segment i.
+ *
+ * @return The top edge, or -1 if it does not fit there.
+ */
+static int atlaspack_skyline_fit(struct atlaspack *pack, const struct atlaspack_skyline *skyline,
+		int count, int i, int width, int height)
+{
+	int x = skyline[i].x;
+	int y = 0;
+
+	if(x + width > pack->page_width) {
+		return -1;
+	}
+	for(int left = width; left > 0; i++) {
+		if(i >= count) {
+			return -1;
+		}
+		if(skyline[i].y > y) {
+			y = skyline[i].y;
+		}
+		left -= skyline[i].width;
+	}
+	if(y + height > pack->page_height) {
+		return -1;
+	}
+	return y;
+}
+
+/**
+ * Place a width * height rectangle as low as possible, and on the narrowest
+ * segment if there is a tie.
+ *
+ * @return ATLASPACK_OK, or ATLASPACK_ERROR if it does not fit.
+ */
+static int atlaspack_skyline_insert(struct atlaspack *pack, struct atlaspack_skyline *skyline,
+		int *count, int width, int height, int *x, int *y)
+{
+	int best = -1;
+	int best_bottom = 0;
+	int best_width = 0;
+
+	if(*count >= ATLASPACK_SKYLINE_MAX) {
+		return ATLASPACK_ERROR;
+	}
+
+	for(int i=0; i<*count; i++) {
+		int top = atlaspack_skyline_fit(pack, skyline, *count, i, width, height);
+		if(top < 0) {
+			continue;
+		}
+		if(best < 0 || top + height < best_bottom
+				|| (top + height == best_bottom && skyline[i].width < best_width)) {
+			best = i;
+			best_bottom = top + height;
+			best_width = skyline[i].width;
+		}
+	}
+	if(best < 0) {
+		return ATLASPACK_ERROR;
+	}
+
+	*x = skyline[best].x;
+	*y = best_bottom - height;
+
+	/* Insert the new segment... */
+	memmove(&skyline[best + 1], &skyline[best], (*count - best) * sizeof(struct atlaspack_skyline));
+	skyline[best].x = *x;
+	skyline[best].y = best_bottom;
+	skyline[best].width = width;
+	(*count)++;
+
+	/* ...shrink or drop the segments it covers... */
+	for(int i = best + 1; i < *count; ) {
+		int covered = skyline[i-1].x + skyline[i-1].width - skyline[i].x;
+		if(covered <= 0) {
+			break;
+		}
+		if(covered < skyline[i].width) {
+			skyline[i].x += covered;
+			skyline[i].width -= covered;
+			break;
+		}
+		memmove(&skyline[i], &skyline[i + 1], (*count - i - 1) * sizeof(struct atlaspack_skyline));
+		(*count)--;
+	}
+
+	/* ...and merge neighbours at the same height. */
+	for(int i=0; i < *count - 1; ) {
+		if(skyline[i].y == skyline[i+1].y) {
+			skyline[i].width += skyline[i+1].width;
+			memmove(&skyline[i + 1], &skyline[i + 2], (*count - i - 2) * sizeof(struct atlaspack_skyline));
+			(*count)--;
+		} else {
+			i++;
+		}
+	}
+
+	return ATLASPACK_OK;
+}
+
+/**
+ * Upload a region of the page copy to the texture.
+ */
+static int atlaspack_page_upload(struct atlaspack *pack, struct atlaspack_page *page,
+		int x, int y, int width, int height)
+{
+	size_t stride = (size_t) pack->page_width * 4;
+
+	if(width == pack->page_width) {
+		texture_update_pixels(page->texture, x, y, width, height,
+				page->pixels + y * stride);
+		return ATLASPACK_OK;
+	}
+
+	/* GLES 2 can not upload from a part of the rows, so copy them out. */
+	size_t row = (size_t) width * 4;
+	uint8_t *tmp = (uint8_t *) engine_malloc(MEM_GRAPHICS, row * height);
+	if(tmp == NULL) {
+		atlaspack_error("Out of memory\n");
+		return ATLASPACK_ERROR;
+	}
+	for(int i=0; i<height; i++) {
+		memcpy(tmp + i * row, page->pixels + (y + i) * stride + x * 4, row);
+	}
+	texture_update_pixels(page->texture, x, y, width, height, tmp);
+	engine_free(tmp);
+	return ATLASPACK_OK;
+}
+
+/**
+ * Copy pixels into the page copy, clearing the rest of the slot.
+ */
+static void atlaspack_page_blit(struct atlaspack *pack, struct atlaspack_page *page,
+		const struct atlaspack_image *img, const uint8_t *pixels)
+{
+	size_t stride = (size_t) pack->page_width * 4;
+	for(int i=0; i<img->slot_height; i++) {
+		uint8_t *dst = page->pixels + (img->y + i) * stride + img->x * 4;
+		memset(dst, 0, (size_t) img->slot_width * 4);
+		if(pixels != NULL && i < img->height) {
+			memcpy(dst, pixels + (size_t) i * img->width * 4, (size_t) img->width * 4);
+		}
+	}
+}
+
+/**
+ * Rebuild the atlas of a page from the images on it.
+ */
+static int atlaspack_page_build(struct atlaspack *pack, int index)
+{
+	struct atlaspack_page *page = &pack->pages[index];
+	struct atlas_entry entries[ATLASPACK_IMAGES_MAX];
+	char image[32];
+	int count = 0;
+
+	for(int i=0; i<pack->images_count; i++) {
+		const struct atlaspack_image *img = &pack->images[i];
+		if(img->page == index) {
+			entries[count].name = img->name;
+			entries[count].x = img->x;
+			entries[count].y = img->y;
+			entries[count].width = img->width;
+			entries[count].height = img->height;
+			count++;
+		}
+	}
+
+	snprintf(image, sizeof(image), "atlaspack:%d", index);
+	atlas_free(&page->atlas);
+	if(atlas_build(&page->atlas, pack->page_width, pack->page_height, image, entries, count) != ATLAS_OK) {
+		atlaspack_error("Could not build atlas for page %d\n", index);
+		return ATLASPACK_ERROR;
+	}
+	return ATLASPACK_OK;
+}
+
+static int atlaspack_page_new(struct atlaspack *pack)
+{
+	if(pack->pages_count >= ATLASPACK_PAGES_MAX) {
+		return -1;
+	}
+
+	struct atlaspack_page *page = &pack->pages[pack->pages_count];
+	memset(page, 0, sizeof(struct atlaspack_page));
+	page->pixels = (uint8_t *) engine_calloc(MEM_GRAPHICS, (size_t) pack->page_width * pack->page_height, 4);
+	if(page->pixels == NULL) {
+		atlaspack_error("Out of memory\n");
+		return -1;
+	}
+	if(texture_load_pixels(&page->texture, page->pixels, pack->page_width, pack->page_height) != GRAPHICS_OK) {
+		atlaspack_error("Could not create page texture\n");
+		engine_free(page->pixels);
+		page->pixels = NULL;
+		return -1;
+	}
+	atlaspack_skyline_reset(pack, page->skyline, &page->skyline_count);
+
+	atlaspack_debug("New %dx%d page %d\n", pack->page_width, pack->page_height, pack->pages_count);
+	return pack->pages_count++;
+}
+
+/**
+ * Pack the images on a page again, reclaiming the slots that were given up.
+ * The page is left as it was if they do not all fit.
+ */
+static int atlaspack_page_repack(struct atlaspack *pack, int index)
+{
+	struct atlaspack_page *page = &pack->pages[index];
+	struct atlaspack_skyline skyline[ATLASPACK_SKYLINE_MAX];
+	int skyline_count;
+	int order[ATLASPACK_IMAGES_MAX];
+	int pos[ATLASPACK_IMAGES_MAX][2];
+	int count = 0;
+
+	/* Tallest first. */
+	for(int i=0; i<pack->images_count; i++) {
+		if(pack->images[i].page != index) {
+			continue;
+		}
+		int j = count++;
+		while(j > 0 && pack->images[order[j-1]].slot_height < pack->images[i].slot_height) {
+			order[j] = order[j-1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	atlaspack_skyline_reset(pack, skyline, &skyline_count);
+	for(int i=0; i<count; i++) {
+		const struct atlaspack_image *img = &pack->images[order[i]];
+		if(atlaspack_skyline_insert(pack, skyline, &skyline_count,
+					img->slot_width + ATLASPACK_PADDING, img->slot_height + ATLASPACK_PADDING,
+					&pos[i][0], &pos[i][1]) != ATLASPACK_OK) {
+			atlaspack_debug("Could not repack page %d\n", index);
+			return ATLASPACK_ERROR;
+		}
+	}
+
+	uint8_t *pixels = (uint8_t *) engine_calloc(MEM_GRAPHICS, (size_t) pack->page_width * pack->page_height, 4);
+	if(pixels == NULL) {
+		atlaspack_error("Out of memory\n");
+		return ATLASPACK_ERROR;
+	}
+
+	size_t stride = (size_t) pack->page_width * 4;
+	for(int i=0; i<count; i++) {
+		struct atlaspack_image *img = &pack->images[order[i]];
+		for(int r=0; r<img->slot_height; r++) {
+			memcpy(pixels + (pos[i][1] + r) * stride + pos[i][0] * 4,
+					page->pixels + (img->y + r) * stride + img->x * 4,
+					(size_t) img->slot_width * 4);
+		}
+		img->x = pos[i][0];
+		img->y = pos[i][1];
+	}
+
+	engine_free(page->pixels);
+	page->pixels = pixels;
+	memcpy(page->skyline, skyline, skyline_count * sizeof(struct atlaspack_skyline));
+	page->skyline_count = skyline_count;
+	page->holes = 0;
+
+	atlaspack_debug("Repacked page %d (%d images)\n", index, count);
+	atlaspack_page_upload(pack, page, 0, 0, pack->page_width, pack->page_height);
+	return atlaspack_page_build(pack, index);
+}
+
+static int atlaspack_page_insert(struct atlaspack *pack, int index, struct atlaspack_image *img)
+{
+	struct atlaspack_page *page = &pack->pages[index];
+	if(atlaspack_skyline_insert(pack, page->skyline, &page->skyline_count,
+				img->slot_width + ATLASPACK_PADDING, img->slot_height + ATLASPACK_PADDING,
+				&img->x, &img->y) != ATLASPACK_OK) {
+		return ATLASPACK_ERROR;
+	}
+	img->page = index;
+	return ATLASPACK_OK;
+}
+
+/**
+ * Find a slot for an image that is not on a page.
+ */
+static int atlaspack_place(struct atlaspack *pack, struct atlaspack_image *img)
+{
+	for(int i=0; i<pack->pages_count; i++) {
+		if(atlaspack_page_insert(pack, i, img) == ATLASPACK_OK) {
+			return ATLASPACK_OK;
+		}
+	}
+	for(int i=0; i<pack->pages_count; i++) {
+		if(pack->pages[i].holes
+				&& atlaspack_page_repack(pack, i) == ATLASPACK_OK
+				&& atlaspack_page_insert(pack, i, img) == ATLASPACK_OK) {
+			return ATLASPACK_OK;
+		}
+	}
+	int page = atlaspack_page_new(pack);
+	if(page >= 0 && atlaspack_page_insert(pack, page, img) == ATLASPACK_OK) {
+		return ATLASPACK_OK;
+	}
+	atlaspack_error("No room for %s (%dx%d)\n", img->name, img->width, img->height);
+	return ATLASPACK_ERROR;
+}
+
+static struct atlaspack_image* atlaspack_image(struct atlaspack *pack, const char *name, int create)
+{
+	for(int i=0; i<pack->images_count; i++) {
+		if(str_equals(pack->images[i].name, name)) {
+			return &pack->images[i];
+		}
+	}
+	if(!create) {
+		return NULL;
+	}
+	if(pack->images_count >= ATLASPACK_IMAGES_MAX) {
+		atlaspack_error("Too many images (%d)\n", ATLASPACK_IMAGES_MAX);
+		return NULL;
+	}
+	if(strlen(name) >= ATLAS_STR_MAX) {
+		atlaspack_error("Name too long: %s\n", name);
+		return NULL;
+	}
+
+	struct atlaspack_image *img = &pack->images[pack->images_count++];
+	memset(img, 0, sizeof(struct atlaspack_image));
+	img->pack = pack;
+	strcpy(img->name, name);
+	img->page = -1;
+	return img;
+}
+
+/**
+ * Add an image, or replace it if one with the same name has been added
+ * before. Frames returned by atlaspack_frame() before this call are no longer
+ * valid.
+ *
+ * @param name		Name of the frame.
+ * @param pixels	width * height RGBA, rows tightly packed.
+ */
+int atlaspack_add(struct atlaspack *pack, const char *name, const uint8_t *pixels,
+		int width, int height)
+{
+	if(width <= 0 || height <= 0
+			|| width + ATLASPACK_PADDING > pack->page_width
+			|| height + ATLASPACK_PADDING > pack->page_height) {
+		atlaspack_error("%s (%dx%d) does not fit on a %dx%d page\n", name,
+				width, height, pack->page_width, pack->page_height);
+		return ATLASPACK_ERROR;
+	}
+
+	struct atlaspack_image *img = atlaspack_image(pack, name, 1);
+	if(img == NULL) {
+		return ATLASPACK_ERROR;
+	}
+
+	int old_page = img->page;
+	if(old_page >= 0 && (width > img->slot_width || height > img->slot_height)) {
+		/* Give up the slot, clearing it so a repack does not carry it along. */
+		struct atlaspack_page *page = &pack->pages[old_page];
+		atlaspack_page_blit(pack, page, img, NULL);
+		atlaspack_page_upload(pack, page, img->x, img->y, img->slot_width, img->slot_height);
+		page->holes = 1;
+		img->page = -1;
+	}
+
+	img->width = width;
+	img->height = height;
+	if(img->page < 0) {
+		img->slot_width = width;
+		img->slot_height = height;
+		if(atlaspack_place(pack, img) != ATLASPACK_OK) {
+			if(old_page >= 0) {
+				atlaspack_page_build(pack, old_page);
+			}
+			return ATLASPACK_ERROR;
+		}
+	}
+
+	struct atlaspack_page *page = &pack->pages[img->page];
+	atlaspack_page_blit(pack, page, img, pixels);
+	if(atlaspack_page_upload(pack, page, img->x, img->y, img->slot_width, img->slot_height) != ATLASPACK_OK) {
+		return ATLASPACK_ERROR;
+	}
+
+	if(old_page >= 0 && old_page != img->page) {
+		atlaspack_page_build(pack, old_page);
+	}
+	return atlaspack_page_build(pack, img->page);
+}
+
+/**
+ * Look up an image.
+ *
+ * The frame is only valid until the next image is added or reloaded, so look
+ * it up again rather than keeping it across frames.
+ *
+ * @param texture	Set to the texture of the page the image is on.
+ * @return			The frame, or NULL if the image has not been loaded.
+ */
+const struct atlas_frame* atlaspack_frame(struct atlaspack *pack, const char *name, GLuint *texture)
+{
+	const struct atlaspack_image *img = atlaspack_image(pack, name, 0);
+	if(img == NULL || img->page < 0) {
+		return NULL;
+	}
+
+	struct atlaspack_page *page = &pack->pages[img->page];
+	int index = atlas_frame_index(&page->atlas, name);
+	if(index < 0) {
+		return NULL;
+	}
+	if(texture != NULL) {
+		*texture = page->texture;
+	}
+	return &page->atlas.frames[index];
+}
+
+static void* atlaspack_decode(const char *filename, unsigned int size, const void *data, void *userdata)
+{
+	if(size == 0) {
+		atlaspack_debug("Skipped reload of %s (%u bytes)\n", filename, size);
+		return NULL;
+	}
+
+	struct atlaspack_decoded *img = (struct atlaspack_decoded *) engine_malloc(MEM_GRAPHICS, sizeof(struct atlaspack_decoded));
+	if(img == NULL) {
+		atlaspack_error("Out of memory\n");
+		return NULL;
+	}
+
+	int ret;
+	img->cooked = texture_is_cooked((const uint8_t *) data, size);
+	if(img->cooked) {
+		ret = image_load_cooked(&img->pixels, &img->width, &img->height, (const uint8_t *) data, size);
+	} else {
+		ret = image_load(&img->pixels, &img->width, &img->height, (const uint8_t *) data, size);
+	}
+	if(ret != GRAPHICS_OK) {
+		atlaspack_error("Could not load %s (%u bytes)\n", filename, size);
+		engine_free(img);
+		return NULL;
+	}
+
+	return img;
+}
+
+static void atlaspack_upload(const char *filename, unsigned int size, void *decoded, void *userdata)
+{
+	struct atlaspack_decoded *img = (struct atlaspack_decoded *) decoded;
+	struct atlaspack_image *dst = (struct atlaspack_image *) userdata;
+
+	atlaspack_add(dst->pack, dst->name, img->pixels, img->width, img->height);
+
+	if(img->cooked) {
+		engine_free(img->pixels);
+	} else {
+		image_free(img->pixels);
+	}
+	engine_free(img);
+}
+
+/**
+ * Pack an image file when it is loaded, and again each time it is reloaded.
+ * The frame is named after the file.
+ */
+int atlaspack_register(struct atlaspack *pack, const char *filename)
+{
+	struct atlaspack_image *img = atlaspack_image(pack, filename, 1);
+	if(img == NULL) {
+		return ATLASPACK_ERROR;
+	}
+	vfs_register_loader(filename, atlaspack_decode, atlaspack_upload, img);
+	return ATLASPACK_OK;
+}
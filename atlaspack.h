@@ -0,0 +1,84 @@
+/**
+ * Runtime texture atlas of loose images.
+ *
+ * Images registered with atlaspack_register() are packed into shared RGBA
+ * pages as they are loaded (skyline, bottom-left), so sprites drawn from them
+ * share a texture and can go in one batch. Each page has a struct atlas with a
+ * frame per image, named after the file.
+ *
+ * generate_assets registers the images listed in atlaspack.txt, one per line,
+ * with assets->atlaspack instead of loading them as textures of their own.
+ *
+ * When an image is reloaded it is updated in place if it still fits its slot.
+ * Otherwise the slot is given up and the image placed again: first in the free
+ * space of the pages, then in pages repacked without the slots given up, and
+ * last on a new page. Pages nothing moved on or off are left as they are.
+ */
+
+#ifndef _ATLASPACK_H
+#define _ATLASPACK_H
+
+#include <stdint.h>
+
+#include "graphics.h"
+#include "atlas.h"
+#include "log.h"
+
+#define atlaspack_debug(...) debugf("Atlaspack", __VA_ARGS__)
+#define atlaspack_error(...) errorf("Atlaspack", __VA_ARGS__)
+
+#define ATLASPACK_OK		0
+#define ATLASPACK_ERROR		-1
+
+#define ATLASPACK_PAGES_MAX		8
+#define ATLASPACK_IMAGES_MAX	128
+#define ATLASPACK_SKYLINE_MAX	256		/* Skyline segments per page. */
+#define ATLASPACK_PADDING		1		/* Transparent pixels right of and below each image. */
+
+struct atlaspack;
+
+/* A horizontal segment of the top edge of the packed area. */
+struct atlaspack_skyline {
+	int		x;
+	int		y;
+	int		width;
+};
+
+struct atlaspack_page {
+	GLuint						texture;
+	uint8_t						*pixels;	/* Copy of the texture (RGBA), kept for repacking. */
+	struct atlaspack_skyline	skyline[ATLASPACK_SKYLINE_MAX];
+	int							skyline_count;
+	int							holes;		/* Set when an image has given up its slot. */
+	struct atlas				atlas;		/* A frame per image on the page. */
+};
+
+struct atlaspack_image {
+	struct atlaspack	*pack;
+	char				name[ATLAS_STR_MAX];
+	int					page;			/* Index of the page, -1 until loaded. */
+	int					x;				/* Position on the page. */
+	int					y;
+	int					width;
+	int					height;
+	int					slot_width;		/* Space reserved on the page, padding excluded. */
+	int					slot_height;
+};
+
+struct atlaspack {
+	int						page_width;
+	int						page_height;
+	struct atlaspack_page	pages[ATLASPACK_PAGES_MAX];
+	int						pages_count;
+	struct atlaspack_image	images[ATLASPACK_IMAGES_MAX];
+	int						images_count;
+};
+
+void	atlaspack_init(struct atlaspack *pack, int page_width, int page_height);
+void	atlaspack_free(struct atlaspack *pack);
+int		atlaspack_register(struct atlaspack *pack, const char *filename);
+int		atlaspack_add(struct atlaspack *pack, const char *name, const uint8_t *pixels,
+				int width, int height);
+const struct atlas_frame*	atlaspack_frame(struct atlaspack *pack, const char *name, GLuint *texture);
+
+#endif
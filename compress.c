@@ -0,0 +1,234 @@
+/**
+ * LZ4 block compression.
+ *
+ * A block is a series of sequences. Each sequence starts with a token byte
+ * holding the number of literals (high nibble) and the match length minus
+ * LZ4_MIN_MATCH (low nibble); a nibble of 15 means more length bytes follow,
+ * each adding up to 255. The literals follow, then a little-endian 16-bit
+ * offset back into the output to copy the match from. The last sequence only
+ * has literals.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "compress.h"
+
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5	/* The last bytes of a block are always literals. */
+#define LZ4_MF_LIMIT		12	/* No match may start this close to the end. */
+#define LZ4_MAX_OFFSET		65535
+#define LZ4_HASH_BITS		12
+
+static uint32_t lz4_read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint32_t lz4_hash(uint32_t seq)
+{
+	return (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * Write the remainder of a length that did not fit in its token nibble.
+ */
+static uint8_t* lz4_write_length(uint8_t *op, size_t len)
+{
+	for(; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = (uint8_t) len;
+	return op;
+}
+
+/**
+ * Write a sequence of literals followed by a match. A match length of 0 writes
+ * the final, literals-only sequence.
+ *
+ * @return	The new output position, or NULL if the sequence does not fit.
+ */
+static uint8_t* lz4_write_sequence(uint8_t *op, uint8_t *oend,
+		const uint8_t *lit, size_t lit_len, size_t offset, size_t match_len)
+{
+	size_t need = 1 + lit_len / 255 + 1 + lit_len + (match_len ? 2 + match_len / 255 + 1 : 0);
+	if(need > (size_t) (oend - op)) {
+		return NULL;
+	}
+
+	uint8_t *token = op++;
+	*token = (uint8_t) ((lit_len >= 15 ? 15 : lit_len) << 4);
+	if(lit_len >= 15) {
+		op = lz4_write_length(op, lit_len - 15);
+	}
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if(match_len == 0) {
+		return op;
+	}
+
+	*op++ = (uint8_t) (offset & 0xff);
+	*op++ = (uint8_t) (offset >> 8);
+
+	size_t ml = match_len - LZ4_MIN_MATCH;
+	*token |= (uint8_t) (ml >= 15 ? 15 : ml);
+	if(ml >= 15) {
+		op = lz4_write_length(op, ml - 15);
+	}
+
+	return op;
+}
+
+/**
+ * Compress a block of memory.
+ *
+ * @param src			Data to compress.
+ * @param src_size		Size of src.
+ * @param dst			Where to write the compressed data.
+ * @param dst_capacity	Size of dst. COMPRESS_LZ4_BOUND(src_size) always fits.
+ * @return				The compressed size, or 0 if it does not fit in dst.
+ */
+size_t compress_lz4(const void *src, size_t src_size, void *dst, size_t dst_capacity)
+{
+	const uint8_t *base = (const uint8_t *) src;
+	const uint8_t *ip = base;
+	const uint8_t *anchor = base;
+	const uint8_t *iend = base + src_size;
+	uint8_t *op = (uint8_t *) dst;
+	uint8_t *oend = op + dst_capacity;
+
+	/* Positions of the last occurrence of each hashed 4-byte sequence. */
+	uint32_t table[1 << LZ4_HASH_BITS];
+	memset(table, 0, sizeof(table));
+
+	if(src_size > LZ4_MF_LIMIT) {
+		const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+		const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+
+		while(ip < mflimit) {
+			uint32_t seq = lz4_read32(ip);
+			uint32_t h = lz4_hash(seq);
+			const uint8_t *ref = base + table[h];
+			table[h] = (uint32_t) (ip - base);
+
+			if(ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4_read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			size_t offset = ip - ref;
+			const uint8_t *m = ip + LZ4_MIN_MATCH;
+			ref += LZ4_MIN_MATCH;
+			while(m < matchlimit && *m == *ref) {
+				m++;
+				ref++;
+			}
+
+			op = lz4_write_sequence(op, oend, anchor, ip - anchor,
+					offset, m - ip);
+			if(op == NULL) {
+				return 0;
+			}
+
+			ip = m;
+			anchor = ip;
+		}
+	}
+
+	op = lz4_write_sequence(op, oend, anchor, iend - anchor, 0, 0);
+	if(op == NULL) {
+		return 0;
+	}
+
+	return op - (uint8_t *) dst;
+}
+
+/**
+ * Read the remainder of a length that did not fit in its token nibble.
+ *
+ * @return	COMPRESS_OK, or COMPRESS_ERROR if the input ended.
+ */
+static int lz4_read_length(const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+	uint8_t b;
+	do {
+		if(*ip >= iend) {
+			return COMPRESS_ERROR;
+		}
+		b = *(*ip)++;
+		*len += b;
+	} while(b == 255);
+	return COMPRESS_OK;
+}
+
+/**
+ * Decompress a block of memory.
+ *
+ * @param src		Compressed data.
+ * @param src_size	Size of src.
+ * @param dst		Where to write the decompressed data.
+ * @param dst_size	The exact decompressed size.
+ * @return			COMPRESS_OK, or COMPRESS_ERROR if the data is corrupt or
+ *					does not decompress to exactly dst_size bytes.
+ */
+int decompress_lz4(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	const uint8_t *ip = (const uint8_t *) src;
+	const uint8_t *iend = ip + src_size;
+	uint8_t *op = (uint8_t *) dst;
+	uint8_t *oend = op + dst_size;
+
+	while(ip < iend) {
+		uint8_t token = *ip++;
+
+		size_t lit_len = token >> 4;
+		if(lit_len == 15 && lz4_read_length(&ip, iend, &lit_len) != COMPRESS_OK) {
+			return COMPRESS_ERROR;
+		}
+		if(lit_len > (size_t) (iend - ip) || lit_len > (size_t) (oend - op)) {
+			return COMPRESS_ERROR;
+		}
+		memcpy(op, ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+
+		/* The last sequence has no match. */
+		if(ip == iend) {
+			break;
+		}
+
+		if(iend - ip < 2) {
+			return COMPRESS_ERROR;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(offset == 0 || offset > (size_t) (op - (uint8_t *) dst)) {
+			return COMPRESS_ERROR;
+		}
+
+		size_t match_len = token & 15;
+		if(match_len == 15 && lz4_read_length(&ip, iend, &match_len) != COMPRESS_OK) {
+			return COMPRESS_ERROR;
+		}
+		match_len += LZ4_MIN_MATCH;
+		if(match_len > (size_t) (oend - op)) {
+			return COMPRESS_ERROR;
+		}
+
+		/* Matches may overlap the output they are copied to. */
+		const uint8_t *match = op - offset;
+		if(offset >= match_len) {
+			memcpy(op, match, match_len);
+			op += match_len;
+		} else {
+			for(size_t i = 0; i < match_len; i++) {
+				*op++ = *match++;
+			}
+		}
+	}
+
+	return (op == oend) ? COMPRESS_OK : COMPRESS_ERROR;
+}
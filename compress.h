@@ -0,0 +1,30 @@
+/**
+ * LZ4 block compression.
+ *
+ * Implements the LZ4 block format (no frame header), so data compressed here
+ * can also be decoded by the reference implementation and vice versa. The
+ * compressor is a simple greedy one: it favours a small, dependency free
+ * implementation over the best ratio. Decompression is bounds checked and
+ * safe to run on untrusted input.
+ */
+
+#ifndef _COMPRESS_H
+#define _COMPRESS_H
+
+#include <stdlib.h>
+
+#include "log.h"
+
+#define compress_debug(...) debugf("Compress", __VA_ARGS__)
+#define compress_error(...) errorf("Compress", __VA_ARGS__)
+
+#define COMPRESS_OK		0
+#define COMPRESS_ERROR	-1
+
+/* Worst case size of compressing n bytes. */
+#define COMPRESS_LZ4_BOUND(n)	((n) + (n) / 255 + 16)
+
+size_t	compress_lz4(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+int		decompress_lz4(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+#endif
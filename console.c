@@ -19,6 +19,8 @@
 #include "math4.h"
 #include "graphics.h"
 #include "drawable.h"
+#include "core.h"
+#include "mem.h"
 
 static const vec4 CONSOLE_COLOR_INPUT		= { 1.0f, 1.0f, 1.0f, 1.0f };
 static const vec4 CONSOLE_COLOR_DISPLAY		= { 0.8f, 0.8f, 0.8f, 1.0f };
@@ -75,6 +77,9 @@ static void console_cursor_think(struct console_cursor *cur, float dt)
 }
 
 /**
+* Splits a string into a list of arguments. The argument strings are allocated
+* in per-frame scratch memory and must not be freed.
+*
 * @param s			The string to tokenize.
 * @param s_size		The size of the buffer holding s.
 * @param token		Split strings at this token.
@@ -107,7 +112,7 @@ static int console_split_args(const char *s, size_t s_size, const char token, st
 			/* Length of this word. */
 			int word_len = n - i;
 			/* Create string to store parsed argument in. */
-			char *name = (char *) malloc((word_len + 1) * sizeof(char));
+			char *name = (char *) frame_alloc((word_len + 1) * sizeof(char), 1);
 			if(name == NULL) {
 				console_error("Out of memory");
 				return -1;
@@ -139,7 +144,7 @@ void console_new(struct console *c, struct monofont *font, int view_width,
 	c->padding = padding;
 	c->chars_per_line = view_width / (font->letter_width + font->letter_spacing_x);
 	c->history_len = CONSOLE_HISTORY_LINES * c->chars_per_line;
-	c->history = (char *) calloc(c->history_len, sizeof(char));
+	c->history = (char *) engine_calloc(MEM_CONSOLE, c->history_len, sizeof(char));
 	if(c->history == NULL) {
 		console_error("Out of memory\n");
 		return;
@@ -171,7 +176,7 @@ void console_new(struct console *c, struct monofont *font, int view_width,
 
 void console_free(struct console *c)
 {
-	free(c->history);
+	engine_free(c->history);
 	list_free(c->input_history, 1);
 	monotext_free(&c->txt_display);
 	monotext_free(&c->txt_input);
@@ -498,8 +503,8 @@ void console_parse(struct console *c, const char *in_str, size_t in_str_len)
 		console_parse_cmd(c, argv);
 	}
 
-	/* Free argv list and its elements. */
-	list_free(argv, 1);
+	/* Free argv list (the elements are in frame memory). */
+	list_free(argv, 0);
 }
 
 void console_input_clear(struct console *c)
@@ -738,6 +743,7 @@ void console_cmd_autocomplete(struct console *c, const char *input,
 
 	if(cmd == NULL) {
 		console_debug("Autocomplete: command not found\n");
+		list_free(argv, 0);
 		return;
 	}
 
@@ -810,7 +816,7 @@ void console_cmd_autocomplete(struct console *c, const char *input,
 	}
 
 	list_free(completions, 0);
-	list_free(argv, 1);
+	list_free(argv, 0);
 }
 
 /**
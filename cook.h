@@ -0,0 +1,106 @@
+/**
+ * Cooked asset formats.
+ *
+ * generate_assets converts some assets to formats that can be handed straight
+ * to GL, or used in place, when it writes assets.pack, so loading them does not
+ * have to decode anything. Loaders recognize a cooked asset by its magic and
+ * fall back to decoding the source format otherwise, so uncooked files from a
+ * mounted directory keep working during development. All integers are stored in
+ * native (little-endian) byte order.
+ *
+ * Cooked texture:
+ *   struct cook_texture_header
+ *   Mip levels, largest first. Each level starts at a multiple of COOK_ALIGN
+ *   from the start of the blob and is width * height * bytes per pixel
+ *   (cook_texture_bpp()), rows tightly packed.
+ *
+ * Cooked sound (short clips only, longer tracks stay Ogg Vorbis):
+ *   struct cook_sound_header
+ *   frames * channels interleaved signed 16 bit samples.
+ *
+ * Compiled atlas (from TexturePacker JSON, see atlas.h):
+ *   struct cook_atlas_header
+ *   struct atlas_frame[frames_count]
+ *   struct atlas_frame_info[frames_count]
+ *   uint32_t index[index_size]	Open-addressed hash table of frames by
+ *								hash_fnv1a_str() of their names, linear
+ *								probing. Frame index + 1, 0 if empty.
+ *   struct atlas_hull[frames_count]	Only if hulls is set.
+ *   char names[names_size]		NULL-terminated strings.
+ */
+
+#ifndef _COOK_H
+#define _COOK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define COOK_ALIGN					4
+
+#define COOK_TEXTURE_MAGIC			0x5845544cu	/* "LTEX" */
+#define COOK_TEXTURE_VERSION		1
+
+/* Pixel formats. */
+#define COOK_TEXTURE_RGBA8			0	/* 8 bit RGBA. */
+#define COOK_TEXTURE_A8				1	/* White, 8 bit alpha (font sheets). */
+#define COOK_TEXTURE_L8				2	/* Opaque, 8 bit luminance. */
+
+#define COOK_TEXTURE_LEVELS_MAX		16
+
+#define COOK_SOUND_MAGIC			0x444e534cu	/* "LSND" */
+#define COOK_SOUND_VERSION			1
+
+/* Sounds up to this long are cooked by default (see generate_assets --sfx-max). */
+#define COOK_SOUND_MAX_SECONDS		2.0
+
+#define COOK_ATLAS_MAGIC			0x534c544cu	/* "LTLS" */
+#define COOK_ATLAS_VERSION			4
+
+struct cook_texture_header {
+	uint32_t	magic;			/* COOK_TEXTURE_MAGIC. */
+	uint32_t	version;		/* COOK_TEXTURE_VERSION. */
+	uint32_t	format;			/* COOK_TEXTURE_*. */
+	uint32_t	width;			/* Size of level 0. */
+	uint32_t	height;
+	uint32_t	levels;			/* Number of mip levels, at least 1. */
+};
+
+struct cook_sound_header {
+	uint32_t	magic;			/* COOK_SOUND_MAGIC. */
+	uint32_t	version;		/* COOK_SOUND_VERSION. */
+	uint32_t	channels;		/* 1 or 2. */
+	uint32_t	sample_rate;
+	uint32_t	frames;			/* Samples per channel. */
+	uint32_t	reserved;		/* Zero. */
+};
+
+struct cook_atlas_header {
+	uint32_t	magic;			/* COOK_ATLAS_MAGIC. */
+	uint32_t	version;		/* COOK_ATLAS_VERSION. */
+	uint32_t	width;			/* Size of the atlas image. */
+	uint32_t	height;
+	uint32_t	frames_count;
+	uint32_t	index_size;		/* Slots in the hash table (power of two). */
+	uint32_t	names_size;		/* Size of the string pool. */
+	uint32_t	image;			/* Offset of the image name in the pool. */
+	uint32_t	format;			/* Offset of the pixel format in the pool. */
+	uint32_t	hulls;			/* 1 if there is a hull per frame, 0 if not. */
+};
+
+static inline size_t cook_align(size_t offset)
+{
+	return (offset + COOK_ALIGN - 1) & ~((size_t) COOK_ALIGN - 1);
+}
+
+static inline uint32_t cook_texture_bpp(uint32_t format)
+{
+	return (format == COOK_TEXTURE_RGBA8) ? 4 : 1;
+}
+
+static inline uint32_t cook_texture_level_size(uint32_t size, uint32_t level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+#endif
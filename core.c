@@ -16,6 +16,7 @@
 #include "texture.h"
 #include "assets.h"
 #include "vfs.h"
+#include "mem.h"
 
 #include "core.h"
 #include "core_argv.h"
@@ -107,6 +108,7 @@ static void core_think(struct core* core, struct graphics *g, float delta_time)
 
 	/* Common think functions. */
 	vfs_filewatch();
+	vfs_enforce_budget();
 	console_think(&core->console, delta_time);
 	sound_think(&core->sound, delta_time);
 
@@ -227,6 +229,43 @@ void core_set_init_memory_callback(struct core* core, core_init_memory_t init_me
 	core->init_memory_callback = init_memory_callback;
 }
 
+/**
+ * Set the size of the per-frame scratch memory used by frame_alloc(). Must be
+ * called before core_setup(). If 0, CORE_FRAME_MEMORY_SIZE is used.
+ */
+void core_set_frame_memory_size(struct core* core, size_t frame_memory_size)
+{
+	core->frame_memory_size = frame_memory_size;
+}
+
+/**
+ * Allocate scratch memory that is valid until the start of the next frame.
+ * Allocations that do not fit in the frame memory fall back to malloc() and
+ * are released at the start of the next frame as well.
+ *
+ * @param size	The number of bytes to allocate.
+ * @param align	Alignment of the returned pointer. Must be a power of two.
+ * @return		A pointer to the memory, or NULL if out of memory.
+ */
+void* frame_alloc(size_t size, size_t align)
+{
+	return arena_alloc(&core_global->frame_arena, size, align);
+}
+
+/**
+ * Allocate zeroed game memory that lives until the core shuts down. Game memory
+ * survives reloads of the game library and keeps its address, and the first
+ * allocation is always placed at shared_memory.game_memory.
+ *
+ * @param size	The number of bytes to allocate.
+ * @param align	Alignment of the returned pointer. Must be a power of two.
+ * @return		A pointer to the memory, or NULL if game memory is exhausted.
+ */
+void* game_alloc(size_t size, size_t align)
+{
+	return vmem_alloc(&core_global->game_memory, size, align);
+}
+
 void core_get_viewport(struct core* core, float* x, float* y, float* w, float* h)
 {
 	float buffer[4];
@@ -256,12 +295,30 @@ void core_setup(struct core* core, const char *title, int view_width, int view_h
 	/* FIXME: nice way to set this pointer from game library OR engine specific console shader. */
 	core->console_shader = &assets->shaders.basic_shader;
 
-	/* Allocate game memory */
-	core->shared_memory.game_memory = malloc(game_memory_size);
+	/* Allocate per-frame scratch memory. */
+	if(core->frame_memory_size == 0) {
+		core->frame_memory_size = CORE_FRAME_MEMORY_SIZE;
+	}
+	if(arena_init(&core->frame_arena, core->frame_memory_size) != ARENA_OK) {
+		core_error("Could not allocate frame memory (%lu bytes)\n",
+				(unsigned long) core->frame_memory_size);
+	}
+
+	/* Reserve game memory. It is committed as the game allocates from it. */
+	if(game_memory_size == 0) {
+		game_memory_size = CORE_GAME_MEMORY_SIZE;
+	}
+	if(vmem_init(&core->game_memory, game_memory_size) != VMEM_OK) {
+		core_error("Could not reserve game memory (%lu bytes)\n",
+				(unsigned long) game_memory_size);
+		exit(1);
+	}
+	core->shared_memory.game_memory = core->game_memory.base;
 	core->shared_memory.core = core;
 	core->shared_memory.assets = assets;
 	core->shared_memory.vfs = vfs_global;
 	core->shared_memory.input = &core->input;
+	core->shared_memory.mem = mem_global;
 	core->init_memory_callback(&core->shared_memory, 0);
 
 	/* Seed random number generator. */
@@ -316,7 +373,14 @@ void core_run(struct core* core)
 	graphics_free(core, &core->graphics);
 
 	/* Release game memory */
-	free(core->shared_memory.game_memory);
+	core_debug("Game memory high-water mark: %lu KiB of %lu KiB reserved\n",
+			(unsigned long) (core->game_memory.used / 1024),
+			(unsigned long) (core->game_memory.reserved / 1024));
+	vmem_free(&core->game_memory);
+	core->shared_memory.game_memory = NULL;
+
+	/* Release per-frame scratch memory. */
+	arena_free(&core->frame_arena);
 }
 
 void core_reload(struct core* core)
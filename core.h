@@ -9,6 +9,8 @@
 #include "sound.h"
 #include "monotext.h"
 #include "console.h"
+#include "arena.h"
+#include "vmem.h"
 
 #include "graphics.h"
 
@@ -23,6 +25,11 @@ typedef void (*core_console_init_t)(struct console *);
 #define core_debug(...) debugf("Core", __VA_ARGS__)
 #define core_error(...) errorf("Core", __VA_ARGS__)
 
+/* Default size of the per-frame scratch memory. */
+#define CORE_FRAME_MEMORY_SIZE	(1024 * 1024)
+/* Default address space reserved for game memory. */
+#define CORE_GAME_MEMORY_SIZE	(1024 * 1024 * 1024)
+
 struct core_textures {
 	GLuint	none;
 };
@@ -55,6 +62,10 @@ struct core {
 	struct monofont			font_console;
 
 	struct shared_memory	shared_memory;
+	struct vmem				game_memory;
+	/* Per-frame scratch memory. */
+	size_t					frame_memory_size;
+	struct arena			frame_arena;
 };
 
 struct core *core_global;
@@ -71,8 +82,12 @@ void core_set_asset_callbacks(struct core* core, core_load_t load_callback,
 void core_set_fps_callback(struct core* core, fps_func_t fps_callback);
 void core_set_console_init_callback(struct core* core, core_console_init_t console_init_callback);
 void core_set_up_sound(struct core* core, vec3 *sound_listener, float distance_max);
+void core_set_frame_memory_size(struct core* core, size_t frame_memory_size);
 void core_get_viewport(struct core* core, float* x, float* y, float* w, float* h);
 
+void* frame_alloc(size_t size, size_t align);
+void* game_alloc(size_t size, size_t align);
+
 void core_setup(struct core* core, const char *title, int view_width, int view_height,
 	int window_width, int window_height, int window_mode, size_t game_memory_size);
 
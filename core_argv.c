@@ -66,6 +66,15 @@ int core_argv_parse(struct core_argv *dst, int argc, char **argv)
 			i++;
 		}
 
+		/* --pack <PATH> */
+		if(core_argv_is_arg(argv[i], "pack") == 0) {
+			if(core_argv_get_value(i, dst->pack, argc, argv) != 0) {
+				core_argv_error("Usage: --pack <PATH>\n");
+				return -1;
+			}
+			i++;
+		}
+
 		/* --game <PATH> */
 		if(core_argv_is_arg(argv[i], "game") == 0) {
 			if(core_argv_get_value(i, dst->game, argc, argv) != 0) {
@@ -80,14 +89,26 @@ int core_argv_parse(struct core_argv *dst, int argc, char **argv)
 			dst->window_mode = GRAPHICS_MODE_WINDOWED;
 		}
 
+		/* --mmap */
+		if(core_argv_is_arg(argv[i], "mmap") == 0) {
+			dst->mmap = 1;
+		}
+
+		/* --lazy */
+		if(core_argv_is_arg(argv[i], "lazy") == 0) {
+			dst->lazy = 1;
+		}
+
 		/* --borderless */
 		if (core_argv_is_arg(argv[i], "borderless") == 0) {
 			dst->window_mode = GRAPHICS_MODE_BORDERLESS;
 		}
 	}
 
-	/* Default values. */
-	if(str_empty(dst->mount, CORE_ARGV_VALUE_MAX)) {
+	/* Default values. A pack replaces the default mount; pass --mount as well
+	 * to overlay a directory on the pack. */
+	if(str_empty(dst->mount, CORE_ARGV_VALUE_MAX)
+			&& str_empty(dst->pack, CORE_ARGV_VALUE_MAX)) {
 		str_set(dst->mount, CORE_ARGV_VALUE_MAX, "assets");
 	}
 
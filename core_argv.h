@@ -10,7 +10,10 @@
 
 struct core_argv {
 	int		window_mode;
+	int		mmap;
+	int		lazy;
 	char	mount[CORE_ARGV_VALUE_MAX];
+	char	pack[CORE_ARGV_VALUE_MAX];
 	char	game[CORE_ARGV_VALUE_MAX];
 };
 
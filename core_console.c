@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <math.h>
 #include <GLFW/glfw3.h>
 
@@ -15,16 +16,38 @@
 #include "graphics.h"
 #include "vfs.h"
 #include "core.h"
+#include "pool.h"
+#include "mem.h"
+
+#define CORE_CONSOLE_CMD_POOL_CHUNK	32
 
 /**
- * Convenience function to malloc, set up and add a new console command to the
- * command tree.
+ * Console commands live as long as the console, so they are packed together
+ * in a pool instead of being allocated one by one. The pool is initialized on
+ * first use and not locked: commands may only be registered from the main
+ * thread.
+ */
+static struct pool cmd_pool = { 0 };
+
+/**
+ * Convenience function to allocate, set up and add a new console command to
+ * the command tree.
  */
 static struct console_cmd* cmd_new(struct console_cmd *parent, const char *name, int argc,
 		console_cmd_func_t callback, console_cmd_autocomplete_t autocomplete)
 {
+	if(cmd_pool.size == 0
+			&& pool_init(&cmd_pool, sizeof(struct console_cmd),
+				sizeof(void *), CORE_CONSOLE_CMD_POOL_CHUNK) != POOL_OK) {
+		return NULL;
+	}
+
 	/* Allocate and init the command. */
-	struct console_cmd *cmd = (struct console_cmd *) calloc(1, sizeof(struct console_cmd));
+	struct console_cmd *cmd = (struct console_cmd *) pool_alloc(&cmd_pool);
+	if(cmd == NULL) {
+		return NULL;
+	}
+	memset(cmd, 0, sizeof(struct console_cmd));
 	console_cmd_new(cmd, name, argc, callback, autocomplete);
 
 	/* Register command in parent. */
@@ -128,6 +151,27 @@ static void core_console_vfs_mount(struct console *c, struct console_cmd *cmd, s
 	vfs_mount(e->data);
 }
 
+static void core_console_vfs_request(struct console *c, struct console_cmd *cmd, struct list *argv)
+{
+	struct str_element *e = (struct str_element *) list_element_at(argv, 0);
+	if(e == NULL) {
+		return;
+	}
+	if(vfs_request(e->data) != 0) {
+		console_printf(c, "ERROR: Could not load \"%s\"\n", e->data);
+	}
+}
+
+static void core_console_vfs_budget(struct console *c, struct console_cmd *cmd, struct list *argv)
+{
+	float f;
+	if(console_cmd_parse_1f(c, cmd, argv, &f) != 0) {
+		return;
+	}
+	vfs_set_budget(f > 0.0f ? (size_t) f * 1024 : 0);
+	console_printf(c, "%lu KiB loaded\n", (unsigned long) (vfs_loaded_bytes() / 1024));
+}
+
 static void core_console_vfs_autocomplete_simplename(struct console *c, struct console_cmd *cmd,
 		struct list *argv, struct list *matches)
 {
@@ -144,6 +188,57 @@ static void core_console_vfs_init(struct console *c)
 	cmd_new(root, "list", 0, &core_console_vfs_list, NULL);
 	cmd_new(root, "reload", 1, &core_console_vfs_reload, core_console_vfs_autocomplete_simplename);
 	cmd_new(root, "mount", 1, &core_console_vfs_mount, core_console_vfs_autocomplete_simplename);
+	cmd_new(root, "request", 1, &core_console_vfs_request, core_console_vfs_autocomplete_simplename);
+	cmd_new(root, "budget", 1, &core_console_vfs_budget, NULL);
+}
+
+/* Memory */
+
+static void core_console_mem_print(struct console *c, const char *name,
+		struct mem_counters *m)
+{
+	console_printf(c, "%-12s %8lu KiB live %8lu KiB peak %6lu/frame\n",
+			name,
+			(unsigned long) (m->live / 1024),
+			(unsigned long) (m->peak / 1024),
+			(unsigned long) m->last_frame_allocs);
+}
+
+static void core_console_mem(struct console *c, struct console_cmd *cmd, struct list *argv)
+{
+	struct vmem *vm = &core_global->game_memory;
+	console_printf(c, "%-12s %8lu KiB used %8lu KiB committed %8lu KiB reserved\n",
+			"game memory",
+			(unsigned long) (vm->used / 1024),
+			(unsigned long) (vm->committed / 1024),
+			(unsigned long) (vm->reserved / 1024));
+	console_printf(c, "%-12s %8lu KiB loaded %8lu KiB budget\n",
+			"vfs",
+			(unsigned long) (vfs_loaded_bytes() / 1024),
+			(unsigned long) (vfs_global->budget / 1024));
+
+#ifdef MEM_STATS
+	if(mem_global == NULL) {
+		console_printf(c, "ERROR: Memory stats not available\n");
+		return;
+	}
+	for(int i=0; i<MEM_TAG_MAX; i++) {
+		core_console_mem_print(c, mem_tag_name(i), &mem_global->tags[i]);
+	}
+	struct mem_counters total;
+	mem_total(mem_global, &total);
+	core_console_mem_print(c, "total", &total);
+	for(int i=0; i<MEM_GPU_MAX; i++) {
+		core_console_mem_print(c, mem_gpu_name(i), &mem_global->gpu[i]);
+	}
+#else
+	console_printf(c, "Compile with ENABLE_MEM_STATS for heap and GPU memory\n");
+#endif
+}
+
+static void core_console_mem_init(struct console *c)
+{
+	cmd_new(&c->root_cmd, "mem", 0, &core_console_mem, NULL);
 }
 
 /* Main API */
@@ -154,6 +249,7 @@ void core_console_new(struct console *c)
 	core_console_sound_init(c);
 	core_console_graphics_init(c);
 	core_console_vfs_init(c);
+	core_console_mem_init(c);
 }
 
 void core_console_printf(const char *fmt, ...)
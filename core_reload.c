@@ -1,6 +1,15 @@
 /**
  * Loader helpers.
  *
+ * Textures, sounds and atlases are loaded in two stages (see
+ * vfs_register_loader()): core_decode_*() parses the file and may run on a
+ * worker thread, core_upload_*() hands the result to GL or AL (or swaps it in)
+ * on the main thread. core_reload_*() runs both stages in a row, for use with
+ * vfs_register_callback().
+ *
+ * Shader sources and console configs are referenced after the callback
+ * returns, so those callbacks keep the contents (see vfs_keep_contents()).
+ *
  * Author: Tim Sjöstrand <tim.sjostrand@gmail.com>
  */
 
@@ -12,19 +21,71 @@
 #include "atlas.h"
 #include "texture.h"
 #include "console.h"
+#include "particles.h"
+#include "mem.h"
 
-void core_reload_sound(const char *filename, unsigned int size, void *data, void *userdata)
+/* PCM data decoded by core_decode_sound(). */
+struct core_decoded_sound {
+	struct sound_pcm	pcm;
+	const void			*cooked;		/* Cooked sound in the vfs buffer, or NULL. */
+	size_t				cooked_size;
+};
+
+/* Pixel data decoded by core_decode_texture(). */
+struct core_decoded_image {
+	uint8_t			*pixels;
+	int				width;
+	int				height;
+	const uint8_t	*cooked;		/* Cooked texture in the vfs buffer, or NULL. */
+	size_t			cooked_size;
+};
+
+void* core_decode_sound(const char *filename, unsigned int size, const void *data, void *userdata)
 {
 	if(size == 0) {
 		sound_debug("Skipped reload of %s (%u bytes)\n", filename, size);
-		return;
+		return NULL;
+	}
+
+	struct core_decoded_sound *snd = (struct core_decoded_sound *) engine_malloc(MEM_SOUND, sizeof(struct core_decoded_sound));
+	if(snd == NULL) {
+		sound_error("Out of memory\n");
+		return NULL;
+	}
+
+	/* Cooked sounds are uploaded straight from the file contents, which stay
+	 * loaded until the upload stage has run. */
+	if(sound_is_cooked(data, size)) {
+		snd->cooked = data;
+		snd->cooked_size = size;
+		return snd;
 	}
+	snd->cooked = NULL;
 
+	if(sound_pcm_decode_vorbis(&snd->pcm, data, size) != SOUND_OK) {
+		sound_error("Could not load %s (%u bytes)\n", filename, size);
+		engine_free(snd);
+		return NULL;
+	}
+
+	return snd;
+}
+
+void core_upload_sound(const char *filename, unsigned int size, void *decoded, void *userdata)
+{
+	struct core_decoded_sound *snd = (struct core_decoded_sound *) decoded;
 	sound_buf_t tmp = 0;
 	sound_buf_t *dst = (sound_buf_t *) userdata;
 
-	/* Reload sound. */
-	if(sound_buf_load_vorbis(&tmp, data, size) != SOUND_OK) {
+	int ret;
+	if(snd->cooked != NULL) {
+		ret = sound_buf_load_pcm_cooked(&tmp, snd->cooked, snd->cooked_size);
+	} else {
+		ret = sound_buf_load_decoded(&tmp, &snd->pcm);
+		sound_pcm_free(&snd->pcm);
+	}
+
+	if(ret != SOUND_OK) {
 		sound_error("Could not load %s (%u bytes)\n", filename, size);
 	} else {
 		/* Release current sound (if any). */
@@ -33,6 +94,16 @@ void core_reload_sound(const char *filename, unsigned int size, void *data, void
 		/* Assign new sound (only if parsing was OK). */
 		(*dst) = tmp;
 	}
+
+	engine_free(snd);
+}
+
+void core_reload_sound(const char *filename, unsigned int size, void *data, void *userdata)
+{
+	void *decoded = core_decode_sound(filename, size, data, userdata);
+	if(decoded != NULL) {
+		core_upload_sound(filename, size, decoded, userdata);
+	}
 }
 
 void core_reload_shader(const char *filename, unsigned int size, void *data, void *userdata)
@@ -49,7 +120,8 @@ void core_reload_shader(const char *filename, unsigned int size, void *data, voi
 		return;
 	}
 
-	/* Keep references to shader sources. */
+	/* Keep references to shader sources, so the vfs must keep them too. */
+	vfs_keep_contents();
 	if(strstr(filename, ".frag") != NULL) {
 		dst->frag_src = data;
 		dst->frag_src_len = size;
@@ -89,45 +161,122 @@ void core_reload_shader(const char *filename, unsigned int size, void *data, voi
 	}
 }
 
-void core_reload_atlas(const char *filename, unsigned int size, void *data, void *userdata)
+void* core_decode_atlas(const char *filename, unsigned int size, const void *data, void *userdata)
 {
 	if(size == 0) {
 		atlas_debug("Skipped reload of %s (%u bytes)\n", filename, size);
-		return;
+		return NULL;
+	}
+
+	if(!userdata) {
+		atlas_error("Invalid argument to core_decode_atlas()\n");
+		return NULL;
 	}
 
+	struct atlas *tmp = (struct atlas *) engine_calloc(MEM_GRAPHICS, 1, sizeof(struct atlas));
+	if(tmp == NULL) {
+		atlas_error("Out of memory\n");
+		return NULL;
+	}
+
+	int ret = atlas_load(tmp, (void *) data, size);
+	if(ret != ATLAS_OK) {
+		atlas_error("Error %d when loading atlas %s (%u bytes)\n", ret, filename, size);
+		atlas_free(tmp);
+		engine_free(tmp);
+		return NULL;
+	}
+
+	return tmp;
+}
+
+void core_upload_atlas(const char *filename, unsigned int size, void *decoded, void *userdata)
+{
 	struct atlas *dst = (struct atlas *) userdata;
+	struct atlas *tmp = (struct atlas *) decoded;
 
-	if(!dst) {
-		atlas_error("Invalid argument to core_reload_atlas()\n");
+	/* Delete the old atlas. */
+	atlas_free(dst);
+	/* Assign the new atlas only if parsing succeeded. */
+	(*dst) = (*tmp);
+	engine_free(tmp);
+	/* DEBUG: Dump debug information about atlas to stdout. */
+	atlas_print(dst);
+}
+
+void core_reload_atlas(const char *filename, unsigned int size, void *data, void *userdata)
+{
+	void *decoded = core_decode_atlas(filename, size, data, userdata);
+	if(decoded != NULL) {
+		core_upload_atlas(filename, size, decoded, userdata);
+	}
+}
+
+void core_reload_particles_effect(const char *filename, unsigned int size, void *data, void *userdata)
+{
+	if(size == 0) {
+		particles_debug("Skipped reload of %s (%u bytes)\n", filename, size);
 		return;
 	}
 
-	struct atlas tmp = { 0 };
+	struct particles_effect *dst = (struct particles_effect *) userdata;
 
-	int ret = atlas_load(&tmp, data, size);
-	if(ret != ATLAS_OK) {
-		atlas_error("Error %d when loading atlas %s (%u bytes)\n", ret, filename, size);
-	} else {
-		/* Delete the old atlas. */
-		atlas_free(dst);
-		/* Assign the new atlas only if parsing succeeded. */
-		(*dst) = tmp;
-		/* DEBUG: Dump debug information about atlas to stdout. */
-		atlas_print(dst);
+	if(!dst) {
+		particles_error("Invalid argument to core_reload_particles_effect()\n");
+		return;
+	}
+
+	/* Only assigns the new effect if the whole description was valid. */
+	if(particles_effect_load(dst, data, size) != PARTICLES_OK) {
+		particles_error("Could not load effect %s (%u bytes)\n", filename, size);
 	}
 }
 
-void core_reload_texture(const char *filename, unsigned int size, void *data, void* userdata)
+void* core_decode_texture(const char *filename, unsigned int size, const void *data, void *userdata)
 {
 	if(size == 0) {
 		core_debug("Skipped reload of texture %s (%u bytes)\n", filename, size);
-		return;
+		return NULL;
+	}
+
+	struct core_decoded_image *img = (struct core_decoded_image *) engine_malloc(MEM_GRAPHICS, sizeof(struct core_decoded_image));
+	if(img == NULL) {
+		core_error("Out of memory\n");
+		return NULL;
+	}
+
+	/* Cooked textures are uploaded straight from the file contents, which
+	 * stay loaded until the upload stage has run. */
+	if(texture_is_cooked(data, size)) {
+		img->pixels = NULL;
+		img->cooked = (const uint8_t *) data;
+		img->cooked_size = size;
+		return img;
 	}
+	img->cooked = NULL;
+
+	if(image_load(&img->pixels, &img->width, &img->height, data, size) != GRAPHICS_OK) {
+		core_error("Texture load failed: %s (%u bytes)\n", filename, size);
+		engine_free(img);
+		return NULL;
+	}
+
+	return img;
+}
 
+void core_upload_texture(const char *filename, unsigned int size, void *decoded, void *userdata)
+{
+	struct core_decoded_image *img = (struct core_decoded_image *) decoded;
 	GLuint tmp;
 
-	int ret = texture_load(&tmp, NULL, NULL, data, size);
+	int ret;
+	if(img->cooked != NULL) {
+		ret = texture_load_cooked(&tmp, NULL, NULL, img->cooked, img->cooked_size);
+	} else {
+		ret = texture_load_pixels(&tmp, img->pixels, img->width, img->height);
+		image_free(img->pixels);
+	}
+	engine_free(img);
 
 	if(ret != GRAPHICS_OK) {
 		core_error("Texture load failed: %s (%u bytes)\n", filename, size);
@@ -146,6 +295,14 @@ void core_reload_texture(const char *filename, unsigned int size, void *data, vo
 	}
 }
 
+void core_reload_texture(const char *filename, unsigned int size, void *data, void* userdata)
+{
+	void *decoded = core_decode_texture(filename, size, data, userdata);
+	if(decoded != NULL) {
+		core_upload_texture(filename, size, decoded, userdata);
+	}
+}
+
 void core_reload_console_conf(const char *filename, unsigned int size, void *data, void *userdata)
 {
 	if(size == 0) {
@@ -154,6 +311,8 @@ void core_reload_console_conf(const char *filename, unsigned int size, void *dat
 	}
 
 	struct console *dst = (struct console *) userdata;
+	/* Parsed later (and on every reload), so keep the contents around. */
+	vfs_keep_contents();
 	dst->conf.data = (const char *) data;
 	dst->conf.len = size;
 
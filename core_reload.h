@@ -1,9 +1,17 @@
 #ifndef _CORE_RELOAD_H
 #define _CORE_RELOAD_H
 
+void* core_decode_sound(const char *filename, unsigned int size, const void *data, void *userdata);
+void  core_upload_sound(const char *filename, unsigned int size, void *decoded, void *userdata);
+void* core_decode_atlas(const char *filename, unsigned int size, const void *data, void *userdata);
+void  core_upload_atlas(const char *filename, unsigned int size, void *decoded, void *userdata);
+void* core_decode_texture(const char *filename, unsigned int size, const void *data, void *userdata);
+void  core_upload_texture(const char *filename, unsigned int size, void *decoded, void *userdata);
+
 void core_reload_sound(const char *filename, unsigned int size, void *data, void *userdata);
 void core_reload_shader(const char *filename, unsigned int size, void *data, void *userdata);
 void core_reload_atlas(const char *filename, unsigned int size, void *data, void *userdata);
+void core_reload_particles_effect(const char *filename, unsigned int size, void *data, void *userdata);
 void core_reload_texture(const char *filename, unsigned int size, void *data, void* userdata);
 void core_reload_console_conf(const char *filename, unsigned int size, void *data, void *userdata);
 
@@ -15,6 +15,8 @@
 #include "math4.h"
 #include "graphics.h"
 #include "color.h"
+#include "core.h"
+#include "spritebatch.h"
 
 /**
  * Upload vertices to GPU.
@@ -41,7 +43,7 @@ static void drawable_set_vbo(GLfloat *vertices, GLuint vertices_count, struct sh
 	/* Bind and upload buffer. */
 	glBindBuffer(GL_ARRAY_BUFFER, *vbo);
 	GL_OK_OR_RETURN;
-	glBufferData(GL_ARRAY_BUFFER, vertices_count * VBO_VERTEX_LEN * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+	graphics_buffer_data(GL_ARRAY_BUFFER, vertices_count * VBO_VERTEX_LEN * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
 	GL_OK_OR_RETURN;
 
 	/* Position stream. */
@@ -260,9 +262,9 @@ void drawable_new_rect_outline(struct drawable *dst, struct rect *rect, struct s
 void drawable_new_rect_outlinef(struct drawable *dst, float x, float y, float w, float h, struct shader *s)
 {
 	dst->draw_mode = GL_LINE_STRIP;
-	/* Allocate memory for vertices. */
+	/* Allocate scratch memory for vertices. */
 	dst->vertex_count = 5;
-	GLfloat *vertices = (GLfloat *) calloc(dst->vertex_count * VBO_VERTEX_LEN, sizeof(GLfloat));
+	GLfloat *vertices = (GLfloat *) frame_alloc(dst->vertex_count * VBO_VERTEX_LEN * sizeof(GLfloat), sizeof(GLfloat));
 
 	/* OOM? */
 	if(vertices == NULL) {
@@ -275,17 +277,14 @@ void drawable_new_rect_outlinef(struct drawable *dst, float x, float y, float w,
 
 	/* Upload vertices to GPU. */
 	drawable_set_vbo(vertices, dst->vertex_count, s, &dst->vbo, &dst->vao);
-
-	/* Cleanup. */
-	free(vertices);
 }
 
 void drawable_new_rect_solidf(struct drawable *dst, float x, float y, float w, float h, struct shader *s)
 {
 	dst->draw_mode = GL_TRIANGLES;
-	/* Allocate memory for vertices. */
+	/* Allocate scratch memory for vertices. */
 	dst->vertex_count = 6;
-	GLfloat *vertices = (GLfloat *) calloc(dst->vertex_count * VBO_VERTEX_LEN, sizeof(GLfloat));
+	GLfloat *vertices = (GLfloat *) frame_alloc(dst->vertex_count * VBO_VERTEX_LEN * sizeof(GLfloat), sizeof(GLfloat));
 
 	/* OOM? */
 	if(vertices == NULL) {
@@ -298,9 +297,6 @@ void drawable_new_rect_solidf(struct drawable *dst, float x, float y, float w, f
 
 	/* Upload vertices to GPU. */
 	drawable_set_vbo(vertices, dst->vertex_count, s, &dst->vbo, &dst->vao);
-
-	/* Cleanup. */
-	free(vertices);
 }
 
 void drawable_new_circle_outlinef(struct drawable *dst, float x, float y, float r, int segments, struct shader *s)
@@ -310,8 +306,8 @@ void drawable_new_circle_outlinef(struct drawable *dst, float x, float y, float
 	 * needs to reconnect with the first one. */
 	dst->vertex_count = segments + 1;
 
-	/* Allocate memory for vertices. */
-	GLfloat *vertices = (GLfloat *) calloc(dst->vertex_count * VBO_VERTEX_LEN, sizeof(GLfloat));
+	/* Allocate scratch memory for vertices. */
+	GLfloat *vertices = (GLfloat *) frame_alloc(dst->vertex_count * VBO_VERTEX_LEN * sizeof(GLfloat), sizeof(GLfloat));
 
 	/* OOM? */
 	if(vertices == NULL) {
@@ -324,9 +320,6 @@ void drawable_new_circle_outlinef(struct drawable *dst, float x, float y, float
 
 	/* Upload vertices to GPU. */
 	drawable_set_vbo(vertices, dst->vertex_count, s, &dst->vbo, &dst->vao);
-
-	/* Cleanup. */
-	free(vertices);
 }
 
 /**
@@ -342,8 +335,8 @@ void drawable_new_linef(struct drawable *dst, float x1, float y1, float x2, floa
 	dst->draw_mode = GL_LINE_STRIP;
 	dst->vertex_count = 2;
 
-	/* Allocate memory for vertices. */
-	GLfloat *vertices = (GLfloat *) calloc(2 * VBO_VERTEX_LEN, sizeof(GLfloat));
+	/* Allocate scratch memory for vertices. */
+	GLfloat *vertices = (GLfloat *) frame_alloc(2 * VBO_VERTEX_LEN * sizeof(GLfloat), sizeof(GLfloat));
 
 	/* OOM? */
 	if(vertices == NULL) {
@@ -356,15 +349,12 @@ void drawable_new_linef(struct drawable *dst, float x1, float y1, float x2, floa
 
 	/* Upload vertices to GPU. */
 	drawable_set_vbo(vertices, dst->vertex_count, s, &dst->vbo, &dst->vao);
-
-	/* Cleanup. */
-	free(vertices);
 }
 
 void drawable_free(struct drawable *d)
 {
 	glDeleteVertexArrays(1, &d->vao);
-	glDeleteBuffers(1, &d->vbo);
+	graphics_buffers_delete(1, &d->vbo);
 	d->vertex_count = 0;
 }
 
@@ -391,6 +381,20 @@ void sprite_render(struct basic_sprite *sprite, struct shader *s, struct graphic
 			g->vao_rect, sprite->texture, sprite->color, s, g, transform_final);
 }
 
+/**
+ * Add a sprite to a sprite batch, showing the region sprite->uv of the
+ * texture the batch is rendered with.
+ */
+void sprite_batch(struct basic_sprite *sprite, struct spritebatch *batch)
+{
+	vec3 pos = { xyz(sprite->pos) };
+	vec2 scale = { sprite->scale[0], sprite->scale[1] };
+	vec2 tex_pos = { sprite->uv[0], sprite->uv[1] };
+	vec2 tex_bounds = { sprite->uv[2], sprite->uv[3] };
+
+	spritebatch_add_angled(batch, pos, scale, sprite->rotation, tex_pos, tex_bounds);
+}
+
 void sprite_init(struct basic_sprite *sprite, int type, float x, float y, float z,
 		float w, float h, const vec4 color, float rotation, GLuint *texture)
 {
@@ -400,4 +404,5 @@ void sprite_init(struct basic_sprite *sprite, int type, float x, float y, float
 	set4f(sprite->color, rgba(color));
 	sprite->rotation = rotation;
 	sprite->texture = texture;
+	set4f(sprite->uv, 0.0f, 0.0f, 1.0f, 1.0f);
 }
@@ -6,6 +6,8 @@
 #include "graphics.h"
 #include "geometry.h"
 
+struct spritebatch;
+
 struct drawable {
 	GLenum	draw_mode;
 	GLuint	vertex_count;
@@ -36,10 +38,12 @@ struct basic_sprite {
 	vec4	color;
 	float	rotation;
 	GLuint	*texture;
+	vec4	uv;			/* Region of the texture (x, y, width, height), used by sprite_batch(). */
 };
 
 void	sprite_init(struct basic_sprite *sprite, int type, float x, float y, float z,
 				float w, float h, const vec4 color, float rotation, GLuint *texture);
 void	sprite_render(struct basic_sprite *sprite, struct shader *s, struct graphics *g);
+void	sprite_batch(struct basic_sprite *sprite, struct spritebatch *batch);
 
 #endif
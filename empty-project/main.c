@@ -18,6 +18,8 @@
 #include "input.h"
 #include "atlas.h"
 #include "animatedsprites.h"
+#include "mem.h"
+#include "mem.h"
 
 #define VIEW_WIDTH		640
 #define VIEW_HEIGHT		360
@@ -46,15 +48,19 @@ struct game_settings* game_get_settings()
 
 void game_init_memory(struct shared_memory *shared_memory, int reload)
 {
-	if(!reload) {
-		memset(shared_memory->game_memory, 0, sizeof(struct game));
-	}
-
-	game = (struct game *) shared_memory->game_memory;
 	core_global = shared_memory->core;
 	assets = shared_memory->assets;
 	vfs_global = shared_memory->vfs;
 	input_global = shared_memory->input;
+	mem_global = shared_memory->mem;
+
+	/* The first allocation is zeroed and placed at shared_memory->game_memory. */
+	if(!reload && game_alloc(sizeof(struct game), 16) == NULL) {
+		core_error("Could not allocate game state\n");
+		exit(1);
+	}
+
+	game = (struct game *) shared_memory->game_memory;
 }
 
 void game_think(struct core *core, struct graphics *g, float dt)
@@ -114,7 +120,7 @@ void game_key_callback(struct core *core, struct input *input, GLFWwindow *windo
 void game_assets_load()
 {
 	assets_load();
-	vfs_register_callback("textures.json", core_reload_atlas, &game->atlas);
+	vfs_register_loader("textures.json", core_decode_atlas, core_upload_atlas, &game->atlas);
 }
 
 void game_assets_release()
@@ -125,6 +131,14 @@ void game_assets_release()
 
 void game_fps_callback(struct frames *f)
 {
-	core_debug("FPS:% 5d, MS:% 3.1f/% 3.1f/% 3.1f\n", f->frames,
-			f->frame_time_min, f->frame_time_avg, f->frame_time_max);
+	core_debug("FPS:% 5d, MS:% 3.1f/% 3.1f/% 3.1f, FRAME MEM: %lu KiB (%lu overflows)\n", f->frames,
+			f->frame_time_min, f->frame_time_avg, f->frame_time_max,
+			(unsigned long) (f->frame_memory_peak / 1024),
+			(unsigned long) f->frame_memory_overflows);
+#ifdef MEM_STATS
+	core_debug("MEM: %lu KiB, GPU: %lu KiB, ALLOCS/FRAME: %lu\n",
+			(unsigned long) (f->mem_live / 1024),
+			(unsigned long) (f->mem_gpu / 1024),
+			(unsigned long) f->mem_frame_allocs_max);
+#endif
 }
@@ -12,6 +12,7 @@ struct frames;
 struct console;
 struct core;
 struct assets;
+struct mem_stats;
 
 typedef float vec3[3];
 
@@ -22,6 +23,7 @@ struct shared_memory
 	struct assets* assets;
 	struct vfs* vfs;
 	struct input* input;
+	struct mem_stats* mem;
 };
 
 //#define LOAD_SHARED
@@ -59,6 +61,8 @@ struct game_settings {
 	int			view_height;
 	vec3		sound_listener;
 	float		sound_distance_max;
+	size_t		frame_memory_size;	/* Per-frame scratch memory (0 for default). */
+	size_t		game_memory_size;	/* Game memory address space to reserve (0 for default). */
 };
 
 SHARED_SYMBOL void game_init();
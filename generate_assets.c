@@ -4,8 +4,19 @@
 
 #include "vfs.h"
 #include "alist.h"
-
-struct vfs vfs_mem = { { 0 } };
+#include "hash.h"
+#include "mem.h"
+#include "pack.h"
+#include "compress.h"
+#include "cook.h"
+#include "atlas.h"
+#include "json.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#include <stb/stb_vorbis.c>
+
+struct vfs vfs_mem = { 0 };
 struct vfs *vfs_global = &vfs_mem;
 
 struct alist* assets_list;
@@ -13,9 +24,32 @@ struct alist* assets_list_textures;
 struct alist* assets_list_sounds;
 struct alist* assets_list_shaders;
 struct alist* assets_list_misc;
+struct alist* assets_list_atlaspack;
 
 #define MAX_ASSETS 512
 
+/* Lists images, one per line, to pack into shared atlas pages at runtime
+ * (see atlaspack.h) instead of loading them as textures of their own. */
+#define ATLASPACK_MANIFEST "atlaspack.txt"
+#define ATLASPACK_PAGE_SIZE 1024
+
+/* Images named in ATLASPACK_MANIFEST. */
+static struct alist* atlaspack_names;
+
+static const char* ext_texture[] = { ".png", ".tga", ".jpeg", ".jpg", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".pnm" };
+static const char* ext_sounds[] = { ".ogg" };
+static const char* ext_shaders[] = { ".frag", ".vert" };
+static const char* ext_atlases[] = { ".json" };
+
+/* Cook mip chains for textures (--mips). */
+static int cook_mips = 0;
+
+/* Trace the alpha hull of every atlas frame (--hulls). */
+static int cook_hulls = 0;
+
+/* Cook sounds up to this many seconds long (--sfx-max <seconds>). */
+static double cook_sound_max_seconds = COOK_SOUND_MAX_SECONDS;
+
 void write_clean_name(FILE *fp, char* name)
 {
 	if (48 <= *name && *name <= 57)
@@ -62,24 +96,30 @@ void write_assets_c()
 	fprintf(fp, "\t// Textures\n");
 	foreach_alist(char*, asset, i, assets_list_textures)
 	{
-		fprintf(fp, "\tvfs_register_callback(\"");
-		fprintf(fp, "%s\", &core_reload_texture, &assets->textures.", asset);
+		fprintf(fp, "\tvfs_register_loader_hashed(\"");
+		fprintf(fp, "%s\", 0x%08xu, &core_decode_texture, &core_upload_texture, &assets->textures.", asset, (unsigned int) vfs_hash(asset));
 		write_clean_name(fp, asset);
 		fprintf(fp, ");\n");
 	}
+	fprintf(fp, "\n\t// Packed images\n");
+	fprintf(fp, "\tatlaspack_init(&assets->atlaspack, %d, %d);\n", ATLASPACK_PAGE_SIZE, ATLASPACK_PAGE_SIZE);
+	foreach_alist(char*, asset, i, assets_list_atlaspack)
+	{
+		fprintf(fp, "\tatlaspack_register(&assets->atlaspack, \"%s\");\n", asset);
+	}
 	fprintf(fp, "\n\t// Sounds\n");
 	foreach_alist(char*, asset, i, assets_list_sounds)
 	{
-		fprintf(fp, "\tvfs_register_callback(\"");
-		fprintf(fp, "%s\", &core_reload_sound, &assets->sounds.", asset);
+		fprintf(fp, "\tvfs_register_loader_hashed(\"");
+		fprintf(fp, "%s\", 0x%08xu, &core_decode_sound, &core_upload_sound, &assets->sounds.", asset, (unsigned int) vfs_hash(asset));
 		write_clean_name(fp, asset);
 		fprintf(fp, ");\n");
 	}
 	fprintf(fp, "\n\t// Shaders\n");
 	foreach_alist(char*, asset, i, assets_list_shaders)
 	{
-		fprintf(fp, "\tvfs_register_callback(\"");
-		fprintf(fp, "%s\", &core_reload_shader, &assets->shaders.", asset);
+		fprintf(fp, "\tvfs_register_callback_hashed(\"");
+		fprintf(fp, "%s\", 0x%08xu, &core_reload_shader, &assets->shaders.", asset, (unsigned int) vfs_hash(asset));
 		write_clean_name(fp, asset);
 		fprintf(fp, ");\n");
 	}
@@ -94,6 +134,8 @@ void write_assets_c()
 		write_clean_name(fp, asset);
 		fprintf(fp, ");\n");
 	}
+	fprintf(fp, "\n\t// Packed images\n");
+	fprintf(fp, "\tatlaspack_free(&assets->atlaspack);\n");
 	fprintf(fp, "\n\t// Sounds\n");
 	foreach_alist(char*, asset, i, assets_list_sounds)
 	{
@@ -121,7 +163,8 @@ void write_assets_h()
 	fprintf(fp, "#define ASSETS_H\n\n");
 	fprintf(fp, "#include \"game.h\"\n");
 	fprintf(fp, "#include \"shader.h\"\n");
-	fprintf(fp, "#include \"sound.h\"\n\n");
+	fprintf(fp, "#include \"sound.h\"\n");
+	fprintf(fp, "#include \"atlaspack.h\"\n\n");
 
 	fprintf(fp, "struct shader;\n");
 
@@ -192,6 +235,7 @@ void write_assets_h()
 	fprintf(fp, "\t struct textures textures;\n");
 	fprintf(fp, "\t struct sounds sounds;\n");
 	fprintf(fp, "\t struct shaders shaders;\n");
+	fprintf(fp, "\t struct atlaspack atlaspack;\n");
 	fprintf(fp, "};\n\n");
 
 	fprintf(fp, "struct assets* assets;\n\n");
@@ -204,6 +248,639 @@ void write_assets_h()
 	fclose(fp);
 }
 
+struct pack_source
+{
+	const char* name;
+	uint32_t hash;
+	const void* data;
+	size_t size;
+	void* compressed;		/* LZ4 block, NULL if stored as is. */
+	size_t compressed_size;
+	void* cooked;			/* Cooked asset (see cook.h) that data points to, or NULL. */
+};
+
+static int pack_source_cmp(const void* a, const void* b)
+{
+	const struct pack_source* sa = (const struct pack_source*)a;
+	const struct pack_source* sb = (const struct pack_source*)b;
+
+	if (sa->hash != sb->hash)
+	{
+		return sa->hash < sb->hash ? -1 : 1;
+	}
+
+	return strcmp(sa->name, sb->name);
+}
+
+static uint64_t pack_align(uint64_t offset)
+{
+	return (offset + PACK_ALIGN - 1) & ~((uint64_t)PACK_ALIGN - 1);
+}
+
+static void write_padding(FILE* fp, uint64_t from, uint64_t to)
+{
+	for (; from < to; from++)
+	{
+		fputc(0, fp);
+	}
+}
+
+static int has_extension(const char* name, const char** extensions, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (strstr(name, extensions[i]) != 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Pick the smallest cooked format that holds the image without loss.
+ */
+static uint32_t cook_texture_format(const uint8_t* rgba, size_t count)
+{
+	int white_alpha = 1;
+	int opaque_gray = 1;
+
+	for (size_t i = 0; i < count && (white_alpha || opaque_gray); i++)
+	{
+		const uint8_t* p = &rgba[i * 4];
+		int gray = (p[0] == p[1] && p[1] == p[2]);
+
+		/* The color of invisible pixels does not matter. */
+		if (p[3] != 0 && !(gray && p[0] == 255))
+		{
+			white_alpha = 0;
+		}
+		if (!gray || p[3] != 255)
+		{
+			opaque_gray = 0;
+		}
+	}
+
+	if (white_alpha)
+	{
+		return COOK_TEXTURE_A8;
+	}
+	if (opaque_gray)
+	{
+		return COOK_TEXTURE_L8;
+	}
+	return COOK_TEXTURE_RGBA8;
+}
+
+static void cook_texture_pixels(const uint8_t* rgba, size_t count, uint32_t format, uint8_t* dst)
+{
+	switch (format)
+	{
+	case COOK_TEXTURE_A8:
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = rgba[i * 4 + 3];
+		}
+		break;
+	case COOK_TEXTURE_L8:
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = rgba[i * 4];
+		}
+		break;
+	default:
+		memcpy(dst, rgba, count * 4);
+		break;
+	}
+}
+
+/**
+ * Box filter an RGBA image to half its size (rounded down, at least 1).
+ */
+static void cook_texture_downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+	uint32_t dst_width = cook_texture_level_size(width, 1);
+	uint32_t dst_height = cook_texture_level_size(height, 1);
+
+	for (uint32_t y = 0; y < dst_height; y++)
+	{
+		uint32_t y0 = y * 2;
+		uint32_t y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+		for (uint32_t x = 0; x < dst_width; x++)
+		{
+			uint32_t x0 = x * 2;
+			uint32_t x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+			for (int c = 0; c < 4; c++)
+			{
+				unsigned int sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c]
+					+ src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+				dst[(y * dst_width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/**
+ * Replace an image with a cooked texture (see cook.h), so the game can upload
+ * it without decoding.
+ *
+ * @return	0 if the image was cooked, -1 if it was left as is.
+ */
+static int pack_source_cook_texture(struct pack_source* source)
+{
+	int width;
+	int height;
+	int components;
+	uint8_t* rgba = stbi_load_from_memory((const stbi_uc*)source->data, (int)source->size, &width, &height, &components, STBI_rgb_alpha);
+	if (rgba == NULL)
+	{
+		printf("Could not cook %s: %s\n", source->name, stbi_failure_reason());
+		return -1;
+	}
+
+	uint32_t levels = 1;
+	while (cook_mips && levels < COOK_TEXTURE_LEVELS_MAX && ((width >> levels) > 0 || (height >> levels) > 0))
+	{
+		levels++;
+	}
+
+	struct cook_texture_header header = { 0 };
+	header.magic = COOK_TEXTURE_MAGIC;
+	header.version = COOK_TEXTURE_VERSION;
+	header.format = cook_texture_format(rgba, (size_t)width * height);
+	header.width = width;
+	header.height = height;
+	header.levels = levels;
+
+	size_t offsets[COOK_TEXTURE_LEVELS_MAX];
+	size_t size = sizeof(struct cook_texture_header);
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		size = cook_align(size);
+		offsets[i] = size;
+		size += (size_t)cook_texture_level_size(width, i) * cook_texture_level_size(height, i) * cook_texture_bpp(header.format);
+	}
+
+	uint8_t* cooked = (uint8_t*)calloc(1, size);
+	uint8_t* level = (uint8_t*)malloc((size_t)width * height * 4);
+	if (cooked == NULL || level == NULL)
+	{
+		printf("Out of memory cooking %s\n", source->name);
+		free(cooked);
+		free(level);
+		stbi_image_free(rgba);
+		return -1;
+	}
+
+	memcpy(cooked, &header, sizeof(struct cook_texture_header));
+	memcpy(level, rgba, (size_t)width * height * 4);
+	stbi_image_free(rgba);
+
+	for (uint32_t i = 0; i < levels; i++)
+	{
+		uint32_t level_width = cook_texture_level_size(width, i);
+		uint32_t level_height = cook_texture_level_size(height, i);
+		cook_texture_pixels(level, (size_t)level_width * level_height, header.format, cooked + offsets[i]);
+		if (i + 1 < levels)
+		{
+			/* In place: the smaller level is written behind the reads. */
+			cook_texture_downsample(level, level_width, level_height, level);
+		}
+	}
+	free(level);
+
+	source->cooked = cooked;
+	source->data = cooked;
+	source->size = size;
+	return 0;
+}
+
+/**
+ * Replace a short Ogg Vorbis clip with a cooked sound (see cook.h), so the
+ * game can upload it without decoding. Longer tracks stay compressed.
+ *
+ * @return	0 if the sound was cooked, -1 if it was left as is.
+ */
+static int pack_source_cook_sound(struct pack_source* source)
+{
+	int error = 0;
+	stb_vorbis* vorbis = stb_vorbis_open_memory((const unsigned char*)source->data, (int)source->size, &error, NULL);
+	if (vorbis == NULL)
+	{
+		printf("Could not cook %s: vorbis error %d\n", source->name, error);
+		return -1;
+	}
+	stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+	unsigned int frames = stb_vorbis_stream_length_in_samples(vorbis);
+	stb_vorbis_close(vorbis);
+
+	if (info.sample_rate == 0 || frames > cook_sound_max_seconds * info.sample_rate)
+	{
+		return -1;
+	}
+
+	int channels;
+	int sample_rate;
+	short* samples;
+	int decoded = stb_vorbis_decode_memory((const unsigned char*)source->data, (int)source->size, &channels, &sample_rate, &samples);
+	if (decoded < 0)
+	{
+		printf("Could not cook %s: decoding failed\n", source->name);
+		return -1;
+	}
+	if (channels != 1 && channels != 2)
+	{
+		printf("Could not cook %s: %d channels\n", source->name, channels);
+		free(samples);
+		return -1;
+	}
+
+	struct cook_sound_header header = { 0 };
+	header.magic = COOK_SOUND_MAGIC;
+	header.version = COOK_SOUND_VERSION;
+	header.channels = channels;
+	header.sample_rate = sample_rate;
+	header.frames = decoded;
+
+	size_t size = sizeof(struct cook_sound_header) + (size_t)decoded * channels * sizeof(short);
+	uint8_t* cooked = (uint8_t*)malloc(size);
+	if (cooked == NULL)
+	{
+		printf("Out of memory cooking %s\n", source->name);
+		free(samples);
+		return -1;
+	}
+
+	memcpy(cooked, &header, sizeof(struct cook_sound_header));
+	memcpy(cooked + sizeof(struct cook_sound_header), samples, (size_t)decoded * channels * sizeof(short));
+	free(samples);
+
+	source->cooked = cooked;
+	source->data = cooked;
+	source->size = size;
+	return 0;
+}
+
+/**
+ * @return	1 if the JSON has top level "frames" and "meta" like an atlas, 0 if
+ *			not.
+ */
+static int is_atlas_json(const void* data, size_t size)
+{
+	struct json_reader r;
+	struct json_token key, value;
+	int frames = 0, meta = 0;
+
+	json_init(&r, data, size);
+	if (json_next(&r, &value) != JSON_OBJECT)
+	{
+		return 0;
+	}
+	while (json_object_next(&r, &key) > 0)
+	{
+		json_next(&r, &value);
+		frames |= json_equals(&key, "frames") && value.type == JSON_ARRAY;
+		meta |= json_equals(&key, "meta") && value.type == JSON_OBJECT;
+		if (json_skip(&r, &value) != JSON_OK)
+		{
+			return 0;
+		}
+	}
+	return frames && meta;
+}
+
+/**
+ * Add the hull of every frame to a compiled atlas (see struct atlas_hull),
+ * traced from the atlas image next to the JSON.
+ */
+static void cook_atlas_hulls(const char* name, void** blob, size_t* size)
+{
+	struct atlas atlas;
+	if (atlas_load(&atlas, *blob, *size) != ATLAS_OK)
+	{
+		return;
+	}
+
+	/* The image is relative to the JSON. */
+	char image[MAX_FILENAME_LEN];
+	const char* slash = strrchr(name, '/');
+	int dir_len = slash != NULL ? (int)(slash - name + 1) : 0;
+	snprintf(image, sizeof(image), "%.*s%s", dir_len, name, atlas.image);
+	atlas_free(&atlas);
+
+	size_t data_size = 0;
+	const void* data = vfs_get_file(image, &data_size);
+	if (data == NULL)
+	{
+		printf("No hulls for %s: %s is not mounted\n", name, image);
+		return;
+	}
+
+	int width;
+	int height;
+	int components;
+	uint8_t* rgba = stbi_load_from_memory((const stbi_uc*)data, (int)data_size, &width, &height, &components, STBI_rgb_alpha);
+	if (rgba == NULL)
+	{
+		printf("No hulls for %s: %s\n", name, stbi_failure_reason());
+		return;
+	}
+	int ret = atlas_add_hulls(blob, size, rgba, width, height);
+	stbi_image_free(rgba);
+	if (ret != ATLAS_OK || atlas_load(&atlas, *blob, *size) != ATLAS_OK)
+	{
+		printf("No hulls for %s\n", name);
+		return;
+	}
+
+	/* How much of the quads the hulls cover, a measure of the fragments saved. */
+	double quads = 0.0;
+	double hulls = 0.0;
+	int count = 0;
+	for (int i = 0; i < atlas.frames_count; i++)
+	{
+		double area = (double)atlas.frames[i].width * atlas.frames[i].height;
+		quads += area;
+		hulls += area * atlas_hull_area(&atlas.hulls[i]);
+		count += atlas.hulls[i].count > 0;
+	}
+	printf("Hulls for %s: %d of %d frames, %.1f%% of the quad area\n", name,
+		count, atlas.frames_count, quads > 0.0 ? 100.0 * hulls / quads : 100.0);
+	atlas_free(&atlas);
+}
+
+/**
+ * Replace a TexturePacker JSON atlas with a compiled atlas (see atlas.h), so
+ * the game can load it without parsing. Other JSON files are left as is.
+ *
+ * @return	0 if the atlas was compiled, -1 if it was left as is.
+ */
+static int pack_source_cook_atlas(struct pack_source* source)
+{
+	/* Only compile files that look like atlases, atlas_compile() complains
+	 * about anything else. */
+	if (!is_atlas_json(source->data, source->size))
+	{
+		return -1;
+	}
+
+	void* blob;
+	size_t size;
+	if (atlas_compile(source->data, source->size, &blob, &size) != ATLAS_OK)
+	{
+		printf("Could not cook %s: invalid atlas\n", source->name);
+		return -1;
+	}
+
+	if (cook_hulls)
+	{
+		cook_atlas_hulls(source->name, &blob, &size);
+	}
+
+	/* Cooked assets are released with free(). */
+	uint8_t* cooked = (uint8_t*)malloc(size);
+	if (cooked == NULL)
+	{
+		printf("Out of memory cooking %s\n", source->name);
+		engine_free(blob);
+		return -1;
+	}
+	memcpy(cooked, blob, size);
+	engine_free(blob);
+
+	source->cooked = cooked;
+	source->data = cooked;
+	source->size = size;
+	return 0;
+}
+
+/**
+ * Compress a file if that saves enough space to be worth decompressing it.
+ */
+static void pack_source_compress(struct pack_source* source)
+{
+	if (source->size == 0)
+	{
+		return;
+	}
+
+	size_t capacity = source->size - source->size / PACK_COMPRESS_MIN_SAVING;
+	void* compressed = malloc(capacity);
+	if (compressed == NULL)
+	{
+		return;
+	}
+
+	size_t compressed_size = compress_lz4(source->data, source->size, compressed, capacity);
+	if (compressed_size == 0)
+	{
+		free(compressed);
+		return;
+	}
+
+	source->compressed = compressed;
+	source->compressed_size = compressed_size;
+}
+
+/**
+ * Write every mounted file to assets.pack (see pack.h).
+ */
+int write_assets_pack()
+{
+	int count = vfs_file_count();
+	struct pack_source* sources = (struct pack_source*)calloc(count > 0 ? count : 1, sizeof(struct pack_source));
+	struct pack_entry* entries = (struct pack_entry*)calloc(count > 0 ? count : 1, sizeof(struct pack_entry));
+	if (sources == NULL || entries == NULL)
+	{
+		printf("Out of memory writing assets.pack\n");
+		free(sources);
+		free(entries);
+		return -1;
+	}
+
+	int cooked_count = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const char* name = vfs_get_simple_name(i);
+		sources[i].name = name;
+		sources[i].hash = vfs_hash(name);
+		sources[i].data = vfs_get_file(name, &sources[i].size);
+		if (sources[i].data == NULL)
+		{
+			sources[i].size = 0;
+		}
+		else if (has_extension(name, ext_texture, sizeof(ext_texture) / sizeof(ext_texture[0]))
+			&& strstr(name, ".hdr") == 0
+			&& pack_source_cook_texture(&sources[i]) == 0)
+		{
+			cooked_count++;
+		}
+		else if (has_extension(name, ext_sounds, sizeof(ext_sounds) / sizeof(ext_sounds[0]))
+			&& pack_source_cook_sound(&sources[i]) == 0)
+		{
+			cooked_count++;
+		}
+		else if (has_extension(name, ext_atlases, sizeof(ext_atlases) / sizeof(ext_atlases[0]))
+			&& pack_source_cook_atlas(&sources[i]) == 0)
+		{
+			cooked_count++;
+		}
+		pack_source_compress(&sources[i]);
+	}
+
+	/* Sorted by hash so the pack can be binary searched without the vfs. */
+	qsort(sources, count, sizeof(struct pack_source), pack_source_cmp);
+
+	struct pack_header header = { 0 };
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.count = count;
+
+	for (int i = 0; i < count; i++)
+	{
+		entries[i].hash = sources[i].hash;
+		entries[i].name = header.names_size;
+		header.names_size += strlen(sources[i].name) + 1;
+	}
+
+	uint64_t offset = sizeof(struct pack_header) + count * sizeof(struct pack_entry) + header.names_size;
+	uint64_t raw_total = 0;
+	for (int i = 0; i < count; i++)
+	{
+		offset = pack_align(offset);
+		entries[i].offset = offset;
+		entries[i].raw_size = sources[i].size;
+		entries[i].content_hash = hash_xxh64(sources[i].data, sources[i].size, 0);
+		if (sources[i].compressed != NULL)
+		{
+			entries[i].size = sources[i].compressed_size;
+			entries[i].flags = PACK_ENTRY_LZ4;
+		}
+		else
+		{
+			entries[i].size = sources[i].size;
+		}
+		offset += entries[i].size;
+		raw_total += sources[i].size;
+	}
+	header.size = offset;
+
+	FILE* fp = fopen("assets.pack", "wb");
+	if (fp == NULL)
+	{
+		printf("Could not open assets.pack for writing\n");
+		free(sources);
+		free(entries);
+		return -1;
+	}
+
+	fwrite(&header, sizeof(struct pack_header), 1, fp);
+	fwrite(entries, sizeof(struct pack_entry), count, fp);
+	for (int i = 0; i < count; i++)
+	{
+		fwrite(sources[i].name, 1, strlen(sources[i].name) + 1, fp);
+	}
+
+	offset = sizeof(struct pack_header) + count * sizeof(struct pack_entry) + header.names_size;
+	for (int i = 0; i < count; i++)
+	{
+		write_padding(fp, offset, entries[i].offset);
+		if (sources[i].compressed != NULL)
+		{
+			fwrite(sources[i].compressed, 1, sources[i].compressed_size, fp);
+		}
+		else
+		{
+			fwrite(sources[i].data, 1, sources[i].size, fp);
+		}
+		offset = entries[i].offset + entries[i].size;
+	}
+
+	int ret = ferror(fp) ? -1 : 0;
+	fclose(fp);
+
+	for (int i = 0; i < count; i++)
+	{
+		free(sources[i].compressed);
+		free(sources[i].cooked);
+	}
+	free(sources);
+	free(entries);
+
+	if (ret != 0)
+	{
+		printf("Could not write assets.pack\n");
+	}
+	else
+	{
+		printf("Wrote assets.pack: %d files (%d cooked), %lu bytes (%lu uncompressed)\n",
+			count, cooked_count, (unsigned long)header.size, (unsigned long)raw_total);
+	}
+
+	return ret;
+}
+
+/**
+ * Read the names of the images to pack at runtime from ATLASPACK_MANIFEST,
+ * if there is one.
+ */
+void read_atlaspack_manifest()
+{
+	size_t size = 0;
+	const char* data = (const char*)vfs_get_file(ATLASPACK_MANIFEST, &size);
+	if (data == NULL)
+	{
+		return;
+	}
+
+	for (size_t start = 0, end = 0; start < size; start = end + 1)
+	{
+		end = start;
+		while (end < size && data[end] != '\n')
+		{
+			end++;
+		}
+
+		/* Trim whitespace, including the \r of CRLF line endings. */
+		size_t name_start = start;
+		size_t name_end = end;
+		while (name_start < name_end && strchr(" \t\r", data[name_start]) != NULL)
+		{
+			name_start++;
+		}
+		while (name_end > name_start && strchr(" \t\r", data[name_end - 1]) != NULL)
+		{
+			name_end--;
+		}
+		if (name_start == name_end)
+		{
+			continue;
+		}
+
+		char* name = (char*)malloc(name_end - name_start + 1);
+		if (name == NULL)
+		{
+			printf("Out of memory reading %s\n", ATLASPACK_MANIFEST);
+			return;
+		}
+		memcpy(name, &data[name_start], name_end - name_start);
+		name[name_end - name_start] = '\0';
+		alist_append(atlaspack_names, name);
+	}
+}
+
+static int is_atlaspack_image(const char* name)
+{
+	foreach_alist(char*, image, i, atlaspack_names)
+	{
+		if (strcmp(image, name) == 0)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
 void add_assets()
 {
 	for (int i = 0, i_size = vfs_file_count(); i < i_size; i++)
@@ -211,9 +888,7 @@ void add_assets()
 		alist_append(assets_list, vfs_get_simple_name(i));
 	}
 
-	const char* ext_texture[] = { ".png", ".tga", ".jpeg", ".jpg", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".pnm" };
-	const char* ext_sounds[] = { ".ogg" };
-	const char* ext_shaders[] = { ".frag", ".vert" };
+	read_atlaspack_manifest();
 
 	foreach_alist(char*, asset, index, assets_list)
 	{
@@ -223,7 +898,7 @@ void add_assets()
 		{
 			if (strstr(asset, ext_texture[i]) != 0)
 			{
-				alist_append(assets_list_textures, asset);
+				alist_append(is_atlaspack_image(asset) ? assets_list_atlaspack : assets_list_textures, asset);
 				added = 1;
 				break;
 			}
@@ -266,6 +941,19 @@ void add_assets()
 
 		alist_append(assets_list_misc, asset);
 	}
+
+	foreach_alist(char*, image, i, atlaspack_names)
+	{
+		int found = 0;
+		foreach_alist(char*, asset, j, assets_list_atlaspack)
+		{
+			found |= (strcmp(asset, image) == 0);
+		}
+		if (!found)
+		{
+			printf("%s: no image named %s\n", ATLASPACK_MANIFEST, image);
+		}
+	}
 }
 
 int main(int argc, char* argv[])
@@ -276,11 +964,29 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--mips") == 0)
+		{
+			cook_mips = 1;
+		}
+		else if (strcmp(argv[i], "--hulls") == 0)
+		{
+			cook_hulls = 1;
+		}
+		else if (strcmp(argv[i], "--sfx-max") == 0 && i + 1 < argc)
+		{
+			cook_sound_max_seconds = atof(argv[++i]);
+		}
+	}
+
 	assets_list = alist_new(MAX_ASSETS);
 	assets_list_textures = alist_new(MAX_ASSETS);
 	assets_list_sounds = alist_new(MAX_ASSETS);
 	assets_list_shaders = alist_new(MAX_ASSETS);
 	assets_list_misc = alist_new(MAX_ASSETS);
+	assets_list_atlaspack = alist_new(MAX_ASSETS);
+	atlaspack_names = alist_new(MAX_ASSETS);
 
 	vfs_init(argv[1]);
 	add_assets(assets_list);
@@ -288,5 +994,10 @@ int main(int argc, char* argv[])
 	write_assets_c();
 	write_assets_h();
 
+	if (write_assets_pack() != 0)
+	{
+		return 1;
+	}
+
 	return 0;
 }
@@ -27,6 +27,8 @@
 #include "monotext.h"
 #include "console.h"
 #include "str.h"
+#include "mem.h"
+#include "particles.h"
 
 #include "core.h"
 #include "core_argv.h"
@@ -51,7 +53,7 @@
 #define PLAYER1_HIT		32.0f
 #define PLAYER2_HIT		608.0f
 
-#define PARTICLES_MAX	100
+#define BASIC_PARTICLES_MAX	100
 #define PARTICLE_ALPHA	0.5f
 
 #define SPRITE_TYPE_UNKNOWN		0
@@ -110,8 +112,9 @@ struct game {
 	struct basic_sprite		effectslayer;
 	struct ball				ball;
 	struct stats			total_stats;
-	struct basic_particle	particles[PARTICLES_MAX];
+	struct basic_particle	particles[BASIC_PARTICLES_MAX];
 	int						particles_count;
+	struct particles_effect	charge_effect;				/* Emitted from charged players. */
 	struct sound_emitter	*vivaldi_src;
 	sound_buf_t				tone_hit;
 	sound_buf_t				tone_bounce;
@@ -165,7 +168,7 @@ void basic_particle_init(struct basic_particle *p, float x, float y, float w, fl
 void basic_particle_new(float x, float y, float w, float h, float angle, float vx,
 	float vy, float va, float age_max)
 {
-	if (game->particles_count >= PARTICLES_MAX) {
+	if (game->particles_count >= BASIC_PARTICLES_MAX) {
 		printf("max particle count reached\n");
 		return;
 	}
@@ -180,19 +183,30 @@ int player_is_charged(struct player *p)
 	return p->charge >= 3200.0f;
 }
 
+/**
+ * Emit basic particles as described by a particle effect. The effect has no
+ * angular velocity, so particles spin at a small random rate.
+ */
+void basic_particles_emit_effect(const struct particles_effect *e, float x, float y)
+{
+	for (int i = 0, count = (int)randr(e->count_min, e->count_max); i < count; i++) {
+		basic_particle_new(x + randr(e->x_min, e->x_max),					// x
+			y + randr(e->y_min, e->y_max),									// y
+			randr(e->w_min, e->w_max),										// w
+			randr(e->h_min, e->h_max),										// h
+			randr(e->angle_min, e->angle_max),								// angle
+			randr(e->vx_min, e->vx_max),									// vx
+			randr(e->vy_min, e->vy_max),									// vy
+			randr(-(2 * M_PI) * 0.0001f, (2 * M_PI) * 0.0001f),				// va
+			randr(e->age_max_min, e->age_max_max)							// time_max
+			);
+	}
+}
+
 void think_player_charged(struct player *p, float dt)
 {
 	if (player_is_charged(p) && p->last_emit >= 16.0f) {
-		float size = randr(8.0f, 16.0f);
-		basic_particle_new(p->sprite.pos[0],											// x
-			p->sprite.pos[1] + randr(-PLAYER_HEIGHT / 2, PLAYER_HEIGHT / 2),	// y
-			size, size,														// w, h
-			randr(0, 2 * M_PI),												// angle
-			randr(-0.05f, 0.05f),											// vx
-			randr(-0.05f, 0.05f),											// vy
-			randr(-(2 * M_PI) * 0.0001f, (2 * M_PI) * 0.0001f),				// va
-			randr(200.0f, 600.0f)											// time_max
-			);
+		basic_particles_emit_effect(&game->charge_effect, p->sprite.pos[0], p->sprite.pos[1]);
 		p->last_emit = 0;
 	}
 	p->last_emit += dt;
@@ -509,7 +523,12 @@ void load_shaders()
 void load_atlases()
 {
 	/* Register asset callbacks */
-	vfs_register_callback("earl.json", core_reload_atlas, &game->atlas_earl);
+	vfs_register_loader("earl.json", core_decode_atlas, core_upload_atlas, &game->atlas_earl);
+}
+
+void load_effects()
+{
+	vfs_register_callback("charge.json", &core_reload_particles_effect, &game->charge_effect);
 }
 
 void release_sounds()
@@ -590,17 +609,20 @@ void game_init()
 
 void game_init_memory(struct shared_memory* shared_memory, int reload)
 {
-	if (!reload)
-	{
-		struct game tmp = { 0 };
-		memcpy(shared_memory->game_memory, &tmp, sizeof(tmp));
-	}
-
-	game = (struct game*)shared_memory->game_memory;
 	core_global = (struct core*)shared_memory->core;
 	assets = (struct assets*)shared_memory->assets;
 	vfs_global = shared_memory->vfs;
 	input_global = shared_memory->input;
+	mem_global = shared_memory->mem;
+
+	/* The first allocation is zeroed and placed at shared_memory->game_memory. */
+	if (!reload && game_alloc(sizeof(struct game), 16) == NULL)
+	{
+		core_error("Could not allocate game state\n");
+		exit(1);
+	}
+
+	game = (struct game*)shared_memory->game_memory;
 }
 
 void game_assets_load()
@@ -610,6 +632,7 @@ void game_assets_load()
 	load_shaders();
 	load_sounds();
 	load_atlases();
+	load_effects();
 	load_fonts();
 	load_console_conf();
 }
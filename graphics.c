@@ -21,6 +21,8 @@
 #include "math4.h"
 #include "texture.h"
 #include "color.h"
+#include "core.h"
+#include "mem.h"
 
 static const float rect_vertices[] = {
 	// Vertex			 // Texcoord
@@ -65,7 +67,7 @@ static int graphics_opengl_init(struct graphics *g, int view_width, int view_hei
 	/* Vertex buffer. */
 	glGenBuffers(1, &g->vbo_rect);
 	glBindBuffer(GL_ARRAY_BUFFER, g->vbo_rect);
-	glBufferData(GL_ARRAY_BUFFER, VBO_QUAD_LEN * sizeof(float),
+	graphics_buffer_data(GL_ARRAY_BUFFER, VBO_QUAD_LEN * sizeof(float),
 			rect_vertices, GL_STATIC_DRAW);
 
 	/* Vertex array. */
@@ -197,26 +199,86 @@ int graphics_init(struct graphics *g, think_func_t think, render_func_t render,
 	return GRAPHICS_OK;
 }
 
+/**
+ * Replacement for glBufferData() that accounts for GPU buffer memory when
+ * compiled with MEM_STATS.
+ */
+void graphics_buffer_data(GLenum target, size_t size, const void *data, GLenum usage)
+{
+#ifdef MEM_STATS
+	/* glBufferData() releases the previous storage of the buffer. */
+	GLint old_size = 0;
+	glGetBufferParameteriv(target, GL_BUFFER_SIZE, &old_size);
+	if(old_size > 0) {
+		mem_gpu_free(MEM_GPU_BUFFER, (size_t) old_size);
+	}
+#endif
+	glBufferData(target, size, data, usage);
+#ifdef MEM_STATS
+	mem_gpu_alloc(MEM_GPU_BUFFER, size);
+#endif
+}
+
+/**
+ * Replacement for glDeleteBuffers() that accounts for GPU buffer memory when
+ * compiled with MEM_STATS.
+ */
+void graphics_buffers_delete(GLsizei n, const GLuint *buffers)
+{
+#ifdef MEM_STATS
+	GLint bound = 0;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &bound);
+	for(GLsizei i=0; i<n; i++) {
+		if(buffers[i] == 0 || !glIsBuffer(buffers[i])) {
+			continue;
+		}
+		GLint size = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+		if(size > 0) {
+			mem_gpu_free(MEM_GPU_BUFFER, (size_t) size);
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, (GLuint) bound);
+#endif
+	glDeleteBuffers(n, buffers);
+}
+
 void graphics_free(struct core *core, struct graphics *g)
 {
 	/* Free resources. */
 	glDeleteVertexArrays(1, &g->vao_rect);
-	glDeleteBuffers(1, &g->vbo_rect);
+	graphics_buffers_delete(1, &g->vbo_rect);
 
 	/* Shut down glfw. */
 	glfwTerminate();
 }
 
-static void graphics_frames_register(struct frames *f, float delta_time)
+static void graphics_frames_register(struct frames *f, float delta_time, struct arena *frame_arena)
 {
+	struct mem_counters total;
+	mem_total(mem_global, &total);
+
 	f->frames++;
 	f->frame_time_min = fmin(delta_time, f->frame_time_min);
 	f->frame_time_max = fmax(delta_time, f->frame_time_max);
 	f->frame_time_sum += delta_time;
+	if(total.frame_allocs > f->mem_frame_allocs_max) {
+		f->mem_frame_allocs_max = total.frame_allocs;
+	}
 
 	if(now() - f->last_frame_report >= 1000.0) {
 		f->last_frame_report = now();
 		f->frame_time_avg = f->frame_time_sum / (float) f->frames;
+		f->frame_memory_peak = frame_arena->peak;
+		f->frame_memory_overflows = frame_arena->overflow_count;
+		f->mem_live = total.live;
+		f->mem_gpu = 0;
+		if(mem_global != NULL) {
+			for(int i=0; i<MEM_GPU_MAX; i++) {
+				f->mem_gpu += mem_global->gpu[i].live;
+			}
+		}
 		if(f->callback != NULL) {
 			f->callback(f);
 		}
@@ -224,6 +286,8 @@ static void graphics_frames_register(struct frames *f, float delta_time)
 		f->frame_time_min = FLT_MAX;
 		f->frame_time_sum = 0;
 		f->frames = 0;
+		f->mem_frame_allocs_max = 0;
+		arena_reset_stats(frame_arena);
 	}
 }
 
@@ -246,6 +310,12 @@ void graphics_do_frame(struct core* core, struct graphics *g)
 	}
 	g->frames.last_frame = now();
 
+	/* Release scratch memory allocated during the previous frame. */
+	arena_reset(&core->frame_arena);
+
+	/* Start counting allocations for this frame. */
+	mem_frame(mem_global);
+
 	/* Game loop. */
 	g->think(core, g, delta_time);
 	g->render(core, g, delta_time);
@@ -257,7 +327,7 @@ void graphics_do_frame(struct core* core, struct graphics *g)
 	glfwPollEvents();
 
 	/* Register that a frame has been drawn. */
-	graphics_frames_register(&g->frames, now() - before);
+	graphics_frames_register(&g->frames, now() - before, &core->frame_arena);
 }
 
 #ifdef EMSCRIPTEN
@@ -57,6 +57,11 @@ struct frames {
 	float		frame_time_max;
 	float		frame_time_sum;
 	float		frame_time_avg;
+	size_t		frame_memory_peak;			/* Highest per-frame scratch memory use since last report (bytes). */
+	size_t		frame_memory_overflows;		/* Scratch allocations that did not fit in frame memory since last report. */
+	size_t		mem_live;					/* Heap memory allocated by the engine (bytes, MEM_STATS only). */
+	size_t		mem_gpu;					/* GPU buffer and texture memory (bytes, MEM_STATS only). */
+	size_t		mem_frame_allocs_max;		/* Most heap allocations in a single frame since last report (MEM_STATS only). */
 	fps_func_t	callback;					/* A callback thas is called approximately every 1 sec. */
 };
 
@@ -84,6 +89,8 @@ int		graphics_init(struct graphics *g, think_func_t think, render_func_t render,
 				const char *title, int window_width, int window_height);
 void	graphics_free(struct core* core, struct graphics *g);
 void	graphics_loop();
+void	graphics_buffer_data(GLenum target, size_t size, const void *data, GLenum usage);
+void	graphics_buffers_delete(GLsizei n, const GLuint *buffers);
 
 double	now();
 
@@ -0,0 +1,134 @@
+/**
+ * Non-cryptographic hash functions.
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#define XXH_PRIME64_1	0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3	0x165667B19E3779F9ULL
+#define XXH_PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5	0x27D4EB2F165667C5ULL
+
+/**
+ * 32-bit FNV-1a hash of a block of memory. Fast and good enough for hash
+ * tables keyed by short strings such as file names.
+ */
+uint32_t hash_fnv1a(const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	uint32_t h = HASH_FNV1A_OFFSET;
+	for(size_t i=0; i<len; i++) {
+		h ^= p[i];
+		h *= HASH_FNV1A_PRIME;
+	}
+	return h;
+}
+
+/**
+ * 32-bit FNV-1a hash of a NULL-terminated string.
+ */
+uint32_t hash_fnv1a_str(const char *s)
+{
+	const unsigned char *p = (const unsigned char *) s;
+	uint32_t h = HASH_FNV1A_OFFSET;
+	while(*p != '\0') {
+		h ^= *p++;
+		h *= HASH_FNV1A_PRIME;
+	}
+	return h;
+}
+
+static uint64_t xxh_rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+/* Unaligned little-endian reads. */
+static uint64_t xxh_read64(const unsigned char *p)
+{
+	uint64_t v = 0;
+	for(int i=7; i>=0; i--) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static uint32_t xxh_read32(const unsigned char *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8)
+		| ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = xxh_rotl64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+	acc ^= xxh64_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/**
+ * 64-bit xxHash (XXH64) of a block of memory. Used for content hashes, where
+ * collisions between different file contents must be practically impossible.
+ */
+uint64_t hash_xxh64(const void *data, size_t len, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	const unsigned char *end = p + len;
+	uint64_t h;
+
+	if(len >= 32) {
+		const unsigned char *limit = end - 32;
+		uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = seed + XXH_PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH_PRIME64_1;
+		do {
+			v1 = xxh64_round(v1, xxh_read64(p));
+			v2 = xxh64_round(v2, xxh_read64(p + 8));
+			v3 = xxh64_round(v3, xxh_read64(p + 16));
+			v4 = xxh64_round(v4, xxh_read64(p + 24));
+			p += 32;
+		} while(p <= limit);
+		h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) + xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+		h = xxh64_merge_round(h, v1);
+		h = xxh64_merge_round(h, v2);
+		h = xxh64_merge_round(h, v3);
+		h = xxh64_merge_round(h, v4);
+	} else {
+		h = seed + XXH_PRIME64_5;
+	}
+
+	h += (uint64_t) len;
+
+	while(p + 8 <= end) {
+		h ^= xxh64_round(0, xxh_read64(p));
+		h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		p += 8;
+	}
+	if(p + 4 <= end) {
+		h ^= (uint64_t) xxh_read32(p) * XXH_PRIME64_1;
+		h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	while(p < end) {
+		h ^= (*p) * XXH_PRIME64_5;
+		h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
@@ -0,0 +1,19 @@
+/**
+ * Non-cryptographic hash functions.
+ */
+
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* FNV-1a parameters. */
+#define HASH_FNV1A_OFFSET	2166136261u
+#define HASH_FNV1A_PRIME	16777619u
+
+uint32_t	hash_fnv1a(const void *data, size_t len);
+uint32_t	hash_fnv1a_str(const char *s);
+uint64_t	hash_xxh64(const void *data, size_t len, uint64_t seed);
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * A pool of worker threads running jobs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "job.h"
+#include "mem.h"
+
+static void job_list_push(struct job **head, struct job **tail, struct job *job)
+{
+	job->next = NULL;
+	if(*tail != NULL) {
+		(*tail)->next = job;
+	} else {
+		*head = job;
+	}
+	*tail = job;
+}
+
+static struct job* job_list_pop(struct job **head, struct job **tail)
+{
+	struct job *job = *head;
+	if(job != NULL) {
+		*head = job->next;
+		if(*head == NULL) {
+			*tail = NULL;
+		}
+		job->next = NULL;
+	}
+	return job;
+}
+
+static void job_worker(void *arg)
+{
+	struct job_pool *pool = (struct job_pool *) arg;
+
+	thread_mutex_lock(&pool->lock);
+	for(;;) {
+		while(pool->queue == NULL && !pool->stop) {
+			thread_cond_wait(&pool->work, &pool->lock);
+		}
+		if(pool->queue == NULL) {
+			break;
+		}
+
+		struct job *job = job_list_pop(&pool->queue, &pool->queue_tail);
+		thread_mutex_unlock(&pool->lock);
+
+		job->fn(job->arg);
+
+		thread_mutex_lock(&pool->lock);
+		job_list_push(&pool->finished, &pool->finished_tail, job);
+		thread_cond_signal(&pool->done);
+	}
+	thread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Start the worker threads.
+ *
+ * @param pool			The pool to initialize.
+ * @param threads_count	Number of workers, or JOB_POOL_THREADS_DEFAULT. Capped
+ *						to JOB_POOL_THREADS_MAX.
+ * @return				JOB_OK. If fewer workers than requested could be
+ *						started, the pool makes do with those (or with none).
+ */
+int job_pool_init(struct job_pool *pool, int threads_count)
+{
+	memset(pool, 0, sizeof(struct job_pool));
+
+	if(threads_count == JOB_POOL_THREADS_DEFAULT) {
+		threads_count = thread_cpu_count() - 1;
+		if(threads_count < 1) {
+			threads_count = 1;
+		}
+	}
+	if(threads_count > JOB_POOL_THREADS_MAX) {
+		threads_count = JOB_POOL_THREADS_MAX;
+	}
+
+	thread_mutex_init(&pool->lock);
+	thread_cond_init(&pool->work);
+	thread_cond_init(&pool->done);
+
+	if(threads_count <= 0) {
+		return JOB_OK;
+	}
+
+	pool->threads = (struct thread *) engine_calloc(MEM_CORE, threads_count, sizeof(struct thread));
+	if(pool->threads == NULL) {
+		job_error("Out of memory, running jobs on the calling thread\n");
+		return JOB_OK;
+	}
+
+	for(int i=0; i<threads_count; i++) {
+		if(thread_create(&pool->threads[i], &job_worker, pool) != THREAD_OK) {
+			break;
+		}
+		pool->threads_count++;
+	}
+
+	if(pool->threads_count < threads_count) {
+		job_debug("Started %d of %d worker threads\n", pool->threads_count, threads_count);
+	}
+
+	return JOB_OK;
+}
+
+/**
+ * Stop the workers once the queued jobs have run. Jobs that have finished but
+ * have not been returned by job_pool_wait() are dropped.
+ */
+void job_pool_free(struct job_pool *pool)
+{
+	thread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	thread_cond_broadcast(&pool->work);
+	thread_mutex_unlock(&pool->lock);
+
+	for(int i=0; i<pool->threads_count; i++) {
+		thread_join(&pool->threads[i]);
+	}
+	engine_free(pool->threads);
+
+	thread_cond_free(&pool->done);
+	thread_cond_free(&pool->work);
+	thread_mutex_free(&pool->lock);
+	memset(pool, 0, sizeof(struct job_pool));
+}
+
+/**
+ * Queue a job. The job must stay valid until it is returned by
+ * job_pool_wait().
+ */
+void job_pool_submit(struct job_pool *pool, struct job *job)
+{
+	if(pool->threads_count == 0) {
+		job->fn(job->arg);
+		pool->pending++;
+		job_list_push(&pool->finished, &pool->finished_tail, job);
+		return;
+	}
+
+	thread_mutex_lock(&pool->lock);
+	pool->pending++;
+	job_list_push(&pool->queue, &pool->queue_tail, job);
+	thread_cond_signal(&pool->work);
+	thread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Wait for the next job to finish.
+ *
+ * @return	A finished job, in the order they finished, or NULL if no
+ *			submitted jobs are left.
+ */
+struct job* job_pool_wait(struct job_pool *pool)
+{
+	thread_mutex_lock(&pool->lock);
+	while(pool->finished == NULL && pool->pending > 0) {
+		thread_cond_wait(&pool->done, &pool->lock);
+	}
+	struct job *job = job_list_pop(&pool->finished, &pool->finished_tail);
+	if(job != NULL) {
+		pool->pending--;
+	}
+	thread_mutex_unlock(&pool->lock);
+	return job;
+}
@@ -0,0 +1,55 @@
+/**
+ * A pool of worker threads running jobs.
+ *
+ * Jobs are submitted by one thread (usually the main thread), which then picks
+ * up the finished jobs in the order they finish with job_pool_wait(). This
+ * lets the submitting thread do work that depends on a job, such as uploading
+ * decoded data to the GPU, while the workers keep running the other jobs.
+ *
+ * If no worker threads could be started (or the platform has none), jobs run
+ * on the submitting thread inside job_pool_submit().
+ */
+
+#ifndef _JOB_H
+#define _JOB_H
+
+#include "thread.h"
+
+#define job_debug(...) debugf("Job", __VA_ARGS__)
+#define job_error(...) errorf("Job", __VA_ARGS__)
+
+#define JOB_OK				0
+#define JOB_ERROR			-1
+
+/* Use one worker per CPU core, leaving one core for the main thread. */
+#define JOB_POOL_THREADS_DEFAULT	-1
+#define JOB_POOL_THREADS_MAX		8
+
+typedef void (*job_fn_t)(void *arg);
+
+struct job {
+	job_fn_t	fn;		/* Runs on a worker thread. */
+	void		*arg;
+	struct job	*next;	/* Queue link, owned by the pool. */
+};
+
+struct job_pool {
+	struct thread		*threads;
+	int					threads_count;
+	struct thread_mutex	lock;
+	struct thread_cond	work;		/* Signalled when a job is queued. */
+	struct thread_cond	done;		/* Signalled when a job is finished. */
+	struct job			*queue;		/* Jobs waiting for a worker. */
+	struct job			*queue_tail;
+	struct job			*finished;	/* Jobs not yet returned by job_pool_wait(). */
+	struct job			*finished_tail;
+	int					pending;	/* Jobs submitted but not yet returned by job_pool_wait(). */
+	int					stop;
+};
+
+int			job_pool_init(struct job_pool *pool, int threads_count);
+void		job_pool_free(struct job_pool *pool);
+void		job_pool_submit(struct job_pool *pool, struct job *job);
+struct job*	job_pool_wait(struct job_pool *pool);
+
+#endif
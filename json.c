@@ -0,0 +1,472 @@
+/**
+ * Streaming JSON reader.
+ *
+ * See json.h.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json.h"
+
+/* What the reader accepts next. */
+#define JSON_EXPECT_VALUE			0	/* A value (top level, after ':' or ','). */
+#define JSON_EXPECT_VALUE_OR_END	1	/* A value or ']' (after '['). */
+#define JSON_EXPECT_KEY				2	/* A key (after ',' in an object). */
+#define JSON_EXPECT_KEY_OR_END		3	/* A key or '}' (after '{'). */
+#define JSON_EXPECT_COMMA_OR_END	4	/* ',' or the end of the container. */
+#define JSON_EXPECT_DONE			5	/* Nothing but whitespace. */
+
+/* Longest number accepted, in characters. */
+#define JSON_NUMBER_MAX				64
+
+/**
+ * Begin reading a document.
+ *
+ * @param data	The JSON source (does not need to be \0 terminated). Tokens
+ *				point into it, so it must outlive them.
+ * @param len	The length of the JSON source.
+ */
+void json_init(struct json_reader *r, const void *data, size_t len)
+{
+	memset(r, 0, sizeof(struct json_reader));
+	r->data = (const char *) data;
+	r->len = len;
+	r->expect = JSON_EXPECT_VALUE;
+}
+
+static int json_fail(struct json_reader *r, struct json_token *t, const char *what)
+{
+	if(!r->error) {
+		int line = 1;
+		for(size_t i=0; i<r->pos && i<r->len; i++) {
+			if(r->data[i] == '\n') {
+				line++;
+			}
+		}
+		json_error("%s on line %d\n", what, line);
+		r->error = 1;
+	}
+	t->type = JSON_INVALID;
+	return JSON_INVALID;
+}
+
+static void json_skip_whitespace(struct json_reader *r)
+{
+	while(r->pos < r->len) {
+		char c = r->data[r->pos];
+		if(c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+			break;
+		}
+		r->pos++;
+	}
+}
+
+static int json_emit(struct json_reader *r, struct json_token *t, int type)
+{
+	t->type = type;
+	return type;
+}
+
+/**
+ * A value ended: either its container continues or the document is done.
+ */
+static int json_emit_value(struct json_reader *r, struct json_token *t, int type)
+{
+	r->expect = (r->depth > 0) ? JSON_EXPECT_COMMA_OR_END : JSON_EXPECT_DONE;
+	return json_emit(r, t, type);
+}
+
+static int json_in_object(struct json_reader *r)
+{
+	return (r->objects >> (r->depth - 1)) & 1;
+}
+
+static int json_open(struct json_reader *r, struct json_token *t, int object)
+{
+	if(r->depth >= JSON_DEPTH_MAX) {
+		return json_fail(r, t, "Nested too deep");
+	}
+	if(object) {
+		r->objects |= (uint64_t) 1 << r->depth;
+	} else {
+		r->objects &= ~((uint64_t) 1 << r->depth);
+	}
+	r->depth++;
+	r->pos++;
+	r->expect = object ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_VALUE_OR_END;
+	return json_emit(r, t, object ? JSON_OBJECT : JSON_ARRAY);
+}
+
+static int json_close(struct json_reader *r, struct json_token *t)
+{
+	r->depth--;
+	r->pos++;
+	return json_emit_value(r, t, (r->data[r->pos - 1] == '}') ? JSON_OBJECT_END : JSON_ARRAY_END);
+}
+
+/**
+ * Scan a string starting at the opening quote. The token gets the raw
+ * contents; escapes are only validated, json_string() decodes them.
+ */
+static int json_scan_string(struct json_reader *r, struct json_token *t)
+{
+	size_t start = ++r->pos;
+
+	while(r->pos < r->len) {
+		unsigned char c = (unsigned char) r->data[r->pos];
+		if(c == '"') {
+			t->str = r->data + start;
+			t->len = r->pos - start;
+			r->pos++;
+			return JSON_OK;
+		}
+		if(c < 0x20) {
+			json_fail(r, t, "Control character in string");
+			return JSON_ERROR;
+		}
+		if(c == '\\') {
+			r->pos++;
+			/* strchr() also finds the terminating \0, so reject it first. */
+			char e = (r->pos < r->len) ? r->data[r->pos] : '\0';
+			if(e == '\0' || strchr("\"\\/bfnrtu", e) == NULL) {
+				json_fail(r, t, "Invalid escape in string");
+				return JSON_ERROR;
+			}
+			if(e == 'u') {
+				for(int i=1; i<=4; i++) {
+					if(r->pos + i >= r->len || !isxdigit((unsigned char) r->data[r->pos + i])) {
+						json_fail(r, t, "Invalid \\u escape in string");
+						return JSON_ERROR;
+					}
+				}
+				r->pos += 4;
+			}
+		}
+		r->pos++;
+	}
+
+	json_fail(r, t, "Unterminated string");
+	return JSON_ERROR;
+}
+
+static int json_scan_number(struct json_reader *r, struct json_token *t)
+{
+	char buf[JSON_NUMBER_MAX + 1];
+	size_t start = r->pos;
+
+	while(r->pos < r->len && strchr("+-.eE0123456789", r->data[r->pos]) != NULL) {
+		r->pos++;
+	}
+
+	size_t len = r->pos - start;
+	if(len == 0 || len > JSON_NUMBER_MAX) {
+		return json_fail(r, t, "Invalid number");
+	}
+
+	/* strtod() needs a terminated string. */
+	memcpy(buf, r->data + start, len);
+	buf[len] = '\0';
+
+	char *end;
+	t->number = strtod(buf, &end);
+	if(end != buf + len) {
+		return json_fail(r, t, "Invalid number");
+	}
+	t->str = r->data + start;
+	t->len = len;
+	return json_emit_value(r, t, JSON_NUMBER);
+}
+
+static int json_scan_literal(struct json_reader *r, struct json_token *t, const char *literal, int type)
+{
+	size_t len = strlen(literal);
+	if(r->len - r->pos < len || memcmp(r->data + r->pos, literal, len) != 0) {
+		return json_fail(r, t, "Unexpected character");
+	}
+	r->pos += len;
+	return json_emit_value(r, t, type);
+}
+
+static int json_scan_value(struct json_reader *r, struct json_token *t)
+{
+	switch(r->data[r->pos]) {
+		case '{':
+			return json_open(r, t, 1);
+		case '[':
+			return json_open(r, t, 0);
+		case '"':
+			if(json_scan_string(r, t) != JSON_OK) {
+				return JSON_INVALID;
+			}
+			return json_emit_value(r, t, JSON_STRING);
+		case 't':
+			return json_scan_literal(r, t, "true", JSON_TRUE);
+		case 'f':
+			return json_scan_literal(r, t, "false", JSON_FALSE);
+		case 'n':
+			return json_scan_literal(r, t, "null", JSON_NULL);
+		default:
+			return json_scan_number(r, t);
+	}
+}
+
+static int json_scan_key(struct json_reader *r, struct json_token *t)
+{
+	if(r->data[r->pos] != '"') {
+		return json_fail(r, t, "Expected a key");
+	}
+	if(json_scan_string(r, t) != JSON_OK) {
+		return JSON_INVALID;
+	}
+	json_skip_whitespace(r);
+	if(r->pos >= r->len || r->data[r->pos] != ':') {
+		return json_fail(r, t, "Expected ':'");
+	}
+	r->pos++;
+	r->expect = JSON_EXPECT_VALUE;
+	return json_emit(r, t, JSON_KEY);
+}
+
+/**
+ * Read the next token.
+ *
+ * @return The type of the token, also stored in t->type. JSON_END once the
+ *         document has been read, JSON_INVALID on a syntax error.
+ */
+int json_next(struct json_reader *r, struct json_token *t)
+{
+	memset(t, 0, sizeof(struct json_token));
+
+	if(r->error) {
+		return JSON_INVALID;
+	}
+
+	json_skip_whitespace(r);
+
+	if(r->pos >= r->len) {
+		if(r->expect == JSON_EXPECT_DONE) {
+			return json_emit(r, t, JSON_END);
+		}
+		return json_fail(r, t, "Unexpected end of document");
+	}
+
+	char c = r->data[r->pos];
+
+	switch(r->expect) {
+		case JSON_EXPECT_VALUE_OR_END:
+			if(c == ']') {
+				return json_close(r, t);
+			}
+			return json_scan_value(r, t);
+		case JSON_EXPECT_VALUE:
+			return json_scan_value(r, t);
+		case JSON_EXPECT_KEY_OR_END:
+			if(c == '}') {
+				return json_close(r, t);
+			}
+			return json_scan_key(r, t);
+		case JSON_EXPECT_KEY:
+			return json_scan_key(r, t);
+		case JSON_EXPECT_COMMA_OR_END:
+			if(c == ',') {
+				r->pos++;
+				r->expect = json_in_object(r) ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+				return json_next(r, t);
+			}
+			if(c == (json_in_object(r) ? '}' : ']')) {
+				return json_close(r, t);
+			}
+			return json_fail(r, t, "Expected ',' or end of container");
+		default:
+			return json_fail(r, t, "Trailing characters");
+	}
+}
+
+/**
+ * Skip a value whose first token was just read, including everything inside
+ * it if it is an object or an array.
+ *
+ * @return JSON_OK on success, JSON_ERROR on a syntax error.
+ */
+int json_skip(struct json_reader *r, const struct json_token *t)
+{
+	struct json_token tmp;
+	int level = 0;
+
+	if(t->type == JSON_OBJECT || t->type == JSON_ARRAY) {
+		level = 1;
+	} else if(t->type == JSON_INVALID || t->type == JSON_END || t->type == JSON_KEY) {
+		return JSON_ERROR;
+	}
+
+	while(level > 0) {
+		switch(json_next(r, &tmp)) {
+			case JSON_OBJECT:
+			case JSON_ARRAY:
+				level++;
+				break;
+			case JSON_OBJECT_END:
+			case JSON_ARRAY_END:
+				level--;
+				break;
+			case JSON_INVALID:
+			case JSON_END:
+				return JSON_ERROR;
+		}
+	}
+
+	return JSON_OK;
+}
+
+/**
+ * Read the next member of an object. Call after JSON_OBJECT, then read (or
+ * skip) the value of each member before asking for the next one.
+ *
+ * @return 1 if key was set to the next key, 0 at the end of the object, -1 on
+ *         a syntax error.
+ */
+int json_object_next(struct json_reader *r, struct json_token *key)
+{
+	switch(json_next(r, key)) {
+		case JSON_KEY:
+			return 1;
+		case JSON_OBJECT_END:
+			return 0;
+		case JSON_INVALID:
+			return -1;
+		default:
+			json_fail(r, key, "Expected a key");
+			return -1;
+	}
+}
+
+/**
+ * Read the first token of the next value in an array. Call after JSON_ARRAY.
+ *
+ * @return 1 if value was set to the next value, 0 at the end of the array, -1
+ *         on a syntax error.
+ */
+int json_array_next(struct json_reader *r, struct json_token *value)
+{
+	switch(json_next(r, value)) {
+		case JSON_ARRAY_END:
+			return 0;
+		case JSON_INVALID:
+			return -1;
+		case JSON_KEY:
+		case JSON_OBJECT_END:
+		case JSON_END:
+			json_fail(r, value, "Expected a value");
+			return -1;
+		default:
+			return 1;
+	}
+}
+
+/**
+ * Compare a string or key with a C string. Escapes are not decoded, so only
+ * use this for names that do not need them.
+ */
+int json_equals(const struct json_token *t, const char *s)
+{
+	return (t->type == JSON_STRING || t->type == JSON_KEY)
+		&& strlen(s) == t->len
+		&& memcmp(t->str, s, t->len) == 0;
+}
+
+static unsigned int json_hex4(const char *s)
+{
+	unsigned int value = 0;
+	for(int i=0; i<4; i++) {
+		char c = s[i];
+		value <<= 4;
+		if(c >= '0' && c <= '9') {
+			value |= c - '0';
+		} else if(c >= 'a' && c <= 'f') {
+			value |= c - 'a' + 10;
+		} else if(c >= 'A' && c <= 'F') {
+			value |= c - 'A' + 10;
+		}
+	}
+	return value;
+}
+
+/**
+ * Decode a string or key into dst as UTF-8. Like snprintf(), the result is
+ * truncated to fit dst, and always \0 terminated if dst_size > 0.
+ *
+ * @param dst		Where to store the string, may be NULL if dst_size is 0.
+ * @param dst_size	Size of dst in bytes.
+ * @return			Length of the whole decoded string, not counting the \0.
+ */
+size_t json_string(const struct json_token *t, char *dst, size_t dst_size)
+{
+	size_t n = 0;
+
+	for(size_t i=0; i<t->len; i++) {
+		char out[4];
+		size_t out_len = 1;
+		out[0] = t->str[i];
+
+		if(t->str[i] == '\\' && i + 1 < t->len) {
+			char e = t->str[++i];
+			switch(e) {
+				case 'b': out[0] = '\b'; break;
+				case 'f': out[0] = '\f'; break;
+				case 'n': out[0] = '\n'; break;
+				case 'r': out[0] = '\r'; break;
+				case 't': out[0] = '\t'; break;
+				case 'u': {
+					unsigned int cp = 0;
+					if(i + 4 < t->len) {
+						cp = json_hex4(t->str + i + 1);
+						i += 4;
+					}
+					/* Surrogate pair. */
+					if(cp >= 0xd800 && cp < 0xdc00 && i + 6 < t->len
+							&& t->str[i + 1] == '\\' && t->str[i + 2] == 'u') {
+						unsigned int lo = json_hex4(t->str + i + 3);
+						if(lo >= 0xdc00 && lo < 0xe000) {
+							cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+							i += 6;
+						}
+					}
+					if(cp < 0x80) {
+						out[0] = (char) cp;
+					} else if(cp < 0x800) {
+						out[0] = (char) (0xc0 | (cp >> 6));
+						out[1] = (char) (0x80 | (cp & 0x3f));
+						out_len = 2;
+					} else if(cp < 0x10000) {
+						out[0] = (char) (0xe0 | (cp >> 12));
+						out[1] = (char) (0x80 | ((cp >> 6) & 0x3f));
+						out[2] = (char) (0x80 | (cp & 0x3f));
+						out_len = 3;
+					} else {
+						out[0] = (char) (0xf0 | (cp >> 18));
+						out[1] = (char) (0x80 | ((cp >> 12) & 0x3f));
+						out[2] = (char) (0x80 | ((cp >> 6) & 0x3f));
+						out[3] = (char) (0x80 | (cp & 0x3f));
+						out_len = 4;
+					}
+					break;
+				}
+				default: out[0] = e; break;
+			}
+		}
+
+		for(size_t j=0; j<out_len; j++, n++) {
+			if(n + 1 < dst_size) {
+				dst[n] = out[j];
+			}
+		}
+	}
+
+	if(dst_size > 0) {
+		dst[n < dst_size ? n : dst_size - 1] = '\0';
+	}
+
+	return n;
+}
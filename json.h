@@ -0,0 +1,87 @@
+/**
+ * Streaming JSON reader.
+ *
+ * Reads JSON one token at a time straight from a buffer of known length (it
+ * does not need to be \0 terminated) without allocating anything, so loaders
+ * can fill their own structs as they go instead of building a document tree.
+ *
+ * Example:
+ * @code
+ * struct json_reader r;
+ * struct json_token key, value;
+ *
+ * json_init(&r, data, size);
+ * if(json_next(&r, &value) != JSON_OBJECT) {
+ *     return ERROR;
+ * }
+ * while(json_object_next(&r, &key) > 0) {
+ *     json_next(&r, &value);
+ *     if(json_equals(&key, "speed") && value.type == JSON_NUMBER) {
+ *         speed = value.number;
+ *     } else if(json_skip(&r, &value) != JSON_OK) {
+ *         return ERROR;
+ *     }
+ * }
+ * if(r.error) {
+ *     return ERROR;
+ * }
+ * @endcode
+ */
+
+#ifndef _JSON_H
+#define _JSON_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "log.h"
+
+#define json_debug(...) debugf("JSON", __VA_ARGS__)
+#define json_error(...) errorf("JSON", __VA_ARGS__)
+
+#define JSON_OK		0
+#define JSON_ERROR	-1
+
+/* Maximum nesting of objects and arrays. */
+#define JSON_DEPTH_MAX	64
+
+/* Token types. */
+#define JSON_INVALID		0	/* Syntax error, see json_reader.error. */
+#define JSON_END			1	/* End of the document. */
+#define JSON_OBJECT			2	/* { */
+#define JSON_OBJECT_END		3	/* } */
+#define JSON_ARRAY			4	/* [ */
+#define JSON_ARRAY_END		5	/* ] */
+#define JSON_KEY			6	/* Name of an object member, the ':' is consumed. */
+#define JSON_STRING			7
+#define JSON_NUMBER			8
+#define JSON_TRUE			9
+#define JSON_FALSE			10
+#define JSON_NULL			11
+
+struct json_token {
+	int			type;		/* JSON_*. */
+	const char	*str;		/* Strings and keys: the raw contents between the quotes, escapes included. */
+	size_t		len;		/* Length of str. */
+	double		number;		/* JSON_NUMBER: the value. */
+};
+
+struct json_reader {
+	const char	*data;
+	size_t		len;
+	size_t		pos;		/* Offset of the next character to read. */
+	int			depth;		/* Number of open objects and arrays. */
+	uint64_t	objects;	/* Bit n is set if container n is an object. */
+	int			expect;		/* What may come next (JSON_EXPECT_*). */
+	int			error;		/* Set on the first syntax error, all later tokens are JSON_INVALID. */
+};
+
+void	json_init(struct json_reader *r, const void *data, size_t len);
+int		json_next(struct json_reader *r, struct json_token *t);
+int		json_skip(struct json_reader *r, const struct json_token *t);
+int		json_object_next(struct json_reader *r, struct json_token *key);
+int		json_array_next(struct json_reader *r, struct json_token *value);
+int		json_equals(const struct json_token *t, const char *s);
+size_t	json_string(const struct json_token *t, char *dst, size_t dst_size);
+
+#endif
@@ -18,12 +18,18 @@
 #include "input.h"
 #include "atlas.h"
 #include "animatedsprites.h"
+#include "spritebatch.h"
+#include "atlaspack.h"
 #include "color.h"
 #include "top-down/tiles.h"
 #include "drawable.h"
 #include "color.h"
 #include "collide.h"
 #include "sound.h"
+#include "vector.h"
+#include "mem.h"
+#include "mem.h"
+#include "vfs.h"
 
 #define xy_of(v) v[0], v[1]
 
@@ -35,6 +41,8 @@
 
 #define TILE_SIZE				16
 
+#define ANIM_DEFS_MAX			32
+
 #define LERP_FACTOR				0.0015f
 
 #define PLAYER_SPEED_MAX		0.05f
@@ -98,6 +106,15 @@ struct game_settings settings = {
 	.window_title		= "ld34",
 	.sound_listener		= { 0, 0, 0.0f },
 	.sound_distance_max = 9999999999.0f, // distance3f(vec3(0), sound_listener)
+	.game_memory_size	= 64 * 1024 * 1024,
+};
+
+/* An animation over consecutive atlas frames, starting at frame. */
+struct anim_def {
+	struct anim		*anim;
+	const char		*frame;
+	int				frame_count;
+	float			frame_length;
 };
 
 struct player_anims {
@@ -206,6 +223,8 @@ struct projectile {
 	float				explode_time;
 };
 
+VECTOR_DEFINE(projectile_vector, struct projectile)
+
 struct monster_phase0 {
 	int					sequence;
 	float				sequence_start;
@@ -224,7 +243,7 @@ struct monster {
 	struct rect				hitbox;
 	struct drawable			draw_hitbox;
 	vec2					base_pos;
-	struct alist			*projectiles;
+	struct projectile_vector	projectiles;
 	struct animatedsprites	*projectiles_batch;
 	struct monster_phase0	phase0;
 	float					hitpoints;
@@ -258,6 +277,7 @@ struct game {
 	struct atlas			atlas;
 	struct animatedsprites	*batcher;
 	struct animatedsprites	*ui;
+	struct spritebatch		images;					/* Sprites of the images in assets->atlaspack. */
 	struct anim				anim_idle_left;
 	struct anim				anim_idle_right;
 	struct anim				anim_idle_up;
@@ -317,12 +337,38 @@ struct game_settings* game_get_settings()
 	return &settings;
 }
 
+/* Assets used by every game state, and only by some of them. In lazy mode
+ * (see vfs_set_lazy()) they are loaded as the game, or the state, starts. */
+static const char *assets_play[] = {
+	"basic_shader.vert", "basic_shader.frag", "textures.png", "textures.json",
+	"arrow.png", "attack.ogg", "hurt.ogg", "laser.ogg", "miss.ogg", "roll.ogg",
+	"swing.ogg",
+};
+static const char *assets_menu[] = { "menu_start.png", "menu_quit.png", "select.ogg", "coin.ogg" };
+static const char *assets_over[] = { "game_over.png" };
+static const char *assets_win[] = { "win.png" };
+
+#define assets_request(names) assets_request_list(names, sizeof(names) / sizeof(names[0]))
+
+/**
+ * Load assets that have not been loaded yet.
+ */
+void assets_request_list(const char **names, int count)
+{
+	for(int i=0; i<count; i++) {
+		if(vfs_request(names[i]) != 0) {
+			core_error("Could not load %s\n", names[i]);
+		}
+	}
+}
+
 void game_set_state(int state)
 {
 	core_global->graphics.delta_time_factor = 1.0f;
 
 	switch(state) {
 		case GAME_STATE_MENU:
+			assets_request(assets_menu);
 			game->think = &game_state_menu_think;
 			game->render = &game_state_menu_render;
 			break;
@@ -332,10 +378,12 @@ void game_set_state(int state)
 			game->render = &game_state_play_render;
 			break;
 		case GAME_STATE_OVER:
+			assets_request(assets_over);
 			game->think = &game_state_over_think;
 			game->render = &game_state_over_render;
 			break;
 		case GAME_STATE_WIN:
+			assets_request(assets_win);
 			game->think = &game_state_win_think;
 			game->render = &game_state_win_render;
 			break;
@@ -347,15 +395,19 @@ void game_set_state(int state)
 
 void game_init_memory(struct shared_memory *shared_memory, int reload)
 {
-	if(!reload) {
-		memset(shared_memory->game_memory, 0, sizeof(struct game));
-	}
-
-	game = (struct game *) shared_memory->game_memory;
 	core_global = shared_memory->core;
 	assets = shared_memory->assets;
 	vfs_global = shared_memory->vfs;
 	input_global = shared_memory->input;
+	mem_global = shared_memory->mem;
+
+	/* The first allocation is zeroed and placed at shared_memory->game_memory. */
+	if(!reload && game_alloc(sizeof(struct game), 16) == NULL) {
+		core_error("Could not allocate game state\n");
+		exit(1);
+	}
+
+	game = (struct game *) shared_memory->game_memory;
 }
 
 static float distancef(float x, float y)
@@ -676,7 +728,7 @@ static void player_think(struct player *p, float dt)
 			}
 
 			/* Touches projectile? */
-			foreach_alist(struct projectile *, projectile, i, game->monster.projectiles) {
+			foreach_vector(struct projectile, projectile, &game->monster.projectiles) {
 				/* Ignore if dead or exploding. */
 				if(projectile->dead || projectile->explode_time != 0) {
 					continue;
@@ -751,9 +803,12 @@ void projectile_init(struct projectile *p, float x, float y,
 
 void monster_spawn_projectile(struct monster *m, float x, float y, float vx, float vy, int sound)
 {
-	struct projectile *p = calloc(1, sizeof(struct projectile));
+	struct projectile *p = projectile_vector_push(&m->projectiles);
+	if(p == NULL) {
+		errorf("Game", "Out of memory\n");
+		return;
+	}
 	projectile_init(p, x, y, vx, vy, m->projectiles_batch);
-	alist_append(m->projectiles, p);
 
 	if(sound) {
 		sound_buf_play_detailed(&core_global->sound, assets->sounds.laser, game->sound_pos, game->sound_pos, 0, 0.5f, randr(0.8f, 1.0f), 0);
@@ -801,26 +856,31 @@ void projectile_think(struct projectile *p, float dt)
 	set2f(p->sprite.position, xy_of(p->hitbox.pos));
 }
 
+static int projectile_is_dead(struct projectile *p, void *ctx)
+{
+	return p->dead;
+}
+
 void projectiles_think(struct monster *m, float dt)
 {
 	animatedsprites_clear(m->projectiles_batch);
 
-	foreach_alist(struct projectile *, p, i, m->projectiles) {
+	foreach_vector(struct projectile, p, &m->projectiles) {
 		projectile_think(p, dt);
+	}
 
-		if(p->dead) {
-			alist_delete_at(m->projectiles, i, 1);
-			i--;
-		} else {
-			animatedsprites_add(m->projectiles_batch, &p->sprite);
-		}
+	/* Compact before handing out sprite pointers to the batch. */
+	projectile_vector_remove_if(&m->projectiles, &projectile_is_dead, NULL);
+
+	foreach_vector(struct projectile, p, &m->projectiles) {
+		animatedsprites_add(m->projectiles_batch, &p->sprite);
 	}
 }
 
 void projectiles_clear(struct monster *m)
 {
 	animatedsprites_clear(game->monster.projectiles_batch);
-	alist_clear(game->monster.projectiles, 1);
+	projectile_vector_clear(&game->monster.projectiles);
 }
 
 float angle_from_to(vec2 a, vec2 b)
@@ -1007,6 +1067,28 @@ void game_reset()
 	game_init();
 }
 
+/**
+ * Render a sprite of one of the images in assets->atlaspack. Nothing is drawn
+ * until the image has been loaded.
+ */
+void image_render(struct basic_sprite *sprite, const char *image, struct graphics *g)
+{
+	GLuint tex;
+	const struct atlas_frame *frame = atlaspack_frame(&assets->atlaspack, image, &tex);
+	if(frame == NULL) {
+		return;
+	}
+	set4f(sprite->uv, frame->uv[0], frame->uv[1], frame->uv[2], frame->uv[3]);
+
+	mat4 id;
+	identity(id);
+
+	spritebatch_begin(&game->images);
+	sprite_batch(sprite, &game->images);
+	spritebatch_end(&game->images);
+	spritebatch_render(&game->images, SHADER, g, tex, id);
+}
+
 void game_state_over_think(struct core *core, struct graphics *g, float dt)
 {
 	game_state_play_think(core, g, dt);
@@ -1031,7 +1113,7 @@ void game_state_over_render(struct core *core, struct graphics *g, float dt)
 	
 	game_state_play_render(core, g, dt);
 
-	sprite_render(&game->state_over.sprite, SHADER, g);
+	image_render(&game->state_over.sprite, "game_over.png", g);
 }
 
 #define WIN_FADE_IN_TIME	1000.0f
@@ -1075,7 +1157,7 @@ void game_state_win_render(struct core *core, struct graphics *g, float dt)
 	
 	game_state_play_render(core, g, dt);
 
-	sprite_render(&game->state_win.sprite, SHADER, g);
+	image_render(&game->state_win.sprite, "win.png", g);
 }
 
 void game_state_menu_think(struct core *core, struct graphics *g, float dt)
@@ -1094,7 +1176,6 @@ void game_state_menu_think(struct core *core, struct graphics *g, float dt)
 			|| key_pressed(GLFW_KEY_UP)) {
 		sound_buf_play(&core_global->sound, assets->sounds.select, game->sound_pos);
 		menu->quit_selected = !menu->quit_selected;
-		menu->sprite.texture = menu->quit_selected ? &assets->textures.menu_quit : &assets->textures.menu_start;
 	}
 
 	if(key_pressed(GLFW_KEY_ENTER)
@@ -1144,7 +1225,7 @@ void game_state_play_render(struct core *core, struct graphics *g, float dt)
 	transpose_same(monster_view);
 
 	/* Render */
-	sprite_render(&game->player.arrow, SHADER, g);
+	image_render(&game->player.arrow, "arrow.png", g);
 	animatedsprites_render(game->batcher, SHADER, g, TEXTURES, view);
 	animatedsprites_render(game->monster.batcher, SHADER, g, TEXTURES, monster_view);
 	animatedsprites_render(game->monster.projectiles_batch, SHADER, g, TEXTURES, view);
@@ -1175,7 +1256,7 @@ void game_state_menu_render(struct core *core, struct graphics *g, float dt)
 {
 	glClearColor(rgba(COLOR_BLACK));
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	sprite_render(&game->state_menu.sprite, SHADER, g);
+	image_render(&game->state_menu.sprite, game->state_menu.quit_selected ? "menu_quit.png" : "menu_start.png", g);
 }
 
 void game_think(struct core *core, struct graphics *g, float dt)
@@ -1380,35 +1461,60 @@ static void player_init(struct player *p)
 
 	/* Arrow */
 	p->arrow.type = 0;
-	p->arrow.texture = &assets->textures.arrow;
 	set4f(p->arrow.pos, p->hitbox.pos[0], p->hitbox.pos[1], 0.0f, 1.0f);
 	set4f(p->arrow.scale, 48, 16, 1.0f, 1.0f);
 	copyv(p->arrow.color, COLOR_WHITE);
 }
 
+/**
+ * Resolve the first frames of a set of looping animations with one batch
+ * lookup in the atlas.
+ */
+void anims_init(const struct anim_def *defs, int count)
+{
+	const char *names[ANIM_DEFS_MAX];
+	int frames[ANIM_DEFS_MAX];
+
+	if(count > ANIM_DEFS_MAX) {
+		core_error("Too many animations (%d > %d)\n", count, ANIM_DEFS_MAX);
+		count = ANIM_DEFS_MAX;
+	}
+
+	for(int i=0; i<count; i++) {
+		names[i] = defs[i].frame;
+	}
+	atlas_frame_indices(&game->atlas, names, frames, count);
+
+	for(int i=0; i<count; i++) {
+		animatedsprites_setanim(defs[i].anim, 1, frames[i], defs[i].frame_count, defs[i].frame_length);
+	}
+}
+
 void monster_anims_init(struct monster_anims *a)
 {
-	animatedsprites_setanim(&a->head_left,		1, atlas_frame_index(&game->atlas, "monster_head_left"),	1, 150.0f);
-	animatedsprites_setanim(&a->head_right,		1, atlas_frame_index(&game->atlas, "monster_head_right"),	1, 150.0f);
-	animatedsprites_setanim(&a->arm_left,		1, atlas_frame_index(&game->atlas, "monster_arm_left_1"),	2, 150.0f);
-	animatedsprites_setanim(&a->eye_left,		1, atlas_frame_index(&game->atlas, "monster_eye_left"),		1, 150.0f);
-	animatedsprites_setanim(&a->eye_right,		1, atlas_frame_index(&game->atlas, "monster_eye_right"),	1, 150.0f);
-	animatedsprites_setanim(&a->arm_right,		1, atlas_frame_index(&game->atlas, "monster_arm_right_1"),	2, 150.0f);
-	animatedsprites_setanim(&a->belly_1,		1, atlas_frame_index(&game->atlas, "monster_belly_1"),		1, 150.0f);
-	animatedsprites_setanim(&a->belly_2,		1, atlas_frame_index(&game->atlas, "monster_belly_2"),		1, 150.0f);
-	animatedsprites_setanim(&a->belly_3,		1, atlas_frame_index(&game->atlas, "monster_belly_3"),		1, 150.0f);
-	animatedsprites_setanim(&a->belly_4,		1, atlas_frame_index(&game->atlas, "monster_belly_4"),		1, 150.0f);
-	animatedsprites_setanim(&a->feet_1,			1, atlas_frame_index(&game->atlas, "monster_feet_1"),		2, 200.0f);
-	animatedsprites_setanim(&a->feet_2,			1, atlas_frame_index(&game->atlas, "monster_feet_2"),		2, 200.0f);
-	animatedsprites_setanim(&a->feet_3,			1, atlas_frame_index(&game->atlas, "monster_feet_3"),		2, 200.0f);
-	animatedsprites_setanim(&a->feet_4,			1, atlas_frame_index(&game->atlas, "monster_feet_4"),		2, 200.0f);
-	animatedsprites_setanim(&a->shadow_1,		1, atlas_frame_index(&game->atlas, "monster_shadow_1"),		1, 200.0f);
-	animatedsprites_setanim(&a->shadow_2,		1, atlas_frame_index(&game->atlas, "monster_shadow_2"),		1, 200.0f);
-	animatedsprites_setanim(&a->shadow_3,		1, atlas_frame_index(&game->atlas, "monster_shadow_3"),		1, 200.0f);
-	animatedsprites_setanim(&a->shadow_4,		1, atlas_frame_index(&game->atlas, "monster_shadow_4"),		1, 200.0f);
-
-
-	animatedsprites_setanim(&game->anim_projectile,		1, atlas_frame_index(&game->atlas, "projectile_1"),			3, 50.0f);
+	const struct anim_def defs[] = {
+		{ &a->head_left,			"monster_head_left",	1, 150.0f },
+		{ &a->head_right,			"monster_head_right",	1, 150.0f },
+		{ &a->arm_left,				"monster_arm_left_1",	2, 150.0f },
+		{ &a->eye_left,				"monster_eye_left",		1, 150.0f },
+		{ &a->eye_right,			"monster_eye_right",	1, 150.0f },
+		{ &a->arm_right,			"monster_arm_right_1",	2, 150.0f },
+		{ &a->belly_1,				"monster_belly_1",		1, 150.0f },
+		{ &a->belly_2,				"monster_belly_2",		1, 150.0f },
+		{ &a->belly_3,				"monster_belly_3",		1, 150.0f },
+		{ &a->belly_4,				"monster_belly_4",		1, 150.0f },
+		{ &a->feet_1,				"monster_feet_1",		2, 200.0f },
+		{ &a->feet_2,				"monster_feet_2",		2, 200.0f },
+		{ &a->feet_3,				"monster_feet_3",		2, 200.0f },
+		{ &a->feet_4,				"monster_feet_4",		2, 200.0f },
+		{ &a->shadow_1,				"monster_shadow_1",		1, 200.0f },
+		{ &a->shadow_2,				"monster_shadow_2",		1, 200.0f },
+		{ &a->shadow_3,				"monster_shadow_3",		1, 200.0f },
+		{ &a->shadow_4,				"monster_shadow_4",		1, 200.0f },
+
+		{ &game->anim_projectile,	"projectile_1",			3, 50.0f },
+	};
+	anims_init(defs, sizeof(defs) / sizeof(defs[0]));
 }
 
 #define monster_switchanim(m, x) animatedsprites_switchanim(&m->sprites.x, &m->anims.x)
@@ -1523,10 +1629,8 @@ void monster_init(struct monster *m)
 	animatedsprites_add(game->batcher, &s->shadow_4);
 
 	/* Projectile(s) */
-	if(m->projectiles != NULL) {
-		alist_free(m->projectiles, 1);
-	}
-	m->projectiles = alist_new(128);
+	projectile_vector_free(&m->projectiles);
+	projectile_vector_init(&m->projectiles, 128);
 
 	if(m->projectiles_batch != NULL) {
 		animatedsprites_destroy(m->projectiles_batch);
@@ -1536,27 +1640,30 @@ void monster_init(struct monster *m)
 
 void player_anims_init(struct player_anims *a)
 {
-	/* Use 1 frame from walk frames for idle anim. */
-	animatedsprites_setanim(&game->anim_idle_left,	1, atlas_frame_index(&game->atlas, "player_walk_left_2"),	1, 300.0f);
-	animatedsprites_setanim(&game->anim_idle_right,	1, atlas_frame_index(&game->atlas, "player_walk_right_2"),	1, 300.0f);
-	animatedsprites_setanim(&game->anim_idle_up,	1, atlas_frame_index(&game->atlas, "player_walk_up_2"),		1, 300.0f);
-	animatedsprites_setanim(&game->anim_idle_down,	1, atlas_frame_index(&game->atlas, "player_idle_1"),		2, 300.0f);
-
-	animatedsprites_setanim(&game->anim_walk_right, 1, atlas_frame_index(&game->atlas, "player_walk_right_1"),	4, 150.0f);
-	animatedsprites_setanim(&game->anim_walk_left,	1, atlas_frame_index(&game->atlas, "player_walk_left_1"),	4, 150.0f);
-	animatedsprites_setanim(&game->anim_walk_up,	1, atlas_frame_index(&game->atlas, "player_walk_up_1"),		4, 150.0f);
-	animatedsprites_setanim(&game->anim_walk_down,	1, atlas_frame_index(&game->atlas, "player_walk_down_1"),	4, 150.0f);
-	animatedsprites_setanim(&game->anim_shadow,		1, atlas_frame_index(&game->atlas, "player_shadow"),		1, 150.0f);
-	animatedsprites_setanim(&game->anim_bar_hp,		1, atlas_frame_index(&game->atlas, "bar_hp"),				1, 150.0f);
-	animatedsprites_setanim(&game->anim_bar_empty,	1, atlas_frame_index(&game->atlas, "bar_empty"),			1, 150.0f);
-	animatedsprites_setanim(&game->anim_bar_sta,	1, atlas_frame_index(&game->atlas, "bar_sta"),				1, 150.0f);
-
-	animatedsprites_setanim(&a->attack_left,		1, atlas_frame_index(&game->atlas, "attack_left"),			1, 150.0f);
-	animatedsprites_setanim(&a->attack_right,		1, atlas_frame_index(&game->atlas, "attack_right"),			1, 150.0f);
-	animatedsprites_setanim(&a->attack_down,		1, atlas_frame_index(&game->atlas, "attack_down_1"),		3, PLAYER_ATTACK_TIME/3.0f);
-	animatedsprites_setanim(&a->attack_up,			1, atlas_frame_index(&game->atlas, "attack_up"),			1, 150.0f);
-	
-	animatedsprites_setanim(&a->arrow,				1, atlas_frame_index(&game->atlas, "arrow"),				1, 150.0f);
+	const struct anim_def defs[] = {
+		/* Use 1 frame from walk frames for idle anim. */
+		{ &game->anim_idle_left,	"player_walk_left_2",	1, 300.0f },
+		{ &game->anim_idle_right,	"player_walk_right_2",	1, 300.0f },
+		{ &game->anim_idle_up,		"player_walk_up_2",		1, 300.0f },
+		{ &game->anim_idle_down,	"player_idle_1",		2, 300.0f },
+
+		{ &game->anim_walk_right,	"player_walk_right_1",	4, 150.0f },
+		{ &game->anim_walk_left,	"player_walk_left_1",	4, 150.0f },
+		{ &game->anim_walk_up,		"player_walk_up_1",		4, 150.0f },
+		{ &game->anim_walk_down,	"player_walk_down_1",	4, 150.0f },
+		{ &game->anim_shadow,		"player_shadow",		1, 150.0f },
+		{ &game->anim_bar_hp,		"bar_hp",				1, 150.0f },
+		{ &game->anim_bar_empty,	"bar_empty",			1, 150.0f },
+		{ &game->anim_bar_sta,		"bar_sta",				1, 150.0f },
+
+		{ &a->attack_left,			"attack_left",			1, 150.0f },
+		{ &a->attack_right,			"attack_right",			1, 150.0f },
+		{ &a->attack_down,			"attack_down_1",		3, PLAYER_ATTACK_TIME/3.0f },
+		{ &a->attack_up,			"attack_up",			1, 150.0f },
+
+		{ &a->arrow,				"arrow",				1, 150.0f },
+	};
+	anims_init(defs, sizeof(defs) / sizeof(defs[0]));
 }
 
 void game_state_menu_init(struct state_menu *menu)
@@ -1569,7 +1676,6 @@ void game_state_menu_init(struct state_menu *menu)
 	/* Menu sprite */
 	struct basic_sprite *s = &menu->sprite;
 	s->type = 0;
-	s->texture = &assets->textures.menu_start;
 	set4f(s->pos, VIEW_WIDTH / 2.0f, VIEW_HEIGHT / 2.0f, 0.0f, 1.0f);
 	set4f(s->scale, VIEW_WIDTH, VIEW_HEIGHT, 1.0f, 1.0f);
 	copyv(s->color, COLOR_WHITE);
@@ -1583,7 +1689,6 @@ void game_state_over_init(struct state_over *state)
 
 	/* Menu sprite */
 	s->type = 0;
-	s->texture = &assets->textures.game_over;
 	set4f(s->pos, VIEW_WIDTH / 2.0f, VIEW_HEIGHT / 2.0f, 0.0f, 1.0f);
 	set4f(s->scale, VIEW_WIDTH, VIEW_HEIGHT, 1.0f, 1.0f);
 	copyv(s->color, COLOR_WHITE);
@@ -1597,7 +1702,6 @@ void game_state_win_init(struct state_win *state)
 
 	/* Menu sprite */
 	s->type = 0;
-	s->texture = &assets->textures.win;
 	set4f(s->pos, VIEW_WIDTH / 2.0f, VIEW_HEIGHT / 2.0f, 0.0f, 1.0f);
 	//set4f(s->scale, VIEW_WIDTH, VIEW_HEIGHT, 1.0f, 1.0f);
 	set4f(s->scale, 0, 0, 1.0f, 1.0f);
@@ -1611,6 +1715,9 @@ void game_init()
 	game->lerp_factor = LERP_FACTOR;
 	set3f(game->sound_pos, 0, 0, 0);
 
+	/* The atlas must be loaded before the animations are created. */
+	assets_request(assets_play);
+
 	/* Init game states. */
 	game_state_menu_init(&game->state_menu);
 	game_state_over_init(&game->state_over);
@@ -1628,15 +1735,21 @@ void game_init()
 	} else {
 		animatedsprites_clear(game->batcher);
 	}
+	if(game->images.vbo == 0) {
+		spritebatch_create(&game->images);
+	}
 
 	/* Create animations. */
 	player_anims_init(&game->player.anims);
-	animatedsprites_setanim(&game->anim_grass_1,		1, atlas_frame_index(&game->atlas, "grass_1"),		1, 150.0f);
-	animatedsprites_setanim(&game->anim_grass_2,		1, atlas_frame_index(&game->atlas, "grass_2"),		1, 150.0f);
-	animatedsprites_setanim(&game->anim_grass_3,		1, atlas_frame_index(&game->atlas, "grass_3"),		1, 150.0f);
-	animatedsprites_setanim(&game->anim_grass_stone,	1, atlas_frame_index(&game->atlas, "grass_stone"),	1, 150.0f);
-	animatedsprites_setanim(&game->anim_grass_sand_1,	1, atlas_frame_index(&game->atlas, "grass_sand_1"),	1, 150.0f);
-	animatedsprites_setanim(&game->anim_grass_sand_2,	1, atlas_frame_index(&game->atlas, "grass_sand_2"),	1, 150.0f);
+	const struct anim_def tile_defs[] = {
+		{ &game->anim_grass_1,		"grass_1",		1, 150.0f },
+		{ &game->anim_grass_2,		"grass_2",		1, 150.0f },
+		{ &game->anim_grass_3,		"grass_3",		1, 150.0f },
+		{ &game->anim_grass_stone,	"grass_stone",	1, 150.0f },
+		{ &game->anim_grass_sand_1,	"grass_sand_1",	1, 150.0f },
+		{ &game->anim_grass_sand_2,	"grass_sand_2",	1, 150.0f },
+	};
+	anims_init(tile_defs, sizeof(tile_defs) / sizeof(tile_defs[0]));
 
 	/* Create monster. */
 	monster_init(&game->monster);
@@ -1666,17 +1779,26 @@ void game_key_callback(struct core *core, struct input *input, GLFWwindow *windo
 void game_assets_load()
 {
 	assets_load();
-	vfs_register_callback("textures.json", core_reload_atlas, &game->atlas);
+	vfs_register_loader("textures.json", core_decode_atlas, core_upload_atlas, &game->atlas);
 }
 
 void game_assets_release()
 {
 	assets_release();
 	atlas_free(&game->atlas);
+	spritebatch_destroy(&game->images);
 }
 
 void game_fps_callback(struct frames *f)
 {
-	core_debug("FPS:% 5d, MS:% 3.1f/% 3.1f/% 3.1f\n", f->frames,
-			f->frame_time_min, f->frame_time_avg, f->frame_time_max);
+	core_debug("FPS:% 5d, MS:% 3.1f/% 3.1f/% 3.1f, FRAME MEM: %lu KiB (%lu overflows)\n", f->frames,
+			f->frame_time_min, f->frame_time_avg, f->frame_time_max,
+			(unsigned long) (f->frame_memory_peak / 1024),
+			(unsigned long) f->frame_memory_overflows);
+#ifdef MEM_STATS
+	core_debug("MEM: %lu KiB, GPU: %lu KiB, ALLOCS/FRAME: %lu\n",
+			(unsigned long) (f->mem_live / 1024),
+			(unsigned long) (f->mem_gpu / 1024),
+			(unsigned long) f->mem_frame_allocs_max);
+#endif
 }
@@ -9,6 +9,9 @@
 #include <string.h>
 
 #include "list.h"
+#include "pool.h"
+
+#define LIST_ELEMENT_POOL_CHUNK	256
 
 struct list {
 	struct element *head;
@@ -20,6 +23,13 @@ struct element {
 	struct element *prev;
 };
 
+/**
+ * All list elements are allocated from this pool. It is initialized on first
+ * use and not locked, so lists may only be used from the main thread (not
+ * from jobs or vfs decode callbacks).
+ */
+static struct pool list_element_pool = { 0 };
+
 /**
  * Initializes an allocated list element with the specified data.
  *
@@ -37,6 +47,7 @@ void list_element_init(struct element *e, void *data)
 
 /**
  * Allocates and initializes a new list element with the specified data.
+ * Main thread only, see list_element_pool.
  *
  * @param data	The data to assign to the new element.
  * @return	A pointer to the new element.
@@ -44,7 +55,13 @@ void list_element_init(struct element *e, void *data)
  */
 struct element* list_element_new(void *data)
 {
-	struct element *tmp = malloc(sizeof(struct element));
+	if(list_element_pool.size == 0
+			&& pool_init(&list_element_pool, sizeof(struct element),
+				sizeof(void *), LIST_ELEMENT_POOL_CHUNK) != POOL_OK) {
+		return NULL;
+	}
+
+	struct element *tmp = pool_alloc(&list_element_pool);
 
 	if(tmp == NULL) {
 		return NULL;
@@ -66,7 +83,7 @@ void list_element_free(struct element *e, int free_data)
 	if(free_data) {
 		free(e->data);
 	}
-	free(e);
+	pool_free(&list_element_pool, e);
 }
 
 /**
@@ -1,5 +1,6 @@
 ﻿#include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -10,6 +11,7 @@
 #include "log.h"
 #include "vfs.h"
 #include "assets.h"
+#include "mem.h"
 
 #include "core.h"
 #include "core_argv.h"
@@ -25,6 +27,10 @@ struct core *core_global = &core_mem;
 struct vfs vfs_mem = { 0 };
 struct vfs *vfs_global = &vfs_mem;
 
+/* Memory stats singleton. */
+struct mem_stats mem_stats_mem = { 0 };
+struct mem_stats *mem_global = &mem_stats_mem;
+
 /* Input singleton. */
 struct input *input_global = NULL;
 
@@ -98,25 +104,31 @@ void* load_copy(const char* filename, unsigned int size, void* data)
 {
 	char name[256];
 
-	char* tmp = strrchr(filename, (int)'/');
+	const char* tmp = strrchr(filename, (int)'/');
 	if (tmp)
 	{
 		tmp++;
-		int namebegin = strlen(filename) - strlen(tmp);
-		strcpy(name, filename);
-		strcpy(&name[namebegin], "runtime_");
-		strcpy(&name[namebegin + 8], tmp);
+		snprintf(name, sizeof(name), "%.*sruntime_%s", (int)(tmp - filename), filename, tmp);
 	}
 	else
 	{
-		strcpy(name, "runtime_");
-		strcpy(name, filename);
+		snprintf(name, sizeof(name), "runtime_%s", filename);
 	}
 
 	FILE *fp;
 	fp = fopen(name, "wb+");
-	fwrite(data, sizeof(char), (size_t)size, fp);
+	if (fp == NULL)
+	{
+		errorf("Main", "Could not write %s\n", name);
+		return 0;
+	}
+	size_t written = fwrite(data, sizeof(char), (size_t)size, fp);
 	fclose(fp);
+	if (written != (size_t)size)
+	{
+		errorf("Main", "Could not write %s\n", name);
+		return 0;
+	}
 
 	return load_shared_library(name);
 }
@@ -136,9 +148,14 @@ void load_game(const char* filename, unsigned int size, void* data, void* userda
 
 	const char* absolute_path = vfs_get_absolute_path(filename);
 
+	/* Libraries that only exist in a pack are copied to the working directory. */
 	if (!absolute_path)
 	{
-		return;
+		if (data == NULL || size == 0)
+		{
+			return;
+		}
+		absolute_path = filename;
 	}
 
 
@@ -193,7 +210,17 @@ int main(int argc, char **argv)
 	core_argv_parse(&args, argc, argv);
 
 	/* Start the virtual file system */
-	vfs_init(args.mount);
+	vfs_init(NULL);
+	vfs_set_mmap(args.mmap);
+	vfs_set_lazy(args.lazy);
+	if (args.pack[0] != '\0')
+	{
+		vfs_mount_pack(args.pack);
+	}
+	if (args.mount[0] != '\0')
+	{
+		vfs_mount(args.mount);
+	}
 
 #ifdef LOAD_SHARED
 	/* Load game library */
@@ -224,11 +251,14 @@ int main(int argc, char **argv)
 	/* Sound setup */
 	core_set_up_sound(core_global, &settings->sound_listener, settings->sound_distance_max);
 
+	/* Per-frame scratch memory. */
+	core_set_frame_memory_size(core_global, settings->frame_memory_size);
+
 	/* Initialize subsystems and run main loop. */
 	core_setup(core_global, settings->window_title,
 		settings->view_width, settings->view_height,
 		settings->window_width, settings->window_height,
-		args.window_mode, 1000000000);
+		args.window_mode, settings->game_memory_size);
 	vfs_run_callbacks();
 
 #ifdef LOAD_SHARED
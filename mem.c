@@ -0,0 +1,196 @@
+/**
+ * Allocation accounting.
+ *
+ * Tracked allocations are prefixed with a header of MEM_HEADER_SIZE bytes
+ * holding the size and tag of the allocation, so engine_free() knows what to
+ * account for without a lookup. The header size keeps the returned pointer
+ * aligned as if it came straight from malloc().
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mem.h"
+
+#define MEM_HEADER_SIZE	16
+
+struct mem_header {
+	size_t			size;
+	enum mem_tag	tag;
+};
+
+static const char *mem_tag_names[MEM_TAG_MAX] = {
+	"core",
+	"vfs",
+	"sound",
+	"graphics",
+	"console",
+	"game",
+};
+
+static const char *mem_gpu_names[MEM_GPU_MAX] = {
+	"gpu buffers",
+	"gpu textures",
+};
+
+static void mem_counters_add(struct mem_counters *c, size_t size)
+{
+	c->live += size;
+	if(c->live > c->peak) {
+		c->peak = c->live;
+	}
+	c->allocs++;
+	c->frame_allocs++;
+}
+
+static void mem_counters_sub(struct mem_counters *c, size_t size)
+{
+	c->live = (size > c->live) ? 0 : c->live - size;
+	c->frees++;
+}
+
+static void* mem_header_init(void *base, enum mem_tag tag, size_t size)
+{
+	struct mem_header *h = (struct mem_header *) base;
+	h->size = size;
+	h->tag = tag;
+	if(mem_global != NULL) {
+		mem_counters_add(&mem_global->tags[tag], size);
+	}
+	return (char *) base + MEM_HEADER_SIZE;
+}
+
+static struct mem_header* mem_header_get(void *ptr)
+{
+	return (struct mem_header *) ((char *) ptr - MEM_HEADER_SIZE);
+}
+
+void* mem_malloc(enum mem_tag tag, size_t size)
+{
+	void *base = malloc(MEM_HEADER_SIZE + size);
+	if(base == NULL) {
+		return NULL;
+	}
+	return mem_header_init(base, tag, size);
+}
+
+void* mem_calloc(enum mem_tag tag, size_t n, size_t size)
+{
+	if(size != 0 && n > ((size_t) -1 - MEM_HEADER_SIZE) / size) {
+		return NULL;
+	}
+	void *base = calloc(1, MEM_HEADER_SIZE + n * size);
+	if(base == NULL) {
+		return NULL;
+	}
+	return mem_header_init(base, tag, n * size);
+}
+
+void* mem_realloc(enum mem_tag tag, void *ptr, size_t size)
+{
+	if(ptr == NULL) {
+		return mem_malloc(tag, size);
+	}
+
+	struct mem_header *h = mem_header_get(ptr);
+	size_t old_size = h->size;
+	enum mem_tag old_tag = h->tag;
+
+	void *base = realloc(h, MEM_HEADER_SIZE + size);
+	if(base == NULL) {
+		return NULL;
+	}
+
+	/* Account as a free of the old block and an allocation of the new. */
+	if(mem_global != NULL) {
+		mem_counters_sub(&mem_global->tags[old_tag], old_size);
+	}
+	return mem_header_init(base, tag, size);
+}
+
+void mem_free(void *ptr)
+{
+	if(ptr == NULL) {
+		return;
+	}
+	struct mem_header *h = mem_header_get(ptr);
+	if(mem_global != NULL) {
+		mem_counters_sub(&mem_global->tags[h->tag], h->size);
+	}
+	free(h);
+}
+
+/**
+ * Record that GPU memory has been allocated by a GL wrapper.
+ */
+void mem_gpu_alloc(enum mem_gpu kind, size_t size)
+{
+	if(mem_global != NULL) {
+		mem_counters_add(&mem_global->gpu[kind], size);
+	}
+}
+
+/**
+ * Record that GPU memory has been released by a GL wrapper.
+ */
+void mem_gpu_free(enum mem_gpu kind, size_t size)
+{
+	if(mem_global != NULL) {
+		mem_counters_sub(&mem_global->gpu[kind], size);
+	}
+}
+
+/**
+ * Should be called once per frame to roll over the per-frame allocation
+ * counts.
+ */
+void mem_frame(struct mem_stats *stats)
+{
+	if(stats == NULL) {
+		return;
+	}
+	for(int i=0; i<MEM_TAG_MAX; i++) {
+		stats->tags[i].last_frame_allocs = stats->tags[i].frame_allocs;
+		stats->tags[i].frame_allocs = 0;
+	}
+	for(int i=0; i<MEM_GPU_MAX; i++) {
+		stats->gpu[i].last_frame_allocs = stats->gpu[i].frame_allocs;
+		stats->gpu[i].frame_allocs = 0;
+	}
+}
+
+/**
+ * Sums up the heap counters of all subsystems. The peak is the sum of the
+ * subsystem peaks, which is an upper bound of the real peak.
+ */
+void mem_total(struct mem_stats *stats, struct mem_counters *out)
+{
+	memset(out, 0, sizeof(struct mem_counters));
+	if(stats == NULL) {
+		return;
+	}
+	for(int i=0; i<MEM_TAG_MAX; i++) {
+		out->live += stats->tags[i].live;
+		out->peak += stats->tags[i].peak;
+		out->allocs += stats->tags[i].allocs;
+		out->frees += stats->tags[i].frees;
+		out->frame_allocs += stats->tags[i].frame_allocs;
+		out->last_frame_allocs += stats->tags[i].last_frame_allocs;
+	}
+}
+
+const char* mem_tag_name(enum mem_tag tag)
+{
+	if(tag < 0 || tag >= MEM_TAG_MAX) {
+		return "unknown";
+	}
+	return mem_tag_names[tag];
+}
+
+const char* mem_gpu_name(enum mem_gpu kind)
+{
+	if(kind < 0 || kind >= MEM_GPU_MAX) {
+		return "unknown";
+	}
+	return mem_gpu_names[kind];
+}
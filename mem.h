@@ -0,0 +1,90 @@
+/**
+ * Allocation accounting.
+ *
+ * Engine allocations go through engine_malloc(), engine_calloc(),
+ * engine_realloc() and engine_free(), tagged with the subsystem that owns the
+ * memory. When compiled with MEM_STATS (see ENABLE_MEM_STATS in CMakeLists.txt)
+ * every allocation carries a small header recording its size and tag, and live
+ * bytes, peak bytes and allocation counts are kept per subsystem in mem_global.
+ * Without MEM_STATS the macros compile down to plain malloc() and friends.
+ *
+ * GPU memory can not be tracked by the allocator, so the GL wrappers report
+ * buffer and texture sizes with mem_gpu_alloc() and mem_gpu_free().
+ *
+ * NOTE: Memory allocated with engine_malloc() must be released with
+ * engine_free(), and vice versa.
+ *
+ * NOTE: The counters are not synchronized. Allocations made by jobs on worker
+ * threads (see job.h) are counted, but concurrent updates may be lost, so the
+ * numbers are approximate while jobs are running.
+ */
+
+#ifndef _MEM_H
+#define _MEM_H
+
+#include <stdlib.h>
+
+#include "log.h"
+
+#define mem_debug(...) debugf("Mem", __VA_ARGS__)
+#define mem_error(...) errorf("Mem", __VA_ARGS__)
+
+enum mem_tag {
+	MEM_CORE = 0,
+	MEM_VFS,
+	MEM_SOUND,
+	MEM_GRAPHICS,
+	MEM_CONSOLE,
+	MEM_GAME,
+	MEM_TAG_MAX
+};
+
+enum mem_gpu {
+	MEM_GPU_BUFFER = 0,
+	MEM_GPU_TEXTURE,
+	MEM_GPU_MAX
+};
+
+struct mem_counters {
+	size_t	live;				/* Bytes currently allocated. */
+	size_t	peak;				/* Highest number of bytes allocated at once. */
+	size_t	allocs;				/* Total number of allocations. */
+	size_t	frees;				/* Total number of frees. */
+	size_t	frame_allocs;		/* Allocations so far this frame. */
+	size_t	last_frame_allocs;	/* Allocations during the previous frame. */
+};
+
+struct mem_stats {
+	struct mem_counters	tags[MEM_TAG_MAX];	/* Heap memory per subsystem. */
+	struct mem_counters	gpu[MEM_GPU_MAX];	/* GPU memory per kind. */
+};
+
+/* Memory stats singleton (NULL: accounting disabled). */
+struct mem_stats *mem_global;
+
+#ifdef MEM_STATS
+#define engine_malloc(tag, size)		mem_malloc((tag), (size))
+#define engine_calloc(tag, n, size)		mem_calloc((tag), (n), (size))
+#define engine_realloc(tag, ptr, size)	mem_realloc((tag), (ptr), (size))
+#define engine_free(ptr)				mem_free((ptr))
+#else
+#define engine_malloc(tag, size)		malloc((size))
+#define engine_calloc(tag, n, size)		calloc((n), (size))
+#define engine_realloc(tag, ptr, size)	realloc((ptr), (size))
+#define engine_free(ptr)				free((ptr))
+#endif
+
+void*		mem_malloc(enum mem_tag tag, size_t size);
+void*		mem_calloc(enum mem_tag tag, size_t n, size_t size);
+void*		mem_realloc(enum mem_tag tag, void *ptr, size_t size);
+void		mem_free(void *ptr);
+
+void		mem_gpu_alloc(enum mem_gpu kind, size_t size);
+void		mem_gpu_free(enum mem_gpu kind, size_t size);
+
+void		mem_frame(struct mem_stats *stats);
+void		mem_total(struct mem_stats *stats, struct mem_counters *out);
+const char*	mem_tag_name(enum mem_tag tag);
+const char*	mem_gpu_name(enum mem_gpu kind);
+
+#endif
@@ -28,6 +28,7 @@
 #include "vfs.h"
 #include "color.h"
 #include "str.h"
+#include "core.h"
 
 /**
  * Looks up a character in the texture atlas and returns the texture coordinates
@@ -126,8 +127,10 @@ int monofont_new(struct monofont *font, const char *name,
 	font->letter_spacing_x = letter_spacing_x;
 	font->letter_spacing_y = letter_spacing_y;
 
-	/* Load font texture. */
+	/* Load font texture. Fonts are used as soon as they are created, so load
+	 * it now, also in lazy mode (see vfs_set_lazy()). */
 	vfs_register_callback(name, &monofont_reload, font);
+	vfs_request(name);
 
 	return MONOTEXT_OK;
 }
@@ -249,9 +252,8 @@ void monotext_new(struct monotext *dst, const char *text, const vec4 color,
 
 void monotext_free(struct monotext *text)
 {
-	free(text->verts);
 	glDeleteVertexArrays(1, &text->vao);
-	glDeleteBuffers(1, &text->vbo);
+	graphics_buffers_delete(1, &text->vbo);
 }
 
 /**
@@ -272,8 +274,8 @@ void monotext_updatef(struct monotext *dst, const char *fmt, ...)
 }
 
 /**
- * Updates the displayed text of a monotext, potentially reallocating memory and
- * pushing new buffer objects to the GPU.
+ * Updates the displayed text of a monotext, potentially pushing new buffer
+ * objects to the GPU. Vertices are built in per-frame scratch memory.
  */
 void monotext_update(struct monotext *dst, const char *text, const size_t len)
 {
@@ -283,7 +285,7 @@ void monotext_update(struct monotext *dst, const char *text, const size_t len)
 		return;
 	}
 
-	/* Set this flag if more/less vert memory is required for vertices. */
+	/* Set this flag if more/less GPU memory is required for vertices. */
 	int realloc_verts = 0;
 	/* Set this flag if vertices are to be re-uploaded to the GPU. */
 	int rearrange_verts = (dst->text == NULL) || !(strcmp(dst->text, text) == 0);
@@ -304,11 +306,8 @@ void monotext_update(struct monotext *dst, const char *text, const size_t len)
 	dst->verts_len = dst->quads_count * VBO_QUAD_LEN;
 	realloc_verts = old_verts_len != dst->verts_len;
 
-	/* Reallocate vertices memory if necessary. */
+	/* Create buffers if necessary. */
 	if(realloc_verts) {
-		free(dst->verts);
-		dst->verts = (float *) calloc(dst->verts_len * VBO_VERTEX_LEN, sizeof(float));
-
 		/* Create vertex buffer. */
 		if(glIsBuffer(dst->vbo) == GL_FALSE) {
 			glGenBuffers(1, &dst->vbo);
@@ -330,6 +329,12 @@ void monotext_update(struct monotext *dst, const char *text, const size_t len)
 		float blz = dst->bottom_left[2];
 		struct monofont *f = dst->font;
 
+		float *verts = (float *) frame_alloc(dst->verts_len * sizeof(float), sizeof(float));
+		if(verts == NULL) {
+			monotext_error("Out of memory\n");
+			return;
+		}
+
 		for(int i=0; i < dst->text_len; i++) {
 			char c = dst->text[i];
 			/* Handle new lines. */
@@ -346,7 +351,7 @@ void monotext_update(struct monotext *dst, const char *text, const size_t len)
 						monotext_error("Could not get atlas coords for \"%c\"\n", c);
 						continue;
 					}
-					monotext_set_quad(dst->verts, index,
+					monotext_set_quad(verts, index,
 							blx + x * (f->letter_width + f->letter_spacing_x),	// x
 							bly + y * (f->letter_height + f->letter_spacing_y),	// y
 							blz,												// z
@@ -366,8 +371,8 @@ void monotext_update(struct monotext *dst, const char *text, const size_t len)
 
 		/* glBufferData reallocates memory if necessary. */
 		glBindBuffer(GL_ARRAY_BUFFER, dst->vbo);
-		glBufferData(GL_ARRAY_BUFFER, dst->verts_len * sizeof(GLfloat),
-				dst->verts, GL_DYNAMIC_DRAW);
+		graphics_buffer_data(GL_ARRAY_BUFFER, dst->verts_len * sizeof(GLfloat),
+				verts, GL_DYNAMIC_DRAW);
 		GL_OK_OR_RETURN;
 
 		/* Position stream. */
@@ -44,7 +44,6 @@ struct monotext {
 	int				height_chars;				/* The height of the text in characters. */
 	int				width;						/* The width of the text in pixels. */
 	int				height;						/* The height fo the text in pixels. */
-	float			*verts;						/* The vertices required to draw this text. */
 	int				verts_count;				/* Number of vertices in verts buffer. */
 	int				verts_len;					/* Length of the vertex buffer. */
 	int				quads_count;				/* The number of quads required (text_len - newlines). */
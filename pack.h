@@ -0,0 +1,54 @@
+/**
+ * Asset pack file format.
+ *
+ * A pack is written by generate_assets and mounted with vfs_mount_pack(). All
+ * integers are stored in native (little-endian) byte order.
+ *
+ * Layout:
+ *   struct pack_header
+ *   struct pack_entry[count]	Sorted by hash, then by name.
+ *   char names[names_size]		NULL-terminated simplenames.
+ *   Blobs, each starting at a multiple of PACK_ALIGN from the start of the file.
+ *
+ * A blob is stored as is, or compressed if PACK_ENTRY_LZ4 is set in the flags
+ * of its entry (see compress.h). generate_assets only compresses a file when
+ * it saves enough (see PACK_COMPRESS_MIN_SAVING), so formats that are
+ * already compressed (PNG, Ogg) are stored as is.
+ */
+
+#ifndef _PACK_H
+#define _PACK_H
+
+#include <stdint.h>
+
+#define PACK_MAGIC		0x4b50444cu	/* "LDPK" */
+#define PACK_VERSION	2
+#define PACK_ALIGN		16
+
+/* Entry flags. */
+#define PACK_ENTRY_LZ4	(1 << 0)	/* The blob is an LZ4 block. */
+#define PACK_ENTRY_FLAGS	(PACK_ENTRY_LZ4)
+
+/* Files are stored compressed only if that saves at least 1/N of their size. */
+#define PACK_COMPRESS_MIN_SAVING	8
+
+struct pack_header {
+	uint32_t	magic;			/* PACK_MAGIC. */
+	uint32_t	version;		/* PACK_VERSION. */
+	uint32_t	count;			/* Number of entries. */
+	uint32_t	names_size;		/* Size of the name table. */
+	uint64_t	size;			/* Size of the whole pack. */
+};
+
+struct pack_entry {
+	uint32_t	hash;			/* vfs_hash() of the name. */
+	uint32_t	name;			/* Offset of the name in the name table. */
+	uint64_t	offset;			/* Offset of the blob from the start of the pack. */
+	uint64_t	size;			/* Size of the blob as stored. */
+	uint64_t	raw_size;		/* Size of the file (after decompression). */
+	uint64_t	content_hash;	/* hash_xxh64() of the file, seed 0. */
+	uint32_t	flags;			/* PACK_ENTRY_*. */
+	uint32_t	reserved;		/* Zero. */
+};
+
+#endif
@@ -4,11 +4,12 @@
  * Author: Tim Sjstrand <tim.sjostrand@gmail.com>
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "particles.h"
-#include "alist.h"
 #include "animatedsprites.h"
+#include "json.h"
 
 void particles_init(struct particles *em, int particles_max)
 {
@@ -21,16 +22,21 @@ void particles_init(struct particles *em, int particles_max)
 	em->particles_count = 0;
 	em->particles_max = particles_max;
 	em->sprites = animatedsprites_create();
-	em->particles = alist_new(particles_max);
 
-	for(int i=0; i<particles_max; i++) {
-		em->mem[i].dead = 1;
+	if(particle_vector_init(&em->particles, particles_max) != 0) {
+		particles_error("Out of memory\n");
 	}
 }
 
 void particles_free(struct particles *em)
 {
 	animatedsprites_destroy(em->sprites);
+	particle_vector_free(&em->particles);
+}
+
+static int particle_is_dead(struct particle *p, void *ctx)
+{
+	return p->dead;
 }
 
 void particles_think(struct particles *em, struct atlas *atlas, float dt)
@@ -41,21 +47,26 @@ void particles_think(struct particles *em, struct atlas *atlas, float dt)
 	animatedsprites_clear(em->sprites);
 
 	/* Update particles. */
-	foreach_alist(struct particle *, p, index, em->particles) {
+	foreach_vector(struct particle, p, &em->particles) {
 		p->age += dt;
 
-		/* Is particle dead? Remove it and continue iteration. */
+		/* Is particle dead? It is removed below. */
 		if(p->age >= p->age_max) {
 			p->dead = 1;
-			alist_delete_at(em->particles, index, 0);
-			index --;
 			continue;
 		}
 
 		/* Update particle. */
 		p->think(p, dt);
+	}
 
-		/* Add to sprite batcher. */
+	/* Remove dead particles. */
+	particle_vector_remove_if(&em->particles, &particle_is_dead, NULL);
+	em->particles_count = em->particles.count;
+
+	/* Add to sprite batcher. Particles are not moved again until the next
+	 * think, so the sprite pointers stay valid until then. */
+	foreach_vector(struct particle, p, &em->particles) {
 		animatedsprites_add(em->sprites, &p->sprite);
 	}
 
@@ -86,19 +97,6 @@ static void particle_init(struct particle *p, struct anim *anim,
 	animatedsprites_playanimation(&p->sprite, anim);
 }
 
-/**
- * Get the next available particle memory.
- */
-static struct particle* particles_particle_next(struct particles *em)
-{
-	for(int i=0; i<em->particles_max; i++) {
-		if(em->mem[i].dead) {
-			return &em->mem[i];
-		}
-	}
-	return NULL;
-}
-
 /**
  * Spawn a new particle.
  */
@@ -114,26 +112,28 @@ void particles_particle_spawn(struct particles *em,
 		return;
 	}
 
-	/* Get the next available particle. */
-	struct particle *p = particles_particle_next(em);
+	/* Add a new particle to the alive particles. */
+	struct particle *p = particle_vector_push(&em->particles);
 	if(p == NULL) {
 		em->particles_max_counter++;
 		return;
 	}
 	particle_init(p, anim, particle_think, x, y, w, h, angle, vx, vy, age_max);
-
-	/* Add it to the list of alive particles. */
-	alist_append(em->particles, p);
+	em->particles_count = em->particles.count;
 }
 
 /**
  * Random range of integers.
  *
  * @param min	The minimum value returned (inclusive).
- * @param max	The maximum value returned (inclusive).
+ * @param max	The maximum value returned (exclusive). If not above min,
+ *				min is returned.
  */
 int randri(int min, int max)
 {
+	if(max <= min) {
+		return min;
+	}
 	return min + (rand() % (max-min));
 }
 
@@ -169,3 +169,150 @@ void particles_emit(struct particles *em,
 		);
 	}
 }
+
+/**
+ * Parse a range value "key" from a JSON effect description. The value may be
+ * either a single number or an array of two numbers: [min, max].
+ */
+static int particles_effect_parse_range(float *min, float *max, struct json_reader *r,
+		const struct json_token *value, const char *key)
+{
+	if(value->type == JSON_NUMBER) {
+		*min = (float) value->number;
+		*max = (float) value->number;
+		return PARTICLES_OK;
+	}
+
+	if(value->type == JSON_ARRAY) {
+		struct json_token a, b, end;
+		if(json_array_next(r, &a) > 0 && a.type == JSON_NUMBER
+				&& json_array_next(r, &b) > 0 && b.type == JSON_NUMBER
+				&& json_array_next(r, &end) == 0) {
+			*min = (float) a.number;
+			*max = (float) b.number;
+			return PARTICLES_OK;
+		}
+	}
+
+	particles_error("Value \"%s\" must be a number or [min, max]\n", key);
+	return PARTICLES_ERROR;
+}
+
+/**
+ * Compile a JSON effect description into a particles_effect. All parsing
+ * happens here, so emitting an effect never touches the source again.
+ *
+ * Like the other ranges, the upper bound of "count" is exclusive: the example
+ * below emits 4 to 7 particles. A single number emits exactly that many.
+ *
+ * Example:
+ * @code
+ * {
+ *     "count": [4, 8],
+ *     "x": [-2, 2],
+ *     "y": [-2, 2],
+ *     "w": 4,
+ *     "h": 4,
+ *     "vx": [-0.1, 0.1],
+ *     "vy": [0.05, 0.2],
+ *     "age_max": [200, 400]
+ * }
+ * @endcode
+ *
+ * @param effect	Where to store the compiled effect. Only written to if
+ *					the whole description was valid.
+ * @param data		The JSON source (does not need to be \0 terminated).
+ * @param data_len	The length of the JSON source.
+ * @return			PARTICLES_OK on success, PARTICLES_ERROR on error.
+ */
+int particles_effect_load(struct particles_effect *effect, void *data, size_t data_len)
+{
+	struct particles_effect tmp = { 0 };
+	float count_min = 0, count_max = 0;
+	struct json_reader r;
+	struct json_token key, value;
+	int ret;
+
+	/* Missing keys leave the range at 0. */
+	struct {
+		const char	*key;
+		float		*min;
+		float		*max;
+	} ranges[] = {
+		{ "count",		&count_min,			&count_max },
+		{ "x",			&tmp.x_min,			&tmp.x_max },
+		{ "y",			&tmp.y_min,			&tmp.y_max },
+		{ "w",			&tmp.w_min,			&tmp.w_max },
+		{ "h",			&tmp.h_min,			&tmp.h_max },
+		{ "angle",		&tmp.angle_min,		&tmp.angle_max },
+		{ "vx",			&tmp.vx_min,		&tmp.vx_max },
+		{ "vy",			&tmp.vy_min,		&tmp.vy_max },
+		{ "age_max",	&tmp.age_max_min,	&tmp.age_max_max },
+	};
+	const int ranges_count = sizeof(ranges) / sizeof(ranges[0]);
+
+	json_init(&r, data, data_len);
+	if(json_next(&r, &value) != JSON_OBJECT) {
+		particles_error("Effect is not a JSON object\n");
+		return PARTICLES_ERROR;
+	}
+
+	while((ret = json_object_next(&r, &key)) > 0) {
+		int i = 0;
+		json_next(&r, &value);
+		while(i < ranges_count && !json_equals(&key, ranges[i].key)) {
+			i++;
+		}
+		if(i < ranges_count) {
+			if(particles_effect_parse_range(ranges[i].min, ranges[i].max, &r, &value, ranges[i].key) != PARTICLES_OK) {
+				return PARTICLES_ERROR;
+			}
+		} else if(json_skip(&r, &value) != JSON_OK) {
+			return PARTICLES_ERROR;
+		}
+	}
+	if(ret < 0 || json_next(&r, &value) != JSON_END) {
+		return PARTICLES_ERROR;
+	}
+
+	tmp.count_min = (int) count_min;
+	tmp.count_max = (int) count_max;
+
+	if(tmp.count_max <= 0 || tmp.count_min > tmp.count_max) {
+		particles_error("Invalid \"count\" range [%d, %d]\n", tmp.count_min, tmp.count_max);
+		return PARTICLES_ERROR;
+	}
+
+	if(tmp.age_max_max <= 0) {
+		particles_error("Invalid \"age_max\" range [%f, %f]\n", tmp.age_max_min, tmp.age_max_max);
+		return PARTICLES_ERROR;
+	}
+
+	(*effect) = tmp;
+
+	return PARTICLES_OK;
+}
+
+/**
+ * Emit new particles as described by a compiled effect.
+ *
+ * @param x		The x coordinate the effect is emitted at.
+ * @param y		The y coordinate the effect is emitted at.
+ */
+void particles_emit_effect(struct particles *em,
+		const struct particles_effect *effect,
+		struct anim *anim,
+		particle_think_t particle_think,
+		float x, float y)
+{
+	particles_emit(em, anim, particle_think,
+			effect->count_min, effect->count_max,
+			x + effect->x_min, x + effect->x_max,
+			y + effect->y_min, y + effect->y_max,
+			effect->w_min, effect->w_max,
+			effect->h_min, effect->h_max,
+			effect->angle_min, effect->angle_max,
+			effect->vx_min, effect->vx_max,
+			effect->vy_min, effect->vy_max,
+			effect->age_max_min, effect->age_max_max);
+}
@@ -3,11 +3,15 @@
 
 #include "log.h"
 #include "math4.h"
-#include "alist.h"
+#include "vector.h"
 #include "animatedsprites.h"
 
+#define particles_debug(...) debugf("Particles", __VA_ARGS__)
 #define particles_error(...) errorf("Particles", __VA_ARGS__)
 
+#define PARTICLES_OK	0
+#define PARTICLES_ERROR	-1
+
 #define PARTICLES_MAX	1024
 
 struct particle;
@@ -23,6 +27,8 @@ struct particle {
 	particle_think_t	think;
 };
 
+VECTOR_DEFINE(particle_vector, struct particle)
+
 struct particles {
 	int						particles_count;
 	int						particles_max;			/* How many particles to spawn. */
@@ -30,8 +36,35 @@ struct particles {
 	int						emit_interval_min;		/* NOTE: not implemented! */
 	int						emit_interval_max;		/* NOTE: not implemented! */
 	struct animatedsprites	*sprites;				/* Sprite batcher. */
-	struct alist			*particles;				/* A list of 'struct particle's. */
-	struct particle			mem[PARTICLES_MAX];
+	struct particle_vector	particles;				/* Alive particles, stored by value. */
+};
+
+/**
+ * A compiled particle effect.
+ *
+ * Parsed once from a JSON description by particles_effect_load() and consumed
+ * as-is by particles_emit_effect(). All positions are relative to the point
+ * the effect is emitted at.
+ */
+struct particles_effect {
+	int		count_min;
+	int		count_max;
+	float	x_min;
+	float	x_max;
+	float	y_min;
+	float	y_max;
+	float	w_min;
+	float	w_max;
+	float	h_min;
+	float	h_max;
+	float	angle_min;
+	float	angle_max;
+	float	vx_min;
+	float	vx_max;
+	float	vy_min;
+	float	vy_max;
+	float	age_max_min;
+	float	age_max_max;
 };
 
 void particles_init(struct particles *em, int particles_max);
@@ -52,4 +85,11 @@ void particles_emit(struct particles *em,
 		float vy_min, float vy_max,
 		float age_max_min, float age_max_max);
 
+int particles_effect_load(struct particles_effect *effect, void *data, size_t data_len);
+void particles_emit_effect(struct particles *em,
+		const struct particles_effect *effect,
+		struct anim *anim,
+		particle_think_t particle_think,
+		float x, float y);
+
 #endif
@@ -0,0 +1,244 @@
+/**
+ * Fixed-size object pool allocator.
+ *
+ * Objects are carved from chunks in order, and freed objects are kept on an
+ * intrusive free list: the first bytes of a free object store a pointer to the
+ * next free object.
+ *
+ * When compiled with DEBUG, objects are poisoned with POOL_POISON_ALLOC when
+ * allocated and POOL_POISON_FREE when freed, and writes to freed objects are
+ * detected when the object is handed out again.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pool.h"
+
+struct pool_chunk {
+	struct pool_chunk	*next;	/* Next chunk in allocation order. */
+	char				*base;	/* First object in this chunk (aligned). */
+};
+
+static size_t pool_align_up(size_t n, size_t align)
+{
+	return (n + align - 1) & ~(align - 1);
+}
+
+/**
+ * Allocate a new chunk and insert it after the current chunk, so chunks are
+ * always visited in allocation order.
+ */
+static struct pool_chunk* pool_chunk_new(struct pool *pool)
+{
+	size_t header = sizeof(struct pool_chunk) + pool->align - 1;
+	struct pool_chunk *c = (struct pool_chunk *) malloc(header + pool->size * pool->chunk);
+	if(c == NULL) {
+		return NULL;
+	}
+
+	uintptr_t base = (uintptr_t) (c + 1);
+	c->base = (char *) pool_align_up(base, pool->align);
+
+	if(pool->current == NULL) {
+		c->next = pool->chunks;
+		pool->chunks = c;
+	} else {
+		c->next = pool->current->next;
+		pool->current->next = c;
+	}
+
+	pool->stats.chunks++;
+	return c;
+}
+
+/**
+ * Initialize a pool.
+ *
+ * @param pool	The pool to initialize.
+ * @param size	The size of each object.
+ * @param align	The alignment of each object. Must be a power of two.
+ * @param chunk	The number of objects to request from the system at a time.
+ * @return		POOL_OK on success, POOL_ERROR on invalid arguments.
+ */
+int pool_init(struct pool *pool, size_t size, size_t align, size_t chunk)
+{
+	if(align == 0 || (align & (align - 1)) != 0) {
+		pool_error("Alignment must be a power of two (got %lu)\n", (unsigned long) align);
+		return POOL_ERROR;
+	}
+
+	if(size == 0 || chunk == 0) {
+		pool_error("Invalid object size (%lu) or chunk size (%lu)\n",
+				(unsigned long) size, (unsigned long) chunk);
+		return POOL_ERROR;
+	}
+
+	/* Freed objects hold the free list link. */
+	if(size < sizeof(void *)) {
+		size = sizeof(void *);
+	}
+
+	memset(pool, 0, sizeof(struct pool));
+	pool->size = pool_align_up(size, align);
+	pool->align = align;
+	pool->chunk = chunk;
+
+	return POOL_OK;
+}
+
+/**
+ * Create a new pool. No memory for objects is allocated until the first call
+ * to pool_alloc().
+ *
+ * @see pool_init
+ * @return		A new pool or NULL on error.
+ */
+struct pool* pool_create(size_t size, size_t align, size_t chunk)
+{
+	struct pool *pool = (struct pool *) malloc(sizeof(struct pool));
+	if(pool == NULL) {
+		return NULL;
+	}
+	if(pool_init(pool, size, align, chunk) != POOL_OK) {
+		free(pool);
+		return NULL;
+	}
+	return pool;
+}
+
+/**
+ * Release all chunks of a pool back to the system. All objects allocated from
+ * the pool are invalidated.
+ */
+void pool_free_all(struct pool *pool)
+{
+	struct pool_chunk *c = pool->chunks;
+	while(c != NULL) {
+		struct pool_chunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	pool->chunks = NULL;
+	pool->current = NULL;
+	pool->free_list = NULL;
+	pool->used = 0;
+	pool->stats.live = 0;
+	pool->stats.chunks = 0;
+}
+
+/**
+ * Release all memory held by a pool created with pool_create().
+ */
+void pool_destroy(struct pool *pool)
+{
+	if(pool == NULL) {
+		return;
+	}
+	pool_free_all(pool);
+	free(pool);
+}
+
+/**
+ * Allocate an object from the pool. The contents of the object are undefined.
+ *
+ * @return	A pointer to the new object, or NULL if out of memory.
+ */
+void* pool_alloc(struct pool *pool)
+{
+	char *obj = NULL;
+
+	if(pool->free_list != NULL) {
+		/* Reuse a freed object. */
+		obj = (char *) pool->free_list;
+		memcpy(&pool->free_list, obj, sizeof(void *));
+#ifdef DEBUG
+		for(size_t i=sizeof(void *); i<pool->size; i++) {
+			if((unsigned char) obj[i] != POOL_POISON_FREE) {
+				pool_error("Object %p was written to after being freed\n", obj);
+				break;
+			}
+		}
+#endif
+	} else {
+		/* Carve a new object, moving on to the next chunk if needed. */
+		if(pool->current == NULL || pool->used >= pool->chunk) {
+			struct pool_chunk *next = (pool->current != NULL) ? pool->current->next : pool->chunks;
+			if(next == NULL) {
+				next = pool_chunk_new(pool);
+				if(next == NULL) {
+					pool_error("Out of memory\n");
+					return NULL;
+				}
+			}
+			pool->current = next;
+			pool->used = 0;
+		}
+		obj = pool->current->base + pool->used * pool->size;
+		pool->used++;
+	}
+
+#ifdef DEBUG
+	memset(obj, POOL_POISON_ALLOC, pool->size);
+#endif
+
+	pool->stats.allocs++;
+	pool->stats.live++;
+	if(pool->stats.live > pool->stats.peak) {
+		pool->stats.peak = pool->stats.live;
+	}
+
+	return obj;
+}
+
+/**
+ * Return an object to the pool it was allocated from.
+ */
+void pool_free(struct pool *pool, void *ptr)
+{
+	if(ptr == NULL) {
+		return;
+	}
+
+#ifdef DEBUG
+	memset(ptr, POOL_POISON_FREE, pool->size);
+#endif
+
+	memcpy(ptr, &pool->free_list, sizeof(void *));
+	pool->free_list = ptr;
+
+	pool->stats.frees++;
+	pool->stats.live--;
+}
+
+/**
+ * Return all objects to the pool at once, keeping the chunks allocated for
+ * reuse.
+ */
+void pool_reset(struct pool *pool)
+{
+	pool->free_list = NULL;
+	pool->current = NULL;
+	pool->used = 0;
+	pool->stats.live = 0;
+
+#ifdef DEBUG
+	for(struct pool_chunk *c = pool->chunks; c != NULL; c = c->next) {
+		memset(c->base, POOL_POISON_FREE, pool->size * pool->chunk);
+	}
+#endif
+}
+
+void pool_print_stats(struct pool *pool, const char *name)
+{
+	pool_debug("%s: %lu live (peak %lu), %lu allocs, %lu frees, %lu chunks of %lu x %lu bytes\n",
+			name,
+			(unsigned long) pool->stats.live,
+			(unsigned long) pool->stats.peak,
+			(unsigned long) pool->stats.allocs,
+			(unsigned long) pool->stats.frees,
+			(unsigned long) pool->stats.chunks,
+			(unsigned long) pool->chunk,
+			(unsigned long) pool->size);
+}
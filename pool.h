@@ -0,0 +1,57 @@
+/**
+ * Fixed-size object pool allocator.
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <stdlib.h>
+
+#include "log.h"
+
+#define pool_debug(...) debugf("Pool", __VA_ARGS__)
+#define pool_error(...) errorf("Pool", __VA_ARGS__)
+
+#define POOL_OK		0
+#define POOL_ERROR	-1
+
+#define POOL_POISON_ALLOC	0xCD	/* Fills objects returned by pool_alloc() (DEBUG only). */
+#define POOL_POISON_FREE	0xDD	/* Fills objects returned to the pool (DEBUG only). */
+
+struct pool_chunk;
+
+struct pool_stats {
+	size_t	allocs;		/* Total number of pool_alloc() calls. */
+	size_t	frees;		/* Total number of pool_free() calls. */
+	size_t	live;		/* Objects currently allocated. */
+	size_t	peak;		/* Highest number of objects allocated at once. */
+	size_t	chunks;		/* Number of chunks allocated from the system. */
+};
+
+/**
+ * A pool of equally sized objects. Memory is requested from the system one
+ * chunk of objects at a time, and freed objects are kept on a free list, so
+ * allocating and freeing objects is O(1) and never touches the system
+ * allocator unless every chunk is full.
+ */
+struct pool {
+	size_t				size;		/* Object size, rounded up to alignment. */
+	size_t				align;		/* Object alignment. */
+	size_t				chunk;		/* Number of objects per chunk. */
+	void				*free_list;	/* Singly linked list of freed objects. */
+	struct pool_chunk	*chunks;	/* All chunks, newest first. */
+	struct pool_chunk	*current;	/* The chunk objects are carved from. */
+	size_t				used;		/* Objects carved from the current chunk. */
+	struct pool_stats	stats;
+};
+
+struct pool*	pool_create(size_t size, size_t align, size_t chunk);
+int				pool_init(struct pool *pool, size_t size, size_t align, size_t chunk);
+void			pool_destroy(struct pool *pool);
+void			pool_free_all(struct pool *pool);
+void*			pool_alloc(struct pool *pool);
+void			pool_free(struct pool *pool, void *ptr);
+void			pool_reset(struct pool *pool);
+void			pool_print_stats(struct pool *pool, const char *name);
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "shader.h"
 #include "math4.h"
+#include "mem.h"
 
 int shader_program_log(GLuint program, const char *name)
 {
@@ -28,7 +29,7 @@ int shader_program_log(GLuint program, const char *name)
 	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
 
 	if(len > 0) {
-		GLchar *msg = (GLchar *) malloc(len);
+		GLchar *msg = (GLchar *) engine_malloc(MEM_GRAPHICS, len);
 		glGetProgramInfoLog(program, len, &len, msg);
 		/* TODO: readline() and output for each line */
 		if(status == GL_FALSE) {
@@ -36,7 +37,7 @@ int shader_program_log(GLuint program, const char *name)
 		} else {
 			shader_debug("%s", msg);
 		}
-		free(msg);
+		engine_free(msg);
 	}
 
 	GLint uniforms = 0;
@@ -65,7 +66,7 @@ int shader_log(GLuint shader, const char *name)
 	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
 
 	if(len > 0) {
-		GLchar *msg = (GLchar *) malloc(len);
+		GLchar *msg = (GLchar *) engine_malloc(MEM_GRAPHICS, len);
 		glGetShaderInfoLog(shader, len, &len, msg);
 		/* TODO: readline() and output for each line */
 		if(status == GL_FALSE) {
@@ -73,7 +74,7 @@ int shader_log(GLuint shader, const char *name)
 		} else {
 			shader_debug("%s", msg);
 		}
-		free(msg);
+		engine_free(msg);
 	}
 
 	if(status == GL_FALSE) {
@@ -224,7 +225,7 @@ int shader_uniform(struct shader *s, const char *name, void *data, int type)
 		return SHADER_UNIFORMS_MAX_ERROR;
 	}
 
-	struct uniform *u = (struct uniform *) malloc(sizeof(struct uniform));
+	struct uniform *u = (struct uniform *) engine_malloc(MEM_GRAPHICS, sizeof(struct uniform));
 
 	if(u == NULL) {
 		shader_error("Out of memory");
@@ -272,7 +273,7 @@ void shader_uniforms_free(struct shader *s)
 {
 	for(int i=0; i<UNIFORMS_MAX; i++) {
 		if(s->uniforms[i] != NULL) {
-			free(s->uniforms[i]);
+			engine_free(s->uniforms[i]);
 		}
 		s->uniforms[i] = NULL;
 	}
@@ -22,8 +22,9 @@
 #endif
 
 #include "sound.h"
-#include "alist.h"
 #include "math4.h"
+#include "mem.h"
+#include "cook.h"
 
 static size_t sound_buf_read_file(stb_vorbis *header, stb_vorbis_info *info,
 		ALshort *buf, int len);
@@ -120,7 +121,10 @@ int sound_init(struct sound *s, vec3 listener_pos, float max_distance)
 #endif
 
 	/* Set up sound object. */
-	s->emitters = alist_new(SOUND_EMITTERS_MAX);
+	if(sound_emitter_vector_init(&s->emitters, SOUND_EMITTERS_MAX) != 0) {
+		sound_error("Out of memory\n");
+		return SOUND_ERROR;
+	}
 
 	/* Generate static sound sources. */
 	sound_src_t sources[SOUND_EMITTERS_MAX];
@@ -159,7 +163,7 @@ void sound_free(struct sound *s)
 	alcDestroyContext(s->context);
 	alcCloseDevice(device);
 	/* Free local memory. */
-	alist_free(s->emitters, 0);
+	sound_emitter_vector_free(&s->emitters);
 }
 
 /**
@@ -197,7 +201,12 @@ struct sound_emitter* sound_buf_play_detailed(struct sound *s, const sound_buf_t
 	}
 
 	/* Put emitter last in queue to be interrupted. */
-	alist_append(s->emitters, em);
+	struct sound_emitter **slot = sound_emitter_vector_push(&s->emitters);
+	if(slot == NULL) {
+		sound_error("Out of memory\n");
+		return NULL;
+	}
+	(*slot) = em;
 
 	/* Set attributes. */
 	sound_src_loop(em->src, loop);
@@ -268,36 +277,138 @@ int sound_buf_load_pcm(sound_buf_t *buf, ALshort *data, size_t len)
 	return SOUND_OK;
 }
 
-int sound_buf_load_vorbis_header(sound_buf_t *buf, stb_vorbis *header)
+/**
+ * Uploads decoded PCM data to a new OpenAL buffer.
+ *
+ * @param buf	Where to store the buffer.
+ * @param pcm	The decoded data. Still owned by the caller.
+ */
+int sound_buf_load_decoded(sound_buf_t *buf, const struct sound_pcm *pcm)
+{
+	ALenum format = to_al_format(pcm->channels, 16);
+
+	/* Generate PCM buffers. */
+	alGenBuffers(1, (ALuint *) buf);
+	AL_TEST("sound_buf_load_decoded: generate buffer");
+
+	/* Bind buffer. */
+	alBufferData((*buf), format, pcm->data, pcm->samples_count*sizeof(ALshort), pcm->sample_rate);
+	AL_TEST("buffer data");
+
+	return SOUND_OK;
+}
+
+static int sound_pcm_decode_header(struct sound_pcm *pcm, stb_vorbis *header)
 {
 	/* File info. */
 	stb_vorbis_info info = stb_vorbis_get_info(header);
-	ALenum format = to_al_format(info.channels, 16);
 
 	/* Load file. */
-	unsigned int samples_count = stb_vorbis_stream_length_in_samples(header) * info.channels;
-	size_t data_len = samples_count * sizeof(ALshort);
-	ALshort *data = (ALshort *) malloc(data_len);
+	size_t samples_count = stb_vorbis_stream_length_in_samples(header) * info.channels;
+	ALshort *data = (ALshort *) engine_malloc(MEM_SOUND, samples_count * sizeof(ALshort));
 	if(data == NULL) {
 		sound_error("Out of memory\n");
 		return SOUND_ERROR;
 	}
-	size_t size = sound_buf_read_file(header, &info, data, data_len);
+	size_t size = sound_buf_read_file(header, &info, data, samples_count);
 	if(size <= 0) {
+		engine_free(data);
+		return SOUND_ERROR;
+	}
+
+	pcm->data = data;
+	pcm->samples_count = size;
+	pcm->channels = info.channels;
+	pcm->sample_rate = info.sample_rate;
+
+	return SOUND_OK;
+}
+
+int sound_buf_load_vorbis_header(sound_buf_t *buf, stb_vorbis *header)
+{
+	struct sound_pcm pcm;
+	if(sound_pcm_decode_header(&pcm, header) != SOUND_OK) {
 		return SOUND_ERROR;
 	}
 
+	int ret = sound_buf_load_decoded(buf, &pcm);
+	sound_pcm_free(&pcm);
+
+	return ret;
+}
+
+/**
+ * Decodes a complete Ogg Vorbis file to PCM data. Thread safe.
+ *
+ * @param pcm	Where to store the decoded data. Release with sound_pcm_free().
+ * @param data	The Ogg Vorbis file.
+ * @param len	Length of data.
+ */
+int sound_pcm_decode_vorbis(struct sound_pcm *pcm, const void *data, size_t len)
+{
+	stb_vorbis *vorbis = stb_vorbis_open_memory((const unsigned char *) data, len, NULL, NULL);
+	if(!vorbis) {
+		sound_error("Could not parse vorbis data\n");
+		return SOUND_ERROR;
+	}
+
+	int ret = sound_pcm_decode_header(pcm, vorbis);
+
+	stb_vorbis_close(vorbis);
+
+	return ret;
+}
+
+/**
+ * @return	Non-zero if data starts like a cooked sound (see cook.h).
+ */
+int sound_is_cooked(const void *data, size_t len)
+{
+	const struct cook_sound_header *h = (const struct cook_sound_header *) data;
+	return data != NULL && len >= sizeof(struct cook_sound_header)
+		&& h->magic == COOK_SOUND_MAGIC;
+}
+
+/**
+ * Uploads a cooked sound written by generate_assets (see cook.h). The samples
+ * are passed to OpenAL straight from data, nothing is decoded or copied.
+ *
+ * @param buf	Where to store the buffer.
+ * @param data	The cooked sound.
+ * @param len	Length of data.
+ */
+int sound_buf_load_pcm_cooked(sound_buf_t *buf, const void *data, size_t len)
+{
+	const struct cook_sound_header *h = (const struct cook_sound_header *) data;
+
+	if(!sound_is_cooked(data, len) || h->version != COOK_SOUND_VERSION
+			|| (h->channels != 1 && h->channels != 2) || h->sample_rate == 0
+			|| (len - sizeof(struct cook_sound_header)) / (h->channels * sizeof(ALshort)) < h->frames) {
+		sound_error("Invalid cooked sound (%lu bytes)\n", (unsigned long) len);
+		return SOUND_ERROR;
+	}
+
+	ALenum format = to_al_format(h->channels, 16);
+
 	/* Generate PCM buffers. */
 	alGenBuffers(1, (ALuint *) buf);
-	AL_TEST("sound_buf_load_vorbis_header: generate buffer");
+	AL_TEST("sound_buf_load_pcm_cooked: generate buffer");
 
 	/* Bind buffer. */
-	alBufferData((*buf), format, data, size*sizeof(ALshort), info.sample_rate);
+	alBufferData((*buf), format, h + 1,
+			(ALsizei) (h->frames * h->channels * sizeof(ALshort)), h->sample_rate);
 	AL_TEST("buffer data");
 
 	return SOUND_OK;
 }
 
+void sound_pcm_free(struct sound_pcm *pcm)
+{
+	engine_free(pcm->data);
+	pcm->data = NULL;
+	pcm->samples_count = 0;
+}
+
 int sound_src_pitch(sound_src_t src, float pitch)
 {
 	alSourcef(src, AL_PITCH, pitch);
@@ -360,8 +471,16 @@ static size_t sound_buf_read_file(stb_vorbis *header, stb_vorbis_info *info,
 	return size;
 }
 
+/**
+ * Loads an Ogg Vorbis file (or a cooked sound, see
+ * sound_buf_load_pcm_cooked()) into a new OpenAL buffer.
+ */
 int sound_buf_load_vorbis(sound_buf_t *buf, const void *data, size_t len)
 {
+	if(sound_is_cooked(data, len)) {
+		return sound_buf_load_pcm_cooked(buf, data, len);
+	}
+
 	stb_vorbis *vorbis = stb_vorbis_open_memory((const unsigned char *) data, len, NULL, NULL);
 	if(!vorbis) {
 		sound_error("Could not parse vorbis data\n");
@@ -466,7 +585,7 @@ int sound_buf_load_filter(sound_buf_t *buf, size_t samples_count,
 	ALenum format = to_al_format(1, SOUND_SAMPLE_SIZE);
 
 	/* Load data. */
-	ALshort *data = (ALshort *) malloc(samples_count * sizeof(ALshort));
+	ALshort *data = (ALshort *) engine_malloc(MEM_SOUND, samples_count * sizeof(ALshort));
 	if(data == NULL) {
 		sound_error("Out of memory\n");
 		return SOUND_ERROR;
@@ -486,8 +605,8 @@ int sound_buf_load_filter(sound_buf_t *buf, size_t samples_count,
 			data,
 			samples_count * sizeof(ALshort),
 			sample_rate);
+	engine_free(data);
 	AL_TEST("buffer data");
-	free(data);
 
 	return SOUND_OK;
 }
@@ -535,7 +654,7 @@ void sound_emitter_stop(struct sound_emitter *em)
 
 struct sound_emitter* sound_emitter_get_next_interruptable(struct sound *s)
 {
-	foreach_alist_p(struct sound_emitter *, em, s->emitters) {
+	foreach_vector(struct sound_emitter *, em, &s->emitters) {
 		if(!(*em)->uninterruptable) {
 			return (*em);
 		}
@@ -568,20 +687,22 @@ static struct sound_emitter* sound_emitter_get(struct sound *s)
 	return emitter;
 }
 
-static void sound_emitters_clean(struct sound *s)
+static int sound_emitter_is_done(struct sound_emitter **em, void *ctx)
 {
 	ALint source_state;
-	foreach_alist(struct sound_emitter *, em, index, s->emitters) {
-		alGetSourcei(em->src, AL_SOURCE_STATE, &source_state);
-		if(source_state != AL_PLAYING) {
-			/* Make available. */
-			em->available = 1;
-			/* Remove emitter. */
-			alist_delete_at(s->emitters, index, 0);
-			/* Deleted self: stay on same index for next element. */
-			index--;
-		}
+	alGetSourcei((*em)->src, AL_SOURCE_STATE, &source_state);
+	if(source_state != AL_PLAYING) {
+		/* Make available. */
+		(*em)->available = 1;
+		return 1;
 	}
+	return 0;
+}
+
+static void sound_emitters_clean(struct sound *s)
+{
+	/* Remove done emitters, keeping the rest in order of creation time. */
+	sound_emitter_vector_remove_if_stable(&s->emitters, &sound_emitter_is_done, NULL);
 }
 
 void sound_emitter_update(struct sound_emitter *em)
@@ -600,7 +721,7 @@ void sound_think(struct sound *s, float delta_time)
 	sound_emitters_clean(s);
 
 	/* Update emitter attributes. */
-	foreach_alist_p(struct sound_emitter *, emitter, s->emitters) {
+	foreach_vector(struct sound_emitter *, emitter, &s->emitters) {
 		sound_emitter_update((*emitter));
 	}
 }
@@ -13,7 +13,7 @@
 #include <stb/stb_vorbis.c>
 
 #include "log.h"
-#include "alist.h"
+#include "vector.h"
 #include "math4.h"
 
 #define SOUND_OK			0
@@ -40,19 +40,37 @@ struct sound_emitter {
 	float			*velocity;			/* X,Y,Z velocity components (or NULL). */
 };
 
+VECTOR_DEFINE(sound_emitter_vector, struct sound_emitter *)
+
 struct sound {
-	ALCcontext				*context;							/* OpenAL context. */
-	struct alist			*emitters;							/* Emitters in ascending order of creation time (0 is oldest). */
-	struct sound_emitter	emitters_mem[SOUND_EMITTERS_MAX];	/* Static memory used to hold emitter data. */
+	ALCcontext					*context;							/* OpenAL context. */
+	struct sound_emitter_vector	emitters;							/* Emitters in ascending order of creation time (0 is oldest). */
+	struct sound_emitter		emitters_mem[SOUND_EMITTERS_MAX];	/* Static memory used to hold emitter data. */
 };
 
 typedef int (*filter_t)(ALshort *buf, size_t offset, size_t len);
 
+/**
+ * Decoded PCM data. Decoding does not touch OpenAL, so it can run on a worker
+ * thread; upload the result with sound_buf_load_decoded() on the main thread.
+ */
+struct sound_pcm {
+	ALshort	*data;			/* Interleaved 16-bit samples. */
+	size_t	samples_count;	/* Number of samples in data (all channels). */
+	int		channels;
+	int		sample_rate;
+};
+
 int		sound_buf_load_vorbis(sound_buf_t *buf, const void *data, size_t len);
 int		sound_buf_load_vorbis_file(sound_buf_t *buf, const char *filename);
 int		sound_buf_load_filter(sound_buf_t *buf, size_t samples_count,
 				const int sample_rate, filter_t filter);
 int		sound_buf_load_pcm(sound_buf_t *buf, ALshort *data, size_t len);
+int		sound_buf_load_decoded(sound_buf_t *buf, const struct sound_pcm *pcm);
+int		sound_buf_load_pcm_cooked(sound_buf_t *buf, const void *data, size_t len);
+int		sound_is_cooked(const void *data, size_t len);
+int		sound_pcm_decode_vorbis(struct sound_pcm *pcm, const void *data, size_t len);
+void	sound_pcm_free(struct sound_pcm *pcm);
 void	sound_buf_free(sound_buf_t buf);
 size_t	sound_buf_add_filter(ALshort *buf, const size_t start, const size_t len,
 				filter_t filter);
@@ -6,18 +6,23 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <GL/glew.h>
 
 #include "spritebatch.h"
 #include "color.h"
 
 #define STRIDE 5
-#define CURRENT_SPRITE batch->sprite_count * STRIDE * 6
+#define CURRENT_SPRITE batch->sprite_count * STRIDE * batch->sprite_vertices
 
 void spritebatch_create(struct spritebatch* batch)
 {
 	batch->offset_stream = 0;
 	batch->offset_draw = 0;
+	batch->sprite_count = 0;
+	batch->sprite_vertices = SPRITEBATCH_QUAD_VERTICES;
+	batch->dropped = 0;
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -27,7 +32,7 @@ void spritebatch_create(struct spritebatch* batch)
 	glBindVertexArray(batch->vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
-	glBufferData(GL_ARRAY_BUFFER, SPRITEBATCH_BUFFER_CAPACITY, 0, GL_STREAM_DRAW);
+	graphics_buffer_data(GL_ARRAY_BUFFER, SPRITEBATCH_BUFFER_CAPACITY, 0, GL_STREAM_DRAW);
 
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * STRIDE, (void *) 0);						// Vertex
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * STRIDE, (void *) (sizeof(GLfloat) * 3));	// Texcoord
@@ -37,7 +42,7 @@ void spritebatch_create(struct spritebatch* batch)
 
 void spritebatch_destroy(struct spritebatch* batch)
 {
-	glDeleteBuffers(1, &batch->vbo);
+	graphics_buffers_delete(1, &batch->vbo);
 	glDeleteVertexArrays(1, &batch->vao);
 }
 
@@ -51,7 +56,7 @@ void spritebatch_begin(struct spritebatch* batch)
 		glBindVertexArray(batch->vao);
 
 		glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
-		glBufferData(GL_ARRAY_BUFFER, SPRITEBATCH_BUFFER_CAPACITY, 0, GL_STREAM_DRAW);
+		graphics_buffer_data(GL_ARRAY_BUFFER, SPRITEBATCH_BUFFER_CAPACITY, 0, GL_STREAM_DRAW);
 
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * STRIDE, (void *) 0);						// Vertex
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * STRIDE, (void *) (sizeof(GLfloat) * 3));	// Texcoord
@@ -81,56 +86,210 @@ void spritebatch_end(struct spritebatch* batch)
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void spritebatch_add(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds)
+static void spritebatch_vertex(struct spritebatch* batch, int vertex, GLfloat x, GLfloat y, GLfloat z, const vec2 uv)
+{
+	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * vertex + 0] = x;
+	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * vertex + 1] = y;
+	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * vertex + 2] = z;
+	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * vertex + 3] = uv[0];
+	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * vertex + 4] = uv[1];
+}
+
+/**
+ * @return Non-zero if there is room for another sprite in the mapped chunk.
+ * Otherwise the sprite is dropped, which is logged the first time.
+ */
+static int spritebatch_has_room(struct spritebatch* batch)
 {
-	// Top-left
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 0 + 0] = -0.5f * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 0 + 1] = 0.5f  * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 0 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 0 + 3] = tex_pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 0 + 4] = tex_pos[1];
-
-	// Bottom-left
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 1 + 0] = -0.5f * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 1 + 1] = -0.5f * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 1 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 1 + 3] = tex_pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 1 + 4] = tex_pos[1] + tex_bounds[1];
-
-	// Top-right
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 2 + 0] = 0.5f * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 2 + 1] = 0.5f * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 2 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 2 + 3] = tex_pos[0] + tex_bounds[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 2 + 4] = tex_pos[1];
-
-	// Top-right
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 3 + 0] = 0.5f * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 3 + 1] = 0.5f * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 3 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 3 + 3] = tex_pos[0] + tex_bounds[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 3 + 4] = tex_pos[1];
-
-	// Bottom-left 
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 4 + 0] = -0.5f * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 4 + 1] = -0.5f * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 4 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 4 + 3] = tex_pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 4 + 4] = tex_pos[1] + tex_bounds[1];
-
-	// Bottom-right
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 5 + 0] = 0.5f  * scale[0] + pos[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 5 + 1] = -0.5f * scale[1] + pos[1];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 5 + 2] = 0.0f + pos[2];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 5 + 3] = tex_pos[0] + tex_bounds[0];
-	batch->gpu_vertices[CURRENT_SPRITE + STRIDE * 5 + 4] = tex_pos[1] + tex_bounds[1];
+	if ((batch->sprite_count + 1) * batch->sprite_vertices * SPRITEBATCH_VERTEX_SIZE <= SPRITEBATCH_CHUNK)
+	{
+		return 1;
+	}
+
+	if (!batch->dropped)
+	{
+		printf("spritebatch full: dropping sprites past %u (%u vertices each)\n",
+				batch->sprite_count, batch->sprite_vertices);
+		batch->dropped = 1;
+	}
+	return 0;
+}
+
+/**
+ * Finish a sprite of the given number of vertices, filling the rest of its
+ * vertices with copies of the last one: degenerate triangles that produce no
+ * fragments.
+ */
+static void spritebatch_finish(struct spritebatch* batch, int vertices)
+{
+	for (int i = vertices; i < batch->sprite_vertices; i++)
+	{
+		memcpy(&batch->gpu_vertices[CURRENT_SPRITE + STRIDE * i],
+				&batch->gpu_vertices[CURRENT_SPRITE + STRIDE * (vertices - 1)],
+				sizeof(GLfloat) * STRIDE);
+	}
 
 	batch->sprite_count++;
 }
 
+/**
+ * Adds a quad with the given texture coordinates at its top-left, bottom-left,
+ * top-right and bottom-right corners.
+ */
+static void spritebatch_add_quad(struct spritebatch* batch, vec3 pos, vec2 scale, const vec2 tl, const vec2 bl, const vec2 tr, const vec2 br)
+{
+	GLfloat left = -0.5f * scale[0] + pos[0];
+	GLfloat right = 0.5f * scale[0] + pos[0];
+	GLfloat top = 0.5f * scale[1] + pos[1];
+	GLfloat bottom = -0.5f * scale[1] + pos[1];
+	GLfloat z = 0.0f + pos[2];
+
+	if (!spritebatch_has_room(batch))
+	{
+		return;
+	}
+
+	spritebatch_vertex(batch, 0, left, top, z, tl);			// Top-left
+	spritebatch_vertex(batch, 1, left, bottom, z, bl);		// Bottom-left
+	spritebatch_vertex(batch, 2, right, top, z, tr);		// Top-right
+	spritebatch_vertex(batch, 3, right, top, z, tr);		// Top-right
+	spritebatch_vertex(batch, 4, left, bottom, z, bl);		// Bottom-left
+	spritebatch_vertex(batch, 5, right, bottom, z, br);		// Bottom-right
+
+	spritebatch_finish(batch, SPRITEBATCH_QUAD_VERTICES);
+}
+
+void spritebatch_add(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds)
+{
+	const vec2 tl = { tex_pos[0], tex_pos[1] };
+	const vec2 bl = { tex_pos[0], tex_pos[1] + tex_bounds[1] };
+	const vec2 tr = { tex_pos[0] + tex_bounds[0], tex_pos[1] };
+	const vec2 br = { tex_pos[0] + tex_bounds[0], tex_pos[1] + tex_bounds[1] };
+
+	spritebatch_add_quad(batch, pos, scale, tl, bl, tr, br);
+}
+
+/**
+ * Like spritebatch_add(), for a texture region holding the sprite turned 90
+ * degrees clockwise (rotated atlas frames): the top-left corner of the sprite
+ * is at the top-right corner of the region.
+ */
+void spritebatch_add_rotated(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds)
+{
+	const vec2 tl = { tex_pos[0] + tex_bounds[0], tex_pos[1] };
+	const vec2 bl = { tex_pos[0], tex_pos[1] };
+	const vec2 tr = { tex_pos[0] + tex_bounds[0], tex_pos[1] + tex_bounds[1] };
+	const vec2 br = { tex_pos[0], tex_pos[1] + tex_bounds[1] };
+
+	spritebatch_add_quad(batch, pos, scale, tl, bl, tr, br);
+}
+
+/**
+ * Add a sprite turned counter-clockwise by angle (radians) around its center.
+ */
+void spritebatch_add_angled(struct spritebatch* batch, vec3 pos, vec2 scale, float angle, vec2 tex_pos, vec2 tex_bounds)
+{
+	const vec2 tl = { tex_pos[0], tex_pos[1] };
+	const vec2 bl = { tex_pos[0], tex_pos[1] + tex_bounds[1] };
+	const vec2 tr = { tex_pos[0] + tex_bounds[0], tex_pos[1] };
+	const vec2 br = { tex_pos[0] + tex_bounds[0], tex_pos[1] + tex_bounds[1] };
+
+	/* Half extents of the sprite along its own axes. */
+	GLfloat c = cosf(angle);
+	GLfloat s = sinf(angle);
+	GLfloat wx = 0.5f * scale[0] * c;
+	GLfloat wy = 0.5f * scale[0] * s;
+	GLfloat hx = -0.5f * scale[1] * s;
+	GLfloat hy = 0.5f * scale[1] * c;
+	GLfloat z = 0.0f + pos[2];
+
+	if (!spritebatch_has_room(batch))
+	{
+		return;
+	}
+
+	spritebatch_vertex(batch, 0, pos[0] - wx + hx, pos[1] - wy + hy, z, tl);	// Top-left
+	spritebatch_vertex(batch, 1, pos[0] - wx - hx, pos[1] - wy - hy, z, bl);	// Bottom-left
+	spritebatch_vertex(batch, 2, pos[0] + wx + hx, pos[1] + wy + hy, z, tr);	// Top-right
+	spritebatch_vertex(batch, 3, pos[0] + wx + hx, pos[1] + wy + hy, z, tr);	// Top-right
+	spritebatch_vertex(batch, 4, pos[0] - wx - hx, pos[1] - wy - hy, z, bl);	// Bottom-left
+	spritebatch_vertex(batch, 5, pos[0] + wx - hx, pos[1] + wy - hy, z, br);	// Bottom-right
+
+	spritebatch_finish(batch, SPRITEBATCH_QUAD_VERTICES);
+}
+
+/**
+ * Adds a sprite drawn as a convex polygon, for sprites that are mostly
+ * transparent (see struct atlas_hull). Drawn as a quad if the batch is not in
+ * polygon mode.
+ *
+ * @param rotated	Non-zero if the texture region holds the sprite turned 90
+ *					degrees clockwise, like spritebatch_add_rotated().
+ * @param points	Convex polygon, 0 to 1 from the top-left of the sprite.
+ * @param count		Number of points, 3 to SPRITEBATCH_POLYGON_MAX.
+ */
+void spritebatch_add_polygon(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds, int rotated, const vec2* points, int count)
+{
+	if (batch->sprite_vertices < SPRITEBATCH_POLYGON_VERTICES || count < 3 || count > SPRITEBATCH_POLYGON_MAX)
+	{
+		if (rotated)
+		{
+			spritebatch_add_rotated(batch, pos, scale, tex_pos, tex_bounds);
+		}
+		else
+		{
+			spritebatch_add(batch, pos, scale, tex_pos, tex_bounds);
+		}
+		return;
+	}
+
+	if (!spritebatch_has_room(batch))
+	{
+		return;
+	}
+
+	// Triangle fan around the first point
+	int vertex = 0;
+	for (int i = 1; i < count - 1; i++)
+	{
+		const int corners[3] = { 0, i, i + 1 };
+
+		for (int j = 0; j < 3; j++)
+		{
+			const GLfloat* p = points[corners[j]];
+			vec2 uv;
+
+			if (rotated)
+			{
+				uv[0] = tex_pos[0] + (1.0f - p[1]) * tex_bounds[0];
+				uv[1] = tex_pos[1] + p[0] * tex_bounds[1];
+			}
+			else
+			{
+				uv[0] = tex_pos[0] + p[0] * tex_bounds[0];
+				uv[1] = tex_pos[1] + p[1] * tex_bounds[1];
+			}
+
+			spritebatch_vertex(batch, vertex++, (p[0] - 0.5f) * scale[0] + pos[0], (0.5f - p[1]) * scale[1] + pos[1], 0.0f + pos[2], uv);
+		}
+	}
+
+	spritebatch_finish(batch, vertex);
+}
+
+/**
+ * Polygon mode gives every sprite room for SPRITEBATCH_POLYGON_VERTICES
+ * vertices, so spritebatch_add_polygon() can draw fewer fragments at the cost
+ * of more vertices. Change it before spritebatch_begin().
+ */
+void spritebatch_set_polygons(struct spritebatch* batch, int enabled)
+{
+	batch->sprite_vertices = enabled ? SPRITEBATCH_POLYGON_VERTICES : SPRITEBATCH_QUAD_VERTICES;
+}
+
 void spritebatch_sort(struct spritebatch* batch, spritebatch_sort_fn sorting_function)
 {
-	qsort(batch->gpu_vertices, batch->sprite_count, sizeof(GLfloat) * 30, sorting_function);
+	qsort(batch->gpu_vertices, batch->sprite_count, sizeof(GLfloat) * STRIDE * batch->sprite_vertices, sorting_function);
 }
 
 void spritebatch_render(struct spritebatch* batch, struct shader *s, struct graphics *g, GLuint tex, mat4 transform)
@@ -166,5 +325,5 @@ void spritebatch_render(struct spritebatch* batch, struct shader *s, struct grap
 	glUniform1i(s->uniform_sprite_type, 0);
 	glUniform1i(s->uniform_tex, 0);
 
-	glDrawArrays(GL_TRIANGLES, batch->offset_draw, batch->sprite_count * 6);
+	glDrawArrays(GL_TRIANGLES, batch->offset_draw, batch->sprite_count * batch->sprite_vertices);
 }
@@ -6,6 +6,9 @@
 #define SPRITEBATCH_BUFFER_CAPACITY 30720000
 #define SPRITEBATCH_CHUNK 3072000
 #define SPRITEBATCH_VERTEX_SIZE (5 * sizeof(GLfloat))
+#define SPRITEBATCH_QUAD_VERTICES 6
+#define SPRITEBATCH_POLYGON_MAX 8	/* Most points in a polygon sprite. */
+#define SPRITEBATCH_POLYGON_VERTICES ((SPRITEBATCH_POLYGON_MAX - 2) * 3)
 
 typedef float GLfloat;
 typedef unsigned int GLuint;
@@ -26,6 +29,8 @@ struct spritebatch
 	GLuint offset_draw;
 
 	unsigned int sprite_count;
+	unsigned int sprite_vertices;	/* Vertices per sprite, see spritebatch_set_polygons(). */
+	int dropped;					/* If a sprite has been dropped for lack of room (logged once). */
 
 	GLfloat* gpu_vertices;
 };
@@ -34,6 +39,10 @@ void spritebatch_create(struct spritebatch* batch);
 void spritebatch_destroy(struct spritebatch* batch);
 void spritebatch_begin(struct spritebatch* batch);
 void spritebatch_add(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds);
+void spritebatch_add_rotated(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds);
+void spritebatch_add_angled(struct spritebatch* batch, vec3 pos, vec2 scale, float angle, vec2 tex_pos, vec2 tex_bounds);
+void spritebatch_add_polygon(struct spritebatch* batch, vec3 pos, vec2 scale, vec2 tex_pos, vec2 tex_bounds, int rotated, const vec2* points, int count);
+void spritebatch_set_polygons(struct spritebatch* batch, int enabled);
 void spritebatch_end(struct spritebatch* batch);
 void spritebatch_render(struct spritebatch* batch, struct shader *s, struct graphics *g, GLuint tex, mat4 transform);
 void spritebatch_sort(struct spritebatch* batch, spritebatch_sort_fn sorting_function);
@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -13,6 +14,27 @@
 
 #include "graphics.h"
 #include "color.h"
+#include "mem.h"
+#include "texture.h"
+#include "cook.h"
+
+/* Texture size in GPU memory, assuming 4 bytes per pixel and no mipmaps. */
+#define TEXTURE_SIZE(width, height)	((size_t) (width) * (size_t) (height) * 4)
+
+#ifdef MEM_STATS
+/**
+ * Size of a texture in GPU memory, all mip levels included.
+ */
+static size_t texture_gpu_size(uint32_t width, uint32_t height, uint32_t bpp, uint32_t levels)
+{
+	size_t size = 0;
+	for(uint32_t i=0; i<levels; i++) {
+		size += (size_t) cook_texture_level_size(width, i)
+			* cook_texture_level_size(height, i) * bpp;
+	}
+	return size;
+}
+#endif
 
 /**
  * Parses pixel data from a compressed image.
@@ -62,6 +84,9 @@ int texture_load_pixels(GLuint *tex, const uint8_t *data,
 	/* Upload texture. */
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
 			GL_UNSIGNED_BYTE, data);
+#ifdef MEM_STATS
+	mem_gpu_alloc(MEM_GPU_TEXTURE, TEXTURE_SIZE(width, height));
+#endif
 	/* Wrapping. */
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -74,6 +99,22 @@ int texture_load_pixels(GLuint *tex, const uint8_t *data,
 	return GRAPHICS_OK;
 }
 
+/**
+ * Replaces a region of an RGBA texture created with texture_load_pixels().
+ *
+ * @param tex		The texture to update.
+ * @param x			Left edge of the region.
+ * @param y			Top edge of the region.
+ * @param data		The new pixels, width * height RGBA, rows tightly packed.
+ */
+void texture_update_pixels(GLuint tex, const int x, const int y,
+		const int width, const int height, const uint8_t *data)
+{
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+			GL_UNSIGNED_BYTE, data);
+}
+
 /**
  * Creates an empty texture, a white square. If a sprite does not have a
  * texture, the fragment shader can still multiply this texture with a sprite
@@ -86,6 +127,9 @@ void texture_white(GLuint *tex)
 	/* Upload texture. */
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
 			GL_FLOAT, COLOR_WHITE);
+#ifdef MEM_STATS
+	mem_gpu_alloc(MEM_GPU_TEXTURE, TEXTURE_SIZE(1, 1));
+#endif
 	/* Wrapping. */
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -96,12 +140,32 @@ void texture_white(GLuint *tex)
 
 void texture_free(const GLuint tex)
 {
+#ifdef MEM_STATS
+	if(tex != 0 && glIsTexture(tex)) {
+		GLint bound = 0;
+		GLint width = 0;
+		GLint height = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+		GLint format = 0;
+		GLint max_level = 0;
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max_level);
+		glBindTexture(GL_TEXTURE_2D, (GLuint) bound);
+		/* Only cooked textures have mip levels (and set the max level). */
+		uint32_t levels = (max_level < COOK_TEXTURE_LEVELS_MAX) ? (uint32_t) max_level + 1 : 1;
+		mem_gpu_free(MEM_GPU_TEXTURE, texture_gpu_size(width, height,
+				format == GL_R8 ? 1 : 4, levels));
+	}
+#endif
 	glDeleteTextures(1, &tex);
 }
 
 /**
- * Parses the image data from a PNG, JPEG, BMP or TGA image and stores in an
- * OpenGL texture.
+ * Parses the image data from a PNG, JPEG, BMP or TGA image (or a cooked
+ * texture, see texture_load_cooked()) and stores in an OpenGL texture.
  *
  * @param tex		Store the OpenGL texture id here.
  * @param width		Store the width of the texture here (or NULL).
@@ -116,6 +180,9 @@ int texture_load(GLuint *tex, int *width, int *height, const uint8_t *data,
 	int tmp_width;
 	int tmp_height;
 	int ret;
+	if(texture_is_cooked(data, len)) {
+		return texture_load_cooked(tex, width, height, data, len);
+	}
 	ret = image_load(&tmp, &tmp_width, &tmp_height, data, len);
 	if(ret != GRAPHICS_OK) {
 		return ret;
@@ -134,3 +201,204 @@ int texture_load(GLuint *tex, int *width, int *height, const uint8_t *data,
 	}
 	return GRAPHICS_OK;
 }
+
+/**
+ * @return	Non-zero if data starts like a cooked texture (see cook.h).
+ */
+int texture_is_cooked(const uint8_t *data, size_t len)
+{
+	const struct cook_texture_header *h = (const struct cook_texture_header *) data;
+	return data != NULL && len >= sizeof(struct cook_texture_header)
+		&& h->magic == COOK_TEXTURE_MAGIC;
+}
+
+/**
+ * Validates a cooked texture and computes where its mip levels start.
+ *
+ * @return	GRAPHICS_OK if all levels are within len.
+ */
+static int texture_cooked_levels(const struct cook_texture_header *h, size_t len,
+		size_t offsets[COOK_TEXTURE_LEVELS_MAX])
+{
+	if(h->version != COOK_TEXTURE_VERSION || h->format > COOK_TEXTURE_L8
+			|| h->width == 0 || h->height == 0
+			|| h->levels == 0 || h->levels > COOK_TEXTURE_LEVELS_MAX) {
+		return GRAPHICS_TEXTURE_LOAD_ERROR;
+	}
+
+	size_t offset = sizeof(struct cook_texture_header);
+	uint32_t bpp = cook_texture_bpp(h->format);
+	for(uint32_t i=0; i<h->levels; i++) {
+		offset = cook_align(offset);
+		offsets[i] = offset;
+		offset += (size_t) cook_texture_level_size(h->width, i)
+			* cook_texture_level_size(h->height, i) * bpp;
+		if(offset > len) {
+			return GRAPHICS_TEXTURE_LOAD_ERROR;
+		}
+	}
+
+	return GRAPHICS_OK;
+}
+
+/**
+ * Expands single channel pixels to RGBA, for GL versions without texture
+ * swizzling.
+ */
+static uint8_t* texture_expand(const uint8_t *src, size_t count, uint32_t format)
+{
+	uint8_t *dst = (uint8_t *) engine_malloc(MEM_GRAPHICS, count * 4);
+	if(dst == NULL) {
+		return NULL;
+	}
+	for(size_t i=0; i<count; i++) {
+		uint8_t c = (format == COOK_TEXTURE_A8) ? 255 : src[i];
+		dst[i*4 + 0] = c;
+		dst[i*4 + 1] = c;
+		dst[i*4 + 2] = c;
+		dst[i*4 + 3] = (format == COOK_TEXTURE_A8) ? src[i] : 255;
+	}
+	return dst;
+}
+
+/**
+ * Reads the largest mip level of a cooked texture (see cook.h) as RGBA
+ * pixels, for code that needs the pixels rather than a texture.
+ *
+ * @param out		Where to store pixel data, release with engine_free().
+ * @param width		Where to store image width.
+ * @param height	Where to store image height.
+ * @param data		The cooked texture.
+ * @param len		The length of the cooked texture.
+ */
+int image_load_cooked(uint8_t **out, int *width, int *height, const uint8_t *data, size_t len)
+{
+	const struct cook_texture_header *h = (const struct cook_texture_header *) data;
+	size_t offsets[COOK_TEXTURE_LEVELS_MAX];
+
+	if(!texture_is_cooked(data, len)
+			|| texture_cooked_levels(h, len, offsets) != GRAPHICS_OK) {
+		graphics_error("image_load_cooked(): Invalid cooked texture (%lu bytes)\n",
+				(unsigned long) len);
+		return GRAPHICS_IMAGE_LOAD_ERROR;
+	}
+
+	size_t count = (size_t) h->width * h->height;
+	uint8_t *pixels;
+	if(h->format == COOK_TEXTURE_RGBA8) {
+		pixels = (uint8_t *) engine_malloc(MEM_GRAPHICS, count * 4);
+		if(pixels != NULL) {
+			memcpy(pixels, data + offsets[0], count * 4);
+		}
+	} else {
+		pixels = texture_expand(data + offsets[0], count, h->format);
+	}
+	if(pixels == NULL) {
+		graphics_error("image_load_cooked(): Out of memory\n");
+		return GRAPHICS_IMAGE_LOAD_ERROR;
+	}
+
+	*out = pixels;
+	*width = h->width;
+	*height = h->height;
+	return GRAPHICS_OK;
+}
+
+/**
+ * Uploads a cooked texture written by generate_assets (see cook.h). The
+ * pixels are handed to GL straight from data, no decoding and no copy.
+ * Single channel textures are stored as GL_R8 and swizzled to white + alpha
+ * or to grayscale, or expanded to RGBA if swizzling is not supported.
+ *
+ * @param tex		Store the OpenGL texture id here.
+ * @param width		Store the width of the texture here (or NULL).
+ * @param height	Store the height of the texture here (or NULL).
+ * @param data		The cooked texture.
+ * @param len		The length of the cooked texture.
+ */
+int texture_load_cooked(GLuint *tex, int *width, int *height, const uint8_t *data,
+		size_t len)
+{
+	const struct cook_texture_header *h = (const struct cook_texture_header *) data;
+	size_t offsets[COOK_TEXTURE_LEVELS_MAX];
+
+	if(!texture_is_cooked(data, len)
+			|| texture_cooked_levels(h, len, offsets) != GRAPHICS_OK) {
+		graphics_error("texture_load_cooked(): Invalid cooked texture (%lu bytes)\n",
+				(unsigned long) len);
+		return GRAPHICS_TEXTURE_LOAD_ERROR;
+	}
+
+	int swizzle = 0;
+#ifndef EMSCRIPTEN
+	swizzle = GLEW_VERSION_3_3 || GLEW_ARB_texture_swizzle;
+#endif
+	int single = (h->format != COOK_TEXTURE_RGBA8);
+
+	glGenTextures(1, tex);
+	glBindTexture(GL_TEXTURE_2D, *tex);
+
+	/* Single channel rows are not 4 byte aligned. */
+	GLint alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for(uint32_t i=0; i<h->levels; i++) {
+		GLsizei w = (GLsizei) cook_texture_level_size(h->width, i);
+		GLsizei ht = (GLsizei) cook_texture_level_size(h->height, i);
+		const uint8_t *pixels = data + offsets[i];
+
+		if(!single) {
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, w, ht, 0, GL_RGBA,
+					GL_UNSIGNED_BYTE, pixels);
+		} else if(swizzle) {
+			glTexImage2D(GL_TEXTURE_2D, i, GL_R8, w, ht, 0, GL_RED,
+					GL_UNSIGNED_BYTE, pixels);
+		} else {
+			uint8_t *rgba = texture_expand(pixels, (size_t) w * ht, h->format);
+			if(rgba == NULL) {
+				graphics_error("texture_load_cooked(): Out of memory\n");
+				glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+				glDeleteTextures(1, tex);
+				return GRAPHICS_TEXTURE_LOAD_ERROR;
+			}
+			glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, w, ht, 0, GL_RGBA,
+					GL_UNSIGNED_BYTE, rgba);
+			engine_free(rgba);
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+#ifndef EMSCRIPTEN
+	if(single && swizzle) {
+		const GLint white_alpha[] = { GL_ONE, GL_ONE, GL_ONE, GL_RED };
+		const GLint luminance[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA,
+				h->format == COOK_TEXTURE_A8 ? white_alpha : luminance);
+	}
+#endif
+
+#ifdef MEM_STATS
+	mem_gpu_alloc(MEM_GPU_TEXTURE, texture_gpu_size(h->width, h->height,
+				(single && swizzle) ? 1 : 4, h->levels));
+#endif
+	/* Wrapping. */
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	/* Filter. */
+#ifndef EMSCRIPTEN
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, h->levels - 1);
+#endif
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			h->levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	if(width != NULL) {
+		*(width) = h->width;
+	}
+	if(height != NULL) {
+		*(height) = h->height;
+	}
+	return GRAPHICS_OK;
+}
@@ -5,12 +5,18 @@
 #include <GLFW/glfw3.h>
 
 int  image_load(uint8_t **out, int *width, int *height, const uint8_t *data, size_t len);
+int  image_load_cooked(uint8_t **out, int *width, int *height, const uint8_t *data, size_t len);
 void image_free(uint8_t *data);
 
 int  texture_load(GLuint *tex, int *width, int *height, const uint8_t *data,
 		size_t len);
+int  texture_load_cooked(GLuint *tex, int *width, int *height,
+		const uint8_t *data, size_t len);
+int  texture_is_cooked(const uint8_t *data, size_t len);
 int  texture_load_pixels(GLuint *tex, const uint8_t *data,
 		const int width, const int height);
+void texture_update_pixels(GLuint tex, const int x, const int y,
+		const int width, const int height, const uint8_t *data);
 void texture_white(GLuint *tex);
 void texture_free(const GLuint tex);
 
@@ -0,0 +1,155 @@
+/**
+ * Minimal portable threads, mutexes and condition variables.
+ */
+
+#if !defined(_WIN32) && !defined(EMSCRIPTEN)
+#include <unistd.h>
+#endif
+
+#include "thread.h"
+
+#if defined(_WIN32)
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+	struct thread *t = (struct thread *) arg;
+	t->fn(t->arg);
+	return 0;
+}
+#elif !defined(THREAD_NONE)
+static void* thread_main(void *arg)
+{
+	struct thread *t = (struct thread *) arg;
+	t->fn(t->arg);
+	return NULL;
+}
+#endif
+
+/**
+ * Start a thread running fn(arg).
+ *
+ * @param t		The thread. Must stay valid until thread_join() returns.
+ * @return		THREAD_OK, or THREAD_ERROR if the thread could not be created
+ *				(always on platforms without threads).
+ */
+int thread_create(struct thread *t, thread_fn_t fn, void *arg)
+{
+	t->fn = fn;
+	t->arg = arg;
+#if defined(_WIN32)
+	t->handle = CreateThread(NULL, 0, thread_main, t, 0, NULL);
+	return (t->handle != NULL) ? THREAD_OK : THREAD_ERROR;
+#elif !defined(THREAD_NONE)
+	return (pthread_create(&t->handle, NULL, thread_main, t) == 0) ? THREAD_OK : THREAD_ERROR;
+#else
+	return THREAD_ERROR;
+#endif
+}
+
+/**
+ * Wait for a thread created with thread_create() to return.
+ */
+void thread_join(struct thread *t)
+{
+#if defined(_WIN32)
+	WaitForSingleObject(t->handle, INFINITE);
+	CloseHandle(t->handle);
+#elif !defined(THREAD_NONE)
+	pthread_join(t->handle, NULL);
+#endif
+}
+
+/**
+ * @return	The number of online CPU cores, at least 1.
+ */
+int thread_cpu_count()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? (int) info.dwNumberOfProcessors : 1;
+#elif !defined(THREAD_NONE)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (int) n : 1;
+#else
+	return 1;
+#endif
+}
+
+void thread_mutex_init(struct thread_mutex *m)
+{
+#if defined(_WIN32)
+	InitializeCriticalSection(&m->handle);
+#elif !defined(THREAD_NONE)
+	pthread_mutex_init(&m->handle, NULL);
+#endif
+}
+
+void thread_mutex_free(struct thread_mutex *m)
+{
+#if defined(_WIN32)
+	DeleteCriticalSection(&m->handle);
+#elif !defined(THREAD_NONE)
+	pthread_mutex_destroy(&m->handle);
+#endif
+}
+
+void thread_mutex_lock(struct thread_mutex *m)
+{
+#if defined(_WIN32)
+	EnterCriticalSection(&m->handle);
+#elif !defined(THREAD_NONE)
+	pthread_mutex_lock(&m->handle);
+#endif
+}
+
+void thread_mutex_unlock(struct thread_mutex *m)
+{
+#if defined(_WIN32)
+	LeaveCriticalSection(&m->handle);
+#elif !defined(THREAD_NONE)
+	pthread_mutex_unlock(&m->handle);
+#endif
+}
+
+void thread_cond_init(struct thread_cond *c)
+{
+#if defined(_WIN32)
+	InitializeConditionVariable(&c->handle);
+#elif !defined(THREAD_NONE)
+	pthread_cond_init(&c->handle, NULL);
+#endif
+}
+
+void thread_cond_free(struct thread_cond *c)
+{
+#if !defined(_WIN32) && !defined(THREAD_NONE)
+	pthread_cond_destroy(&c->handle);
+#endif
+}
+
+void thread_cond_wait(struct thread_cond *c, struct thread_mutex *m)
+{
+#if defined(_WIN32)
+	SleepConditionVariableCS(&c->handle, &m->handle, INFINITE);
+#elif !defined(THREAD_NONE)
+	pthread_cond_wait(&c->handle, &m->handle);
+#endif
+}
+
+void thread_cond_signal(struct thread_cond *c)
+{
+#if defined(_WIN32)
+	WakeConditionVariable(&c->handle);
+#elif !defined(THREAD_NONE)
+	pthread_cond_signal(&c->handle);
+#endif
+}
+
+void thread_cond_broadcast(struct thread_cond *c)
+{
+#if defined(_WIN32)
+	WakeAllConditionVariable(&c->handle);
+#elif !defined(THREAD_NONE)
+	pthread_cond_broadcast(&c->handle);
+#endif
+}
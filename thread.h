@@ -0,0 +1,75 @@
+/**
+ * Minimal portable threads, mutexes and condition variables.
+ *
+ * Uses pthreads, or the native API on Windows. On platforms without threads
+ * (Emscripten) THREAD_NONE is defined and thread_create() always fails, so
+ * callers must be able to run their work on the calling thread instead.
+ */
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include "log.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(EMSCRIPTEN)
+#define THREAD_NONE
+#else
+#include <pthread.h>
+#endif
+
+#define thread_debug(...) debugf("Thread", __VA_ARGS__)
+#define thread_error(...) errorf("Thread", __VA_ARGS__)
+
+#define THREAD_OK		0
+#define THREAD_ERROR	-1
+
+typedef void (*thread_fn_t)(void *arg);
+
+struct thread {
+	thread_fn_t			fn;
+	void				*arg;
+#if defined(_WIN32)
+	HANDLE				handle;
+#elif !defined(THREAD_NONE)
+	pthread_t			handle;
+#endif
+};
+
+struct thread_mutex {
+#if defined(_WIN32)
+	CRITICAL_SECTION	handle;
+#elif !defined(THREAD_NONE)
+	pthread_mutex_t		handle;
+#else
+	int					unused;
+#endif
+};
+
+struct thread_cond {
+#if defined(_WIN32)
+	CONDITION_VARIABLE	handle;
+#elif !defined(THREAD_NONE)
+	pthread_cond_t		handle;
+#else
+	int					unused;
+#endif
+};
+
+int		thread_create(struct thread *t, thread_fn_t fn, void *arg);
+void	thread_join(struct thread *t);
+int		thread_cpu_count();
+
+void	thread_mutex_init(struct thread_mutex *m);
+void	thread_mutex_free(struct thread_mutex *m);
+void	thread_mutex_lock(struct thread_mutex *m);
+void	thread_mutex_unlock(struct thread_mutex *m);
+
+void	thread_cond_init(struct thread_cond *c);
+void	thread_cond_free(struct thread_cond *c);
+void	thread_cond_wait(struct thread_cond *c, struct thread_mutex *m);
+void	thread_cond_signal(struct thread_cond *c);
+void	thread_cond_broadcast(struct thread_cond *c);
+
+#endif
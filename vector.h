@@ -0,0 +1,179 @@
+/**
+ * Typed dynamic arrays.
+ *
+ * Unlike struct alist, which stores void pointers, a vector stores its
+ * elements by value in one contiguous block of memory. A vector type is
+ * generated for a specific element type with VECTOR_DEFINE().
+ *
+ * Example:
+ * @code
+ * VECTOR_DEFINE(int_vector, int)
+ *
+ * struct int_vector v = { 0 };
+ * int_vector_init(&v, 16);
+ * *int_vector_push(&v) = 42;
+ * foreach_vector(int, i, &v) {
+ *     printf("%d\n", (*i));
+ * }
+ * int_vector_free(&v);
+ * @endcode
+ */
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Defines "struct name" holding elements of "type", and the functions
+ * operating on it. All functions are prefixed with "name_".
+ *
+ * name_init(v, initial_size)	Allocate room for initial_size elements.
+ * name_free(v)					Free the element storage.
+ * name_reserve(v, size)		Make sure there is room for size elements.
+ * name_push(v)					Append a zeroed element and return a pointer
+ *								to it, or NULL if out of memory.
+ * name_swap_remove(v, index)	Remove an element by moving the last element
+ *								into its place. Does not preserve order.
+ * name_remove_if(v, pred, ctx)	Remove all elements for which pred(item, ctx)
+ *								returns true in one pass, filling holes with
+ *								elements from the end. Does not preserve
+ *								order. Returns the number of removed elements.
+ * name_remove_if_stable(v, pred, ctx)
+ *								Like name_remove_if(), but preserves the order
+ *								of the remaining elements.
+ * name_clear(v)				Remove all elements, keeping the storage.
+ *
+ * NOTE: Pointers to elements are only valid until the next call that adds or
+ * removes elements.
+ *
+ * @param name	The name of the vector struct and the function prefix.
+ * @param type	The element type.
+ */
+#define VECTOR_DEFINE(name, type) \
+	struct name { \
+		size_t	size;	/* Number of elements allocated. */ \
+		size_t	count;	/* Number of elements in use. */ \
+		type	*data;	/* Element storage. */ \
+	}; \
+	\
+	static inline int name##_reserve(struct name *v, size_t size) \
+	{ \
+		if(size <= v->size) { \
+			return 0; \
+		} \
+		type *data = (type *) realloc(v->data, size * sizeof(type)); \
+		if(data == NULL) { \
+			return -1; \
+		} \
+		v->data = data; \
+		v->size = size; \
+		return 0; \
+	} \
+	\
+	static inline int name##_init(struct name *v, size_t initial_size) \
+	{ \
+		v->size = 0; \
+		v->count = 0; \
+		v->data = NULL; \
+		return name##_reserve(v, initial_size); \
+	} \
+	\
+	static inline void name##_free(struct name *v) \
+	{ \
+		free(v->data); \
+		v->data = NULL; \
+		v->size = 0; \
+		v->count = 0; \
+	} \
+	\
+	static inline type* name##_push(struct name *v) \
+	{ \
+		if(v->count >= v->size \
+				&& name##_reserve(v, v->size > 0 ? v->size * 2 : 8) != 0) { \
+			return NULL; \
+		} \
+		type *item = &v->data[v->count++]; \
+		memset(item, 0, sizeof(type)); \
+		return item; \
+	} \
+	\
+	static inline void name##_swap_remove(struct name *v, size_t index) \
+	{ \
+		if(index >= v->count) { \
+			return; \
+		} \
+		v->count--; \
+		if(index != v->count) { \
+			v->data[index] = v->data[v->count]; \
+		} \
+	} \
+	\
+	static inline size_t name##_remove_if(struct name *v, \
+			int (*pred)(type *item, void *ctx), void *ctx) \
+	{ \
+		size_t i = 0; \
+		size_t n = v->count; \
+		while(i < n) { \
+			if(!pred(&v->data[i], ctx)) { \
+				i++; \
+				continue; \
+			} \
+			n--; \
+			while(n > i && pred(&v->data[n], ctx)) { \
+				n--; \
+			} \
+			if(n > i) { \
+				v->data[i] = v->data[n]; \
+				i++; \
+			} \
+		} \
+		size_t removed = v->count - n; \
+		v->count = n; \
+		return removed; \
+	} \
+	\
+	static inline size_t name##_remove_if_stable(struct name *v, \
+			int (*pred)(type *item, void *ctx), void *ctx) \
+	{ \
+		size_t keep = 0; \
+		for(size_t i = 0; i < v->count; i++) { \
+			if(pred(&v->data[i], ctx)) { \
+				continue; \
+			} \
+			if(keep != i) { \
+				v->data[keep] = v->data[i]; \
+			} \
+			keep++; \
+		} \
+		size_t removed = v->count - keep; \
+		v->count = keep; \
+		return removed; \
+	} \
+	\
+	static inline void name##_clear(struct name *v) \
+	{ \
+		v->count = 0; \
+	}
+
+/**
+ * Iterates a vector and stores a pointer to the currently iterated element in
+ * a variable named after 'item'.
+ *
+ * @code
+ * foreach_vector(struct particle, p, &em->particles) {
+ *     p->age += dt;
+ * }
+ * @endcode
+ *
+ * @param type	The element type of the vector.
+ * @param item	The name assigned to the currently iterated element pointer.
+ * @param v		A pointer to the vector to iterate over.
+ */
+#define foreach_vector(type, item, v) \
+	for(type *item = (v)->data; \
+			item < (v)->data + (v)->count; \
+			item++)
+
+#endif
@@ -5,145 +5,1601 @@
 * Use vfs_mount(const char* dir) to read all files in dir to memory.
 * Use vfs_register_callback(const char* filename, read_callback_t fn) to read file
 *
-*	 Compile with VFS_ENABLE_FILEWATCH to enable filewatching
+*	 Compile with VFS_ENABLE_FILEWATCH to enable filewatching. On Linux,
+*	 changes are picked up with inotify and reloaded once a file has been
+*	 quiet for VFS_FILEWATCH_DELAY_MS. Elsewhere, or if inotify is not
+*	 available, the timestamp of every file is polled once per frame. A
+*	 changed file only runs its callbacks if its content hash changed, so
+*	 touching a file or saving it unchanged costs one read.
+*
+*	 vfs_mount() walks the directory on a separate thread while the job pool
+*	 reads the files it finds, so opening and reading files overlaps with
+*	 the walk and with each other. Platforms without threads mount serially.
+*
+*	 Use vfs_set_mmap(1) before mounting to map files read-only instead of
+*	 reading them into memory, so only the pages that are actually used are
+*	 read from disk.
+*
+*	 Use vfs_set_lazy(1) before mounting to only index files on mount. Files
+*	 are then read when first used, and their callbacks only run once the
+*	 file is asked for with vfs_request() or first read with vfs_get_file().
+*	 Games request the assets of a state as they enter it. With
+*	 vfs_set_budget(), the least
+*	 recently used files that can be read again (lazily mounted or packed)
+*	 are released once the loaded contents exceed the budget, unless pinned
+*	 with vfs_set_resident(). Files are only released by
+*	 vfs_enforce_budget(), once per frame, never while loading another file.
+*
+*	 The contents of a file are released once all its callbacks have
+*	 consumed them, and read again from disk or the pack when next used or
+*	 when the file changes. A callback that keeps pointers to the contents
+*	 calls vfs_keep_contents() every time it runs; the contents then stay
+*	 loaded until it runs again without calling it.
+*
+*	 Use vfs_register_loader() for assets that take long to decode. Their
+*	 decode stage runs on worker threads in vfs_run_callbacks(), overlapped
+*	 with the main thread running the other callbacks and uploading the
+*	 assets that have finished decoding.
+*
+*	 Use vfs_mount_pack(const char* path) to mount a pack written by
+*	 generate_assets (see pack.h). The pack is mapped once and files are served
+*	 straight from the mapping. Compressed files are decompressed the first
+*	 time they are used. Directories mounted afterwards overlay the pack.
 *
 * Author: Johan Yngman <johan.yngman@gmail.com>
 */
 
-#include "vfs.h"
-#include "log.h"
+#include "vfs.h"
+#include "log.h"
+#include "mem.h"
+#include "hash.h"
+#include "pack.h"
+#include "compress.h"
+#include "job.h"
+
+#if defined(VFS_ENABLE_FILEWATCH) && defined(__linux__)
+#define VFS_INOTIFY
+#include <unistd.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#endif
+
+#if !defined(_WIN32) && !defined(EMSCRIPTEN)
+#define VFS_MMAP_SUPPORTED
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+typedef unsigned long DWORD;
+
+#define STB_DEFINE
+#include <stb/stb.h>
+
+#define vfs_debug(...) debugf("VFS", __VA_ARGS__)
+#define vfs_error(...) errorf("VFS", __VA_ARGS__)
+
+#define VFS_FILE_TABLE_INITIAL_SIZE	256
+#define VFS_INDEX_INITIAL_SIZE		512
+#define VFS_FILEWATCH_DELAY_MS		100
+#define VFS_MOUNT_QUEUE_SIZE		256		/* Paths the walker may find ahead of the readers. */
+#define VFS_MOUNT_READS_MAX			32		/* Reads in flight during a mount. */
+
+/**
+ * Find a file by simplename.
+ *
+ * @param filename	The simplename of the file.
+ * @param hash		vfs_hash(filename).
+ * @return			The index of the file in file_table, or -1 if not found.
+ */
+static int vfs_find(const char* filename, uint32_t hash)
+{
+	if (vfs_global->index_size == 0)
+	{
+		return -1;
+	}
+
+	int mask = vfs_global->index_size - 1;
+	for (int slot = hash & mask; vfs_global->index[slot] != 0; slot = (slot + 1) & mask)
+	{
+		struct vfs_file* f = vfs_global->file_table[vfs_global->index[slot] - 1];
+		if (f->hash == hash && strcmp(f->simplename, filename) == 0)
+		{
+			return vfs_global->index[slot] - 1;
+		}
+	}
+
+	return -1;
+}
+
+static void vfs_index_insert(int file_index)
+{
+	int mask = vfs_global->index_size - 1;
+	int slot = vfs_global->file_table[file_index]->hash & mask;
+	while (vfs_global->index[slot] != 0)
+	{
+		slot = (slot + 1) & mask;
+	}
+	vfs_global->index[slot] = file_index + 1;
+}
+
+/**
+ * Rebuild the hash index with room for at least twice as many slots as files.
+ */
+static int vfs_index_grow(int min_files)
+{
+	int size = vfs_global->index_size > 0 ? vfs_global->index_size : VFS_INDEX_INITIAL_SIZE;
+	while (size < min_files * 2)
+	{
+		size *= 2;
+	}
+
+	if (size == vfs_global->index_size)
+	{
+		return 0;
+	}
+
+	int* index = (int*)engine_calloc(MEM_VFS, size, sizeof(int));
+	if (index == NULL)
+	{
+		vfs_error("Out of memory\n");
+		return -1;
+	}
+
+	engine_free(vfs_global->index);
+	vfs_global->index = index;
+	vfs_global->index_size = size;
+
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		vfs_index_insert(i);
+	}
+
+	return 0;
+}
+
+/**
+ * Append a new, empty file to the file table and the hash index.
+ *
+ * @return	The new file, or NULL if out of memory.
+ */
+static struct vfs_file* vfs_add_file(const char* name, const char* simplename, uint32_t hash)
+{
+	if (vfs_global->file_count >= vfs_global->file_table_size)
+	{
+		int size = vfs_global->file_table_size > 0 ? vfs_global->file_table_size * 2 : VFS_FILE_TABLE_INITIAL_SIZE;
+		struct vfs_file** file_table = (struct vfs_file**)engine_realloc(MEM_VFS, vfs_global->file_table, size * sizeof(struct vfs_file*));
+		if (file_table == NULL)
+		{
+			vfs_error("Out of memory\n");
+			return NULL;
+		}
+		vfs_global->file_table = file_table;
+		vfs_global->file_table_size = size;
+	}
+
+	if (vfs_global->file_count + 1 > vfs_global->index_size / 2 && vfs_index_grow(vfs_global->file_count + 1) != 0)
+	{
+		return NULL;
+	}
+
+	struct vfs_file* f = (struct vfs_file*)engine_calloc(MEM_VFS, 1, sizeof(struct vfs_file));
+	if (f == NULL)
+	{
+		vfs_error("Out of memory\n");
+		return NULL;
+	}
+
+	strcpy(f->name, name);
+	strcpy(f->simplename, simplename);
+	f->hash = hash;
+
+	vfs_global->file_table[vfs_global->file_count] = f;
+	vfs_index_insert(vfs_global->file_count);
+	vfs_global->file_count++;
+
+	return f;
+}
+
+/**
+ * A file read from disk. vfs_read_path() only touches the struct, so reads
+ * can run on worker threads (see vfs_mount_parallel()).
+ */
+struct vfs_read
+{
+	struct job job;
+	struct vfs_file* f;			/* Destination, only touched on the main thread. */
+	char path[MAX_FILENAME_LEN];
+	int map;					/* Map the file instead of reading it. */
+	void* data;
+	size_t size;
+	int storage;
+	time_t lastChange;			/* 0 if the file could not be opened. */
+	uint64_t content_hash;		/* 0 if not computed (mapped files). */
+};
+
+/**
+ * Free file contents, however they were loaded.
+ */
+static void vfs_free_contents(void* data, size_t size, int storage)
+{
+	switch (storage)
+	{
+	case VFS_STORAGE_HEAP:
+		engine_free(data);
+		break;
+#ifdef VFS_MMAP_SUPPORTED
+	case VFS_STORAGE_MAPPED:
+		munmap(data, size);
+		break;
+#endif
+	case VFS_STORAGE_PACK:
+		/* Owned by the pack. */
+		break;
+	}
+}
+
+/**
+ * Release the contents of a file, however they were loaded.
+ */
+static void vfs_release_data(struct vfs_file* f)
+{
+	if (f->data == 0)
+	{
+		return;
+	}
+
+	vfs_free_contents(f->data, f->size, f->storage);
+
+	f->data = 0;
+	f->storage = VFS_STORAGE_HEAP;
+}
+
+#ifdef VFS_MMAP_SUPPORTED
+/**
+ * Map a file read-only. Pages are read from disk when first touched.
+ *
+ * NOTE: If the file is truncated on disk, touching the mapping past the new
+ * end of the file raises SIGBUS until the change has been picked up and the
+ * file is mapped again.
+ */
+static void vfs_map_path(struct vfs_read* r)
+{
+	int fd = open(r->path, O_RDONLY);
+	if (fd < 0)
+	{
+		vfs_error("Could not open %s\n", r->path);
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		vfs_error("Could not stat %s\n", r->path);
+		close(fd);
+		return;
+	}
+	r->lastChange = st.st_mtime;
+
+	/* Empty files can not be mapped. */
+	if (st.st_size == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		vfs_error("Could not map %s\n", r->path);
+		return;
+	}
+
+	/* Loaders decode files front to back. */
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	r->data = data;
+	r->size = st.st_size;
+	r->storage = VFS_STORAGE_MAPPED;
+}
+
+/**
+ * Drop the resident pages of a mapped file once its callbacks have decoded it.
+ * The mapping stays valid: pages are read back from disk if touched again.
+ */
+static void vfs_file_decoded(struct vfs_file* f)
+{
+	if (f->storage == VFS_STORAGE_MAPPED)
+	{
+		madvise(f->data, f->size, MADV_DONTNEED);
+	}
+}
+#else
+#define vfs_file_decoded(f)
+#endif
+
+/**
+ * If the contents of a file must stay loaded: it is pinned, or one of its
+ * callbacks kept them (see vfs_keep_contents()).
+ */
+static int vfs_file_kept(const struct vfs_file* f)
+{
+	if (f->resident)
+	{
+		return 1;
+	}
+	for (int j = 0, j_size = stb_arr_len(f->read_callbacks); j < j_size; j++)
+	{
+		if (f->read_callbacks[j].keep)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Called once every callback of a file has run. Unless a callback kept the
+ * contents or the file is pinned (see vfs_file_kept()), they are released and
+ * read again from disk or the pack the next time they are needed.
+ */
+static void vfs_file_consumed(struct vfs_file* f)
+{
+	if (vfs_file_kept(f) || f->data == 0 || f->storage == VFS_STORAGE_PACK)
+	{
+		vfs_file_decoded(f);
+		return;
+	}
+
+	if (f->packed == NULL)
+	{
+		/* Mounted from a directory: read it again on the next use. */
+		f->lazy = 1;
+	}
+	vfs_release_data(f);
+}
+
+/**
+ * Map files read-only instead of reading them into memory on mount. Only
+ * affects files (re)loaded after the call. Not supported on all platforms.
+ */
+void vfs_set_mmap(int enabled)
+{
+#ifdef VFS_MMAP_SUPPORTED
+	vfs_global->mmap = enabled;
+#else
+	if (enabled)
+	{
+		vfs_error("Memory mapped files are not supported on this platform\n");
+	}
+#endif
+}
+
+/**
+ * Only index files on mount and read them when first used. Only affects
+ * directories mounted after the call.
+ */
+void vfs_set_lazy(int enabled)
+{
+	vfs_global->lazy = enabled;
+}
+
+/**
+ * Pin a file (never released once its callbacks have run, or to stay under
+ * the budget) or unpin it. Callbacks that keep pointers to the contents use
+ * vfs_keep_contents() instead.
+ */
+void vfs_set_resident(const char* filename, int resident)
+{
+	int i = vfs_find(filename, vfs_hash(filename));
+
+	if (i >= 0)
+	{
+		vfs_global->file_table[i]->resident = resident;
+	}
+}
+
+/**
+ * Called from a read callback (not a loader) that keeps pointers to the
+ * contents after it returns. Until the callback runs again without calling
+ * this, the contents are not released, not even to stay under the budget.
+ */
+void vfs_keep_contents()
+{
+	vfs_global->keep = 1;
+}
+
+/**
+ * Read (or map) the file at r->path.
+ */
+static void vfs_read_path(struct vfs_read* r)
+{
+#ifdef VFS_MMAP_SUPPORTED
+	if (r->map)
+	{
+		vfs_map_path(r);
+		return;
+	}
+#endif
+
+	/* Plain stdio: stb_fclose() is not thread safe. */
+	FILE* file = fopen(r->path, "rb");
+	if (file == 0)
+	{
+		vfs_error("Could not open %s\n", r->path);
+		return;
+	}
+
+	size_t size = stb_filelen(file);
+	void* data = engine_malloc(MEM_VFS, size);
+	if (data == NULL && size > 0)
+	{
+		vfs_error("Out of memory reading %s (%lu bytes)\n", r->path, (unsigned long)size);
+		fclose(file);
+		return;
+	}
+	if (fread(data, 1, size, file) != size)
+	{
+		vfs_error("Could not read %s\n", r->path);
+		engine_free(data);
+		fclose(file);
+		return;
+	}
+	fclose(file);
+
+	/* Only a complete read counts as loaded (lastChange != 0). */
+	r->lastChange = stb_ftimestamp(r->path);
+	r->size = size;
+	r->data = data;
+	r->storage = VFS_STORAGE_HEAP;
+
+	/* Mapped files are hashed when needed, so only used pages are read. */
+	r->content_hash = hash_xxh64(r->data, r->size, 0);
+}
+
+static void vfs_read_job_run(void* arg)
+{
+	vfs_read_path((struct vfs_read*)arg);
+}
+
+/**
+ * Replace the contents of a file with what was read from disk.
+ */
+static void vfs_set_contents(struct vfs_file* f, const struct vfs_read* r)
+{
+	vfs_release_data(f);
+	f->packed = NULL;
+	f->data = r->data;
+	f->size = r->size;
+	f->storage = r->storage;
+	f->content_hash = r->content_hash;
+	if (r->lastChange != 0)
+	{
+		f->lastChange = r->lastChange;
+	}
+}
+
+/**
+ * Read the contents of a file from disk, replacing any previous contents.
+ */
+static void vfs_read_file(struct vfs_file* f)
+{
+	struct vfs_read r = { 0 };
+	strcpy(r.path, f->name);
+	r.map = vfs_global->mmap;
+	vfs_read_path(&r);
+	vfs_set_contents(f, &r);
+}
+
+/**
+ * Compute the content hash of a loaded file, unless already known.
+ */
+static void vfs_file_hash(struct vfs_file* f)
+{
+	if (f->content_hash == 0 && f->data != 0)
+	{
+		f->content_hash = hash_xxh64(f->data, f->size, 0);
+	}
+}
+
+/**
+ * Point a file into its pack, decompressing it if needed.
+ */
+static void vfs_unpack_file(struct vfs_file* f)
+{
+	if (!(f->pack_flags & PACK_ENTRY_LZ4))
+	{
+		f->data = (void*)f->packed;
+		f->storage = VFS_STORAGE_PACK;
+		return;
+	}
+
+	void* data = engine_malloc(MEM_VFS, f->size > 0 ? f->size : 1);
+	if (data == NULL)
+	{
+		vfs_error("Out of memory\n");
+		return;
+	}
+
+	if (decompress_lz4(f->packed, f->packed_size, data, f->size) != COMPRESS_OK)
+	{
+		vfs_error("Corrupt file in pack: %s\n", f->name);
+		engine_free(data);
+		return;
+	}
+
+	f->data = data;
+	f->storage = VFS_STORAGE_HEAP;
+}
+
+/**
+ * If the contents of a file can be released and loaded again later.
+ */
+static int vfs_file_evictable(const struct vfs_file* f)
+{
+	return !vfs_file_kept(f)
+		&& f->data != 0
+		&& f->storage != VFS_STORAGE_PACK
+		&& (f->lazy || f->packed != NULL);
+}
+
+/**
+ * @return	The number of bytes of file contents currently loaded (not
+ *			counting files served straight from a pack).
+ */
+size_t vfs_loaded_bytes()
+{
+	size_t bytes = 0;
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (f->data != 0 && f->storage != VFS_STORAGE_PACK)
+		{
+			bytes += f->size;
+		}
+	}
+	return bytes;
+}
+
+/**
+ * Release the least recently used evictable files until the loaded contents
+ * fit the budget. Pointers to the contents of released files become invalid,
+ * so this only runs at safe points: at the end of vfs_run_callbacks() and
+ * once per frame, where nothing holds on to contents that are not pinned.
+ */
+void vfs_enforce_budget()
+{
+	if (vfs_global->budget == 0)
+	{
+		return;
+	}
+
+	size_t loaded = vfs_loaded_bytes();
+	while (loaded > vfs_global->budget)
+	{
+		struct vfs_file* lru = NULL;
+		for (int i = 0; i < vfs_global->file_count; i++)
+		{
+			struct vfs_file* f = vfs_global->file_table[i];
+			if (vfs_file_evictable(f) && (lru == NULL || f->last_use < lru->last_use))
+			{
+				lru = f;
+			}
+		}
+
+		if (lru == NULL)
+		{
+			break;
+		}
+
+		loaded -= lru->size;
+		vfs_release_data(lru);
+	}
+}
+
+/**
+ * Get the contents of a file, reading it (lazily mounted) or decompressing it
+ * (packed) if needed.
+ *
+ * @return	The contents, or NULL if the file has none.
+ */
+static void* vfs_file_data(struct vfs_file* f)
+{
+	if (f->data == 0)
+	{
+		if (f->packed != NULL)
+		{
+			vfs_unpack_file(f);
+		}
+		else if (f->lazy)
+		{
+			vfs_read_file(f);
+		}
+	}
+
+	f->last_use = ++vfs_global->clock;
+	return f->data;
+}
+
+/**
+ * Keep the loaded file contents under a number of bytes by releasing the least
+ * recently used files that can be loaded again. Files that are resident, or
+ * were mounted from a directory without vfs_set_lazy(), are never released.
+ * Takes effect on the next vfs_enforce_budget().
+ *
+ * @param bytes	The budget, or 0 for no limit.
+ */
+void vfs_set_budget(size_t bytes)
+{
+	vfs_global->budget = bytes;
+}
+
+/**
+ * Read a whole pack, mapping it read-only where supported.
+ */
+static int vfs_pack_load(const char* path, struct vfs_pack* pack)
+{
+#ifdef VFS_MMAP_SUPPORTED
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		vfs_error("Could not open %s\n", path);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		vfs_error("Could not stat %s\n", path);
+		close(fd);
+		return -1;
+	}
+
+	void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		vfs_error("Could not map %s\n", path);
+		return -1;
+	}
+
+	pack->base = base;
+	pack->size = st.st_size;
+	pack->mapped = 1;
+#else
+	FILE* fp = stb_fopen(path, "rb");
+	if (fp == 0)
+	{
+		vfs_error("Could not open %s\n", path);
+		return -1;
+	}
+
+	size_t size = stb_filelen(fp);
+	void* base = engine_malloc(MEM_VFS, size);
+	if (base == NULL || fread(base, 1, size, fp) != size)
+	{
+		vfs_error("Could not read %s\n", path);
+		engine_free(base);
+		stb_fclose(fp, 0);
+		return -1;
+	}
+	stb_fclose(fp, 0);
+
+	pack->base = base;
+	pack->size = size;
+	pack->mapped = 0;
+#endif
+
+	return 0;
+}
+
+static void vfs_pack_unload(struct vfs_pack* pack)
+{
+#ifdef VFS_MMAP_SUPPORTED
+	if (pack->mapped)
+	{
+		munmap(pack->base, pack->size);
+		return;
+	}
+#endif
+	engine_free(pack->base);
+}
+
+/**
+ * Check that the header and every entry of a pack lie within the pack.
+ */
+static int vfs_pack_validate(const char* path, const struct vfs_pack* pack)
+{
+	const struct pack_header* header = (const struct pack_header*)pack->base;
+
+	if (pack->size < sizeof(struct pack_header)
+		|| header->magic != PACK_MAGIC
+		|| header->version != PACK_VERSION
+		|| header->size != pack->size)
+	{
+		vfs_error("Not a valid pack: %s\n", path);
+		return -1;
+	}
+
+	size_t entries_size = pack->size - sizeof(struct pack_header);
+	if (header->count > entries_size / sizeof(struct pack_entry))
+	{
+		vfs_error("Truncated pack index: %s\n", path);
+		return -1;
+	}
+
+	size_t names_offset = sizeof(struct pack_header) + header->count * sizeof(struct pack_entry);
+	const char* names = (const char*)pack->base + names_offset;
+	if (header->names_size == 0
+		|| header->names_size > pack->size - names_offset
+		|| names[header->names_size - 1] != '\0')
+	{
+		vfs_error("Truncated pack name table: %s\n", path);
+		return -1;
+	}
+
+	const struct pack_entry* entries = (const struct pack_entry*)(header + 1);
+	for (uint32_t i = 0; i < header->count; i++)
+	{
+		const struct pack_entry* e = &entries[i];
+		if (e->name >= header->names_size
+			|| strlen(names + e->name) >= MAX_FILENAME_LEN
+			|| e->offset > pack->size
+			|| e->size > pack->size - e->offset
+			|| (e->flags & ~PACK_ENTRY_FLAGS) != 0
+			|| (!(e->flags & PACK_ENTRY_LZ4) && e->raw_size != e->size)
+			|| e->raw_size > (size_t)-1)
+		{
+			vfs_error("Invalid pack entry %u: %s\n", i, path);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void vfs_init(const char *mount_path)
+{
+	vfs_global->file_table = NULL;
+	vfs_global->file_count = 0;
+	vfs_global->file_table_size = 0;
+	vfs_global->index = NULL;
+	vfs_global->index_size = 0;
+	vfs_global->watch_fd = -1;
+	vfs_global->watch_dirty = 0;
+	vfs_global->watches = NULL;
+	vfs_global->pending = NULL;
+	vfs_global->mmap = 0;
+	vfs_global->packs = NULL;
+	vfs_global->lazy = 0;
+	vfs_global->budget = 0;
+	vfs_global->clock = 0;
+
+#ifdef VFS_INOTIFY
+	/* Directories are watched by vfs_filewatch() as files are mounted. */
+	vfs_global->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (vfs_global->watch_fd < 0)
+	{
+		vfs_error("inotify not available, polling for changes\n");
+	}
+#endif
+
+	if (mount_path != NULL) {
+		vfs_mount(mount_path);
+	}
+}
+
+void vfs_shutdown()
+{
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+		vfs_release_data(f);
+		stb_arr_free(f->read_callbacks);
+		engine_free(f);
+	}
+
+	engine_free(vfs_global->file_table);
+	engine_free(vfs_global->index);
+	vfs_global->file_table = NULL;
+	vfs_global->file_count = 0;
+	vfs_global->file_table_size = 0;
+	vfs_global->index = NULL;
+	vfs_global->index_size = 0;
+
+	for (int i = 0, i_size = stb_arr_len(vfs_global->packs); i < i_size; i++)
+	{
+		vfs_pack_unload(&vfs_global->packs[i]);
+	}
+	stb_arr_free(vfs_global->packs);
+	vfs_global->packs = NULL;
+
+#ifdef VFS_INOTIFY
+	if (vfs_global->watch_fd >= 0)
+	{
+		close(vfs_global->watch_fd);
+		vfs_global->watch_fd = -1;
+	}
+#endif
+	stb_arr_free(vfs_global->watches);
+	stb_arr_free(vfs_global->pending);
+	vfs_global->watches = NULL;
+	vfs_global->pending = NULL;
+}
+
+/**
+ * Hash a simplename for use with the *_hashed() functions. The hash can be
+ * computed ahead of time (generate_assets does this) to skip hashing the
+ * name on every lookup.
+ */
+uint32_t vfs_hash(const char* filename)
+{
+	return hash_fnv1a_str(filename);
+}
+
+static void vfs_register(const char* filename, uint32_t hash, const struct read_callback* cbck);
+
+/**
+ * Run callback j of a file on the calling thread, both stages if it is a
+ * loader, and record whether it kept the contents (see vfs_keep_contents()).
+ */
+static void vfs_callback_run(struct vfs_file* f, int j)
+{
+	/* A copy: the callback may register callbacks and grow the array. */
+	struct read_callback cbck = f->read_callbacks[j];
+
+	if (cbck.fn != NULL)
+	{
+		vfs_global->keep = 0;
+		cbck.fn(f->simplename, f->size, f->data, cbck.userdata);
+		f->read_callbacks[j].keep = vfs_global->keep;
+		vfs_global->keep = 0;
+		return;
+	}
+
+	void* decoded = cbck.decode(f->simplename, f->size, f->data, cbck.userdata);
+	if (decoded != NULL)
+	{
+		cbck.upload(f->simplename, f->size, decoded, cbck.userdata);
+	}
+}
+
+void vfs_register_callback(const char* filename, read_callback_t fn, void* userdata)
+{
+	vfs_register_callback_hashed(filename, vfs_hash(filename), fn, userdata);
+}
+
+void vfs_register_callback_hashed(const char* filename, uint32_t hash, read_callback_t fn, void* userdata)
+{
+	struct read_callback cbck = { 0 };
+	cbck.fn = fn;
+	cbck.userdata = userdata;
+	vfs_register(filename, hash, &cbck);
+}
+
+void vfs_register_loader(const char* filename, decode_callback_t decode, upload_callback_t upload, void* userdata)
+{
+	vfs_register_loader_hashed(filename, vfs_hash(filename), decode, upload, userdata);
+}
+
+void vfs_register_loader_hashed(const char* filename, uint32_t hash, decode_callback_t decode, upload_callback_t upload, void* userdata)
+{
+	struct read_callback cbck = { 0 };
+	cbck.decode = decode;
+	cbck.upload = upload;
+	cbck.userdata = userdata;
+	vfs_register(filename, hash, &cbck);
+}
+
+static void vfs_register(const char* filename, uint32_t hash, const struct read_callback* cbck)
+{
+	struct vfs_file* f = NULL;
+	int i = vfs_find(filename, hash);
+
+	if (i >= 0)
+	{
+		f = vfs_global->file_table[i];
+	}
+	else
+	{
+		/* Not mounted (yet): add a placeholder that a later mount fills in. */
+		f = vfs_add_file(filename, filename, hash);
+		if (f == NULL)
+		{
+			return;
+		}
+	}
+
+	stb_arr_push(f->read_callbacks, *cbck);
+}
+
+void vfs_register_callback_filter(const char* filter, read_callback_t fn, void* userdata)
+{
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		if (strstr(vfs_global->file_table[i]->name, filter) != 0)
+		{
+			struct read_callback cbck = { 0 };
+			cbck.fn = fn;
+			cbck.userdata = userdata;
+			stb_arr_push(vfs_global->file_table[i]->read_callbacks, cbck);
+		}
+	}
+}
+
+#ifdef VFS_ENABLE_FILEWATCH
+/**
+ * If changes to a file should be picked up. Lazily mounted files that have
+ * neither been used nor requested are read fresh when first used anyway.
+ */
+static int vfs_file_in_use(const struct vfs_file* f)
+{
+	return !f->lazy || f->requested || f->data != 0;
+}
+
+/**
+ * Read a changed file and notify its callbacks.
+ *
+ * @return	0 if the file was reloaded, -1 if it could not be read or is
+ *			empty (probably still being written) and should be retried.
+ */
+static int vfs_reload_file(struct vfs_file* f)
+{
+	if (!vfs_file_in_use(f))
+	{
+		return 0;
+	}
+
+	struct vfs_read r = { 0 };
+	strcpy(r.path, f->name);
+	r.map = vfs_global->mmap;
+	vfs_read_path(&r);
+
+	if (r.data == 0 || r.size == 0)
+	{
+		vfs_free_contents(r.data, r.size, r.storage);
+		return -1;
+	}
+
+	/* Touched or saved without changes: keep the old contents, which
+	 * callbacks may still point into. */
+	if (r.content_hash == 0)
+	{
+		r.content_hash = hash_xxh64(r.data, r.size, 0);
+	}
+	if (r.content_hash == f->content_hash)
+	{
+		vfs_free_contents(r.data, r.size, r.storage);
+		f->lastChange = r.lastChange;
+		vfs_debug("%s unchanged, skipped reload\n", f->simplename);
+		return 0;
+	}
+
+	vfs_set_contents(f, &r);
+
+	for (int j = 0, j_size = stb_arr_len(f->read_callbacks); j < j_size; j++)
+	{
+		vfs_callback_run(f, j);
+	}
+	f->last_use = ++vfs_global->clock;
+	if (stb_arr_len(f->read_callbacks) > 0)
+	{
+		vfs_file_consumed(f);
+	}
+
+	return 0;
+}
+
+/**
+ * Fallback: stat every file and reload the ones with a new timestamp.
+ */
+static void vfs_filewatch_poll()
+{
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (f->packed != NULL || !vfs_file_in_use(f))
+		{
+			continue;
+		}
+
+		time_t lastChange = stb_ftimestamp(f->name);
+		if (f->lastChange != lastChange)
+		{
+			if (vfs_reload_file(f) != 0)
+			{
+				/* Retry on the next frame. */
+				f->lastChange = 0;
+			}
+		}
+	}
+}
+
+#ifdef VFS_INOTIFY
+static uint64_t vfs_now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Watch the directories of all mounted files that are not yet watched.
+ */
+static void vfs_watch_update()
+{
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+
+		/* Registered but never mounted, or served from a pack. */
+		if ((f->lastChange == 0 && f->data == 0 && !f->lazy) || f->packed != NULL)
+		{
+			continue;
+		}
+
+		/* Mounted files always have a directory in their name. */
+		const char* slash = strrchr(f->name, '/');
+		if (slash == NULL || slash == f->name)
+		{
+			continue;
+		}
+
+		struct vfs_watch w;
+		size_t len = (size_t)(slash - f->name);
+		memcpy(w.dir, f->name, len);
+		w.dir[len] = '\0';
+
+		/* inotify returns the existing descriptor for an already watched directory. */
+		w.wd = inotify_add_watch(vfs_global->watch_fd, w.dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY);
+		if (w.wd < 0)
+		{
+			vfs_error("Could not watch %s\n", w.dir);
+			continue;
+		}
+
+		int known = 0;
+		for (int j = 0, j_size = stb_arr_len(vfs_global->watches); j < j_size; j++)
+		{
+			if (vfs_global->watches[j].wd == w.wd)
+			{
+				known = 1;
+				break;
+			}
+		}
+		if (!known)
+		{
+			stb_arr_push(vfs_global->watches, w);
+		}
+	}
+
+	vfs_global->watch_dirty = 0;
+}
+
+/**
+ * Queue a reload of the file at path. Every new event for the file pushes
+ * the reload back, so a file being written in several chunks is only read
+ * once the writes have stopped.
+ */
+static void vfs_watch_queue(const char* path, uint64_t now)
+{
+	/* Events are rare, so a scan of the table by absolute path is fine. */
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (strcmp(f->name, path) != 0)
+		{
+			continue;
+		}
+		if (f->reload_time == 0)
+		{
+			stb_arr_push(vfs_global->pending, i);
+		}
+		f->reload_time = now + VFS_FILEWATCH_DELAY_MS;
+	}
+}
+
+static void vfs_watch_read_events(uint64_t now)
+{
+	char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
 
-typedef unsigned long DWORD;
+	for (;;)
+	{
+		ssize_t len = read(vfs_global->watch_fd, buf, sizeof(buf));
+		if (len <= 0)
+		{
+			/* EAGAIN: no more events. */
+			break;
+		}
 
-#define STB_DEFINE
-#include <stb/stb.h>
+		for (char* p = buf; p < buf + len; )
+		{
+			struct inotify_event* ev = (struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + ev->len;
 
-#define vfs_error(...) errorf("VFS", __VA_ARGS__)
+			if (ev->len == 0)
+			{
+				continue;
+			}
 
-void vfs_init(const char *mount_path)
+			for (int j = 0, j_size = stb_arr_len(vfs_global->watches); j < j_size; j++)
+			{
+				if (vfs_global->watches[j].wd == ev->wd)
+				{
+					char path[MAX_FILENAME_LEN * 2];
+					snprintf(path, sizeof(path), "%s/%s", vfs_global->watches[j].dir, ev->name);
+					vfs_watch_queue(path, now);
+					break;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Reload the queued files that have been quiet for long enough.
+ */
+static void vfs_watch_reload_pending(uint64_t now)
 {
-	for (int i = 0; i < MAX_NUM_FILES; i++)
+	for (int i = 0; i < stb_arr_len(vfs_global->pending); )
 	{
-		vfs_global->file_table[i].name[0] = '\0';
-		vfs_global->file_table[i].size = 0;
-		vfs_global->file_table[i].data = 0;
-		vfs_global->file_table[i].read_callbacks = 0;
-	}
+		struct vfs_file* f = vfs_global->file_table[vfs_global->pending[i]];
+		if (now < f->reload_time)
+		{
+			i++;
+			continue;
+		}
 
-	if (mount_path != NULL) {
-		vfs_mount(mount_path);
+		if (vfs_reload_file(f) != 0)
+		{
+			f->reload_time = now + VFS_FILEWATCH_DELAY_MS;
+			i++;
+			continue;
+		}
+
+		f->reload_time = 0;
+		stb_arr_fastdelete(vfs_global->pending, i);
 	}
 }
+#endif
 
-void vfs_shutdown()
+void vfs_filewatch()
 {
-	for (int i = 0; i < MAX_NUM_FILES; i++)
+#ifdef VFS_INOTIFY
+	if (vfs_global->watch_fd >= 0)
 	{
-		stb_fclose(vfs_global->file_table[i].file, 0);
-		if (vfs_global->file_table[i].data != NULL) {
-			free(vfs_global->file_table[i].data);
+		uint64_t now = vfs_now_ms();
+		if (vfs_global->watch_dirty)
+		{
+			vfs_watch_update();
 		}
+		vfs_watch_read_events(now);
+		vfs_watch_reload_pending(now);
+		return;
 	}
+#endif
+
+	vfs_filewatch_poll();
 }
+#endif
 
-void vfs_register_callback(const char* filename, read_callback_t fn, void* userdata)
+/**
+ * If vfs_run_callbacks() should run the callbacks of a file. Lazily mounted
+ * files are left until they are requested, and files already requested have
+ * run their callbacks.
+ */
+static int vfs_file_wants_callbacks(const struct vfs_file* f)
 {
-	int added = 0;
+	return stb_arr_len(f->read_callbacks) > 0 && !f->lazy && !f->requested;
+}
 
-	struct read_callback cbck;
-	cbck.fn = fn;
-	cbck.userdata = userdata;
+struct vfs_decode_job
+{
+	struct job job;
+	struct vfs_file* f;
+	struct read_callback cbck;	/* A copy: callbacks run meanwhile may grow f->read_callbacks. */
+	void* decoded;
+};
+
+static void vfs_decode_job_run(void* arg)
+{
+	struct vfs_decode_job* dj = (struct vfs_decode_job*)arg;
+	dj->decoded = dj->cbck.decode(dj->f->simplename, dj->f->size, dj->f->data, dj->cbck.userdata);
+}
 
+/**
+ * Run the callbacks of every file. Loaders are decoded on worker threads while
+ * the main thread runs the single stage callbacks, then uploaded in the order
+ * they finish decoding, so uploads overlap with the remaining decodes.
+ *
+ * NOTE: The decode stages read the file contents concurrently, so callbacks
+ * must not modify the vfs until vfs_run_callbacks() returns.
+ */
+void vfs_run_callbacks()
+{
+	int loaders_count = 0;
 	for (int i = 0; i < vfs_global->file_count; i++)
 	{
-		if (strcmp(filename, vfs_global->file_table[i].simplename) == 0)
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (!vfs_file_wants_callbacks(f))
+		{
+			continue;
+		}
+
+		/* Read, decompress and hash on the main thread, the vfs is not thread
+		 * safe. */
+		vfs_file_data(f);
+		vfs_file_hash(f);
+
+		int j_size = stb_arr_len(f->read_callbacks);
+		for (int j = 0; j < j_size; j++)
 		{
-			stb_arr_push(vfs_global->file_table[i].read_callbacks, cbck);
-			added = 1;
+			if (f->read_callbacks[j].fn == NULL)
+			{
+				loaders_count++;
+			}
 		}
 	}
 
-	if (!added)
+	struct job_pool pool;
+	struct vfs_decode_job* jobs = NULL;
+	if (loaders_count > 0)
 	{
-		vfs_global->file_table[vfs_global->file_count].data = 0;
-		vfs_global->file_table[vfs_global->file_count].file = 0;
-		vfs_global->file_table[vfs_global->file_count].lastChange = 0;
-		strcpy(vfs_global->file_table[vfs_global->file_count].name, filename);
-		strcpy(vfs_global->file_table[vfs_global->file_count].simplename, filename);
-		vfs_global->file_table[vfs_global->file_count].size = 0;
-		stb_arr_push(vfs_global->file_table[vfs_global->file_count].read_callbacks, cbck);
-		vfs_global->file_count++;
+		jobs = (struct vfs_decode_job*)engine_calloc(MEM_VFS, loaders_count, sizeof(struct vfs_decode_job));
+		if (jobs == NULL)
+		{
+			vfs_error("Out of memory, decoding on the main thread\n");
+		}
 	}
-}
 
-void vfs_register_callback_filter(const char* filter, read_callback_t fn, void* userdata)
-{
-	for (int i = 0; i < vfs_global->file_count; i++)
+	/* Stage 1: decode loaders on the workers. */
+	if (jobs != NULL)
 	{
-		if (strstr(vfs_global->file_table[i].name, filter) != 0)
+		job_pool_init(&pool, JOB_POOL_THREADS_DEFAULT);
+
+		int k = 0;
+		for (int i = 0; i < vfs_global->file_count; i++)
 		{
-			struct read_callback cbck;
-			cbck.fn = fn;
-			cbck.userdata = userdata;
-			stb_arr_push(vfs_global->file_table[i].read_callbacks, cbck);
+			struct vfs_file* f = vfs_global->file_table[i];
+			if (!vfs_file_wants_callbacks(f))
+			{
+				continue;
+			}
+			for (int j = 0, j_size = stb_arr_len(f->read_callbacks); j < j_size; j++)
+			{
+				if (f->read_callbacks[j].fn != NULL)
+				{
+					continue;
+				}
+				struct vfs_decode_job* dj = &jobs[k++];
+				dj->job.fn = &vfs_decode_job_run;
+				dj->job.arg = dj;
+				dj->f = f;
+				dj->cbck = f->read_callbacks[j];
+				job_pool_submit(&pool, &dj->job);
+			}
 		}
 	}
-}
 
-#ifdef VFS_ENABLE_FILEWATCH
-void vfs_filewatch()
-{
+	/* Meanwhile: single stage callbacks (and loaders, if the jobs could not
+	 * be allocated) on the main thread. */
 	for (int i = 0; i < vfs_global->file_count; i++)
 	{
-		time_t lastChange = stb_ftimestamp(vfs_global->file_table[i].name);
-		if (vfs_global->file_table[i].lastChange != lastChange)
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (!vfs_file_wants_callbacks(f))
+		{
+			continue;
+		}
+		for (int j = 0, j_size = stb_arr_len(f->read_callbacks); j < j_size; j++)
 		{
-			vfs_global->file_table[i].file = stb_fopen(vfs_global->file_table[i].name, "rb");
+			if (f->read_callbacks[j].fn != NULL || jobs == NULL)
+			{
+				vfs_callback_run(f, j);
+			}
+		}
+	}
 
-			if (vfs_global->file_table[i].file == 0)
+	/* Stage 2: upload loaders as they finish decoding. */
+	if (jobs != NULL)
+	{
+		struct job* job;
+		while ((job = job_pool_wait(&pool)) != NULL)
+		{
+			struct vfs_decode_job* dj = (struct vfs_decode_job*)job->arg;
+			if (dj->decoded != NULL)
 			{
-				continue;
+				dj->cbck.upload(dj->f->simplename, dj->f->size, dj->decoded, dj->cbck.userdata);
 			}
+		}
+		job_pool_free(&pool);
+		engine_free(jobs);
+	}
 
-			fseek(vfs_global->file_table[i].file, 0, SEEK_SET);
+	for (int i = 0; i < vfs_global->file_count; i++)
+	{
+		struct vfs_file* f = vfs_global->file_table[i];
+		if (vfs_file_wants_callbacks(f))
+		{
+			f->requested = 1;
+			vfs_file_consumed(f);
+		}
+	}
 
-			free(vfs_global->file_table[i].data);
-			vfs_global->file_table[i].lastChange = lastChange;
+	vfs_enforce_budget();
+}
 
-			// Hacky solution to make sure the OS is finished with the fseek call
-			// How can this be solved better?
-			vfs_global->file_table[i].size = 0;
-			while (vfs_global->file_table[i].size == 0)
-			{
-				vfs_global->file_table[i].size = stb_filelen(vfs_global->file_table[i].file);
-			}
+/**
+ * Load a file and run its callbacks, unless they have already run.
+ *
+ * @param consume	Release the contents once the callbacks have run (see
+ *					vfs_file_consumed()).
+ * @return			0 if the file has been loaded, -1 if it could not be read.
+ */
+static int vfs_file_request(struct vfs_file* f, int consume)
+{
+	if (f->requested)
+	{
+		return 0;
+	}
 
-			vfs_global->file_table[i].data = malloc(vfs_global->file_table[i].size);
-			fread(vfs_global->file_table[i].data, 1, vfs_global->file_table[i].size, vfs_global->file_table[i].file);
-			stb_fclose(vfs_global->file_table[i].file, 0);
+	if (vfs_file_data(f) == 0)
+	{
+		return -1;
+	}
 
-			for (int j = 0, j_size = stb_arr_len(vfs_global->file_table[i].read_callbacks); j < j_size; j++)
-			{
-				read_callback_t cbck = vfs_global->file_table[i].read_callbacks[j].fn;
-				cbck(vfs_global->file_table[i].simplename, vfs_global->file_table[i].size, vfs_global->file_table[i].data, vfs_global->file_table[i].read_callbacks[j].userdata);
-			}
+	f->requested = 1;
+	for (int j = 0; j < stb_arr_len(f->read_callbacks); j++)
+	{
+		vfs_callback_run(f, j);
+	}
+	if (consume && stb_arr_len(f->read_callbacks) > 0)
+	{
+		vfs_file_consumed(f);
+	}
+
+	return 0;
+}
+
+/**
+ * Load a file and run its callbacks, unless they have already run. In lazy
+ * mode (see vfs_set_lazy()) this is how assets are loaded; otherwise all
+ * callbacks run in vfs_run_callbacks(), or here if the file is requested
+ * before that.
+ *
+ * @return	0 if the file has been loaded, -1 if it does not exist or could
+ *			not be read.
+ */
+int vfs_request(const char* filename)
+{
+	int i = vfs_find(filename, vfs_hash(filename));
+	if (i < 0)
+	{
+		return -1;
+	}
+
+	return vfs_file_request(vfs_global->file_table[i], 1);
+}
+
+/**
+ * Add a file found in a mounted directory to the table, or point the existing
+ * file with the same simplename at it.
+ *
+ * @param path		Path of the file, starting with the mounted directory.
+ * @param dir_len	Length of the mounted directory.
+ * @return			The file, or NULL if out of memory.
+ */
+static struct vfs_file* vfs_mount_file(const char* path, size_t dir_len)
+{
+	const char* simplename = path + dir_len + 1;
+	uint32_t hash = vfs_hash(simplename);
+
+	int i = vfs_find(simplename, hash);
+	if (i >= 0)
+	{
+		/* Replace the contents of an existing file. */
+		struct vfs_file* f = vfs_global->file_table[i];
+		strcpy(f->name, path);
+		return f;
+	}
+
+	return vfs_add_file(path, simplename, hash);
+}
+
+/**
+ * Paths found by the directory walker, waiting to be read. Bounded, so the
+ * walker can not run arbitrarily far ahead of the readers.
+ */
+struct vfs_mount_queue
+{
+	struct thread_mutex lock;
+	struct thread_cond changed;		/* Signalled on push, pop and when done. */
+	char (*paths)[MAX_FILENAME_LEN];	/* Ring buffer of VFS_MOUNT_QUEUE_SIZE paths. */
+	int head;
+	int count;
+	int done;						/* The walker has finished. */
+	char dir[MAX_FILENAME_LEN];
+};
+
+static void vfs_mount_queue_push(struct vfs_mount_queue* q, const char* path)
+{
+	thread_mutex_lock(&q->lock);
+	while (q->count == VFS_MOUNT_QUEUE_SIZE)
+	{
+		thread_cond_wait(&q->changed, &q->lock);
+	}
+	strcpy(q->paths[(q->head + q->count) % VFS_MOUNT_QUEUE_SIZE], path);
+	q->count++;
+	thread_cond_broadcast(&q->changed);
+	thread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Take the next path off the queue.
+ *
+ * @param block	Wait for the walker if the queue is empty.
+ * @return		1 if a path was copied to path, 0 if the queue is empty.
+ */
+static int vfs_mount_queue_pop(struct vfs_mount_queue* q, char* path, int block)
+{
+	thread_mutex_lock(&q->lock);
+	while (block && q->count == 0 && !q->done)
+	{
+		thread_cond_wait(&q->changed, &q->lock);
+	}
+	int popped = (q->count > 0);
+	if (popped)
+	{
+		strcpy(path, q->paths[q->head]);
+		q->head = (q->head + 1) % VFS_MOUNT_QUEUE_SIZE;
+		q->count--;
+		thread_cond_broadcast(&q->changed);
+	}
+	thread_mutex_unlock(&q->lock);
+	return popped;
+}
+
+static void vfs_mount_walk(struct vfs_mount_queue* q, char* dir)
+{
+	char** files = stb_readdir_files(dir);
+	for (int i = 0, i_size = stb_arr_len(files); i < i_size; i++)
+	{
+		if (strlen(files[i]) >= MAX_FILENAME_LEN)
+		{
+			vfs_error("Path too long: %s\n", files[i]);
+			continue;
 		}
+		vfs_mount_queue_push(q, files[i]);
+	}
+	if (files != NULL)
+	{
+		stb_readdir_free(files);
+	}
+
+	char** subdirs = stb_readdir_subdirs(dir);
+	for (int i = 0, i_size = stb_arr_len(subdirs); i < i_size; i++)
+	{
+		vfs_mount_walk(q, subdirs[i]);
+	}
+	if (subdirs != NULL)
+	{
+		stb_readdir_free(subdirs);
 	}
 }
-#endif
 
-void vfs_run_callbacks()
+static void vfs_mount_walker_run(void* arg)
 {
-	for (int i = 0; i < vfs_global->file_count; i++)
+	struct vfs_mount_queue* q = (struct vfs_mount_queue*)arg;
+
+	vfs_mount_walk(q, q->dir);
+
+	thread_mutex_lock(&q->lock);
+	q->done = 1;
+	thread_cond_broadcast(&q->changed);
+	thread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Mount a directory with one thread walking the tree and the job pool reading
+ * the files, at most VFS_MOUNT_READS_MAX at a time. Files are added to the
+ * table on the main thread in the order they are found (so the table is
+ * ordered as with a serial mount), and get their contents as their reads
+ * finish.
+ *
+ * @return	The number of files found, or -1 if the walker thread could not
+ *			be started.
+ */
+static int vfs_mount_parallel(const char* dir)
+{
+	struct vfs_mount_queue q = { 0 };
+	strncpy(q.dir, dir, MAX_FILENAME_LEN - 1);
+	q.paths = engine_calloc(MEM_VFS, VFS_MOUNT_QUEUE_SIZE, sizeof(*q.paths));
+	struct vfs_read* reads = (struct vfs_read*)engine_calloc(MEM_VFS, VFS_MOUNT_READS_MAX, sizeof(struct vfs_read));
+	if (q.paths == NULL || reads == NULL)
 	{
-		for (int j = 0, j_size = stb_arr_len(vfs_global->file_table[i].read_callbacks); j < j_size; j++)
+		engine_free(q.paths);
+		engine_free(reads);
+		return -1;
+	}
+
+	thread_mutex_init(&q.lock);
+	thread_cond_init(&q.changed);
+
+	struct thread walker;
+	if (thread_create(&walker, &vfs_mount_walker_run, &q) != THREAD_OK)
+	{
+		thread_cond_free(&q.changed);
+		thread_mutex_free(&q.lock);
+		engine_free(q.paths);
+		engine_free(reads);
+		return -1;
+	}
+
+	struct job_pool pool;
+	job_pool_init(&pool, JOB_POOL_THREADS_DEFAULT);
+
+	/* Unused entries of reads. */
+	struct vfs_read* idle[VFS_MOUNT_READS_MAX];
+	for (int i = 0; i < VFS_MOUNT_READS_MAX; i++)
+	{
+		idle[i] = &reads[i];
+	}
+	int idle_count = VFS_MOUNT_READS_MAX;
+
+	size_t dir_len = strlen(dir);
+	int found = 0;
+	char path[MAX_FILENAME_LEN];
+	for (;;)
+	{
+		/* Keep the readers busy. Only wait for the walker when there are no
+		 * reads to pick up. */
+		while (idle_count > 0 && vfs_mount_queue_pop(&q, path, idle_count == VFS_MOUNT_READS_MAX))
+		{
+			found++;
+			struct vfs_file* f = vfs_mount_file(path, dir_len);
+			if (f == NULL)
+			{
+				continue;
+			}
+			f->lazy = 0;
+
+			struct vfs_read* r = idle[--idle_count];
+			memset(r, 0, sizeof(struct vfs_read));
+			r->job.fn = &vfs_read_job_run;
+			r->job.arg = r;
+			r->f = f;
+			strcpy(r->path, path);
+			r->map = vfs_global->mmap;
+			job_pool_submit(&pool, &r->job);
+		}
+
+		if (idle_count == VFS_MOUNT_READS_MAX)
 		{
-			read_callback_t cbck = vfs_global->file_table[i].read_callbacks[j].fn;
-			cbck(vfs_global->file_table[i].simplename, vfs_global->file_table[i].size, vfs_global->file_table[i].data, vfs_global->file_table[i].read_callbacks[j].userdata);
+			/* The walker is done and all reads are picked up. */
+			break;
 		}
+
+		struct vfs_read* r = (struct vfs_read*)job_pool_wait(&pool)->arg;
+		vfs_set_contents(r->f, r);
+		idle[idle_count++] = r;
 	}
+
+	thread_join(&walker);
+	job_pool_free(&pool);
+	thread_cond_free(&q.changed);
+	thread_mutex_free(&q.lock);
+	engine_free(q.paths);
+	engine_free(reads);
+
+	return found;
 }
 
+/**
+ * Mount all files in dir (recursively). Files already mounted with the same
+ * name are replaced.
+ */
 void vfs_mount(const char* dir)
 {
 	if (dir == NULL)
@@ -152,6 +1608,21 @@ void vfs_mount(const char* dir)
 		return;
 	}
 
+	/* Lazy mounts only index the files, no need for readers. */
+	if (!vfs_global->lazy)
+	{
+		int found = vfs_mount_parallel(dir);
+		if (found == 0)
+		{
+			vfs_error("Could not read directory: %s\n", dir);
+		}
+		if (found >= 0)
+		{
+			vfs_global->watch_dirty = 1;
+			return;
+		}
+	}
+
 	char** filenames = stb_readdir_recursive(dir, NULL);
 
 	if (filenames == NULL)
@@ -161,72 +1632,174 @@ void vfs_mount(const char* dir)
 	}
 
 	int num_new_files = stb_arr_len(filenames);
+	size_t dir_len = strlen(dir);
 	for (int i = 0; i < num_new_files; i++)
 	{
-		struct vfs_file new_file;
-		strcpy(new_file.name, filenames[i]);
-		strcpy(new_file.simplename, filenames[i] + strlen(dir) + 1);
+		struct vfs_file* f = vfs_mount_file(filenames[i], dir_len);
+		if (f == NULL)
+		{
+			break;
+		}
+
+		f->lazy = vfs_global->lazy;
+		if (f->lazy)
+		{
+			/* Read on first use. */
+			vfs_release_data(f);
+			f->packed = NULL;
+			f->size = 0;
+			f->lastChange = 0;
+		}
+		else
+		{
+			vfs_read_file(f);
+		}
+	}
+
+	stb_readdir_free(filenames);
+	vfs_global->watch_dirty = 1;
+}
+
+/**
+ * Mount a pack written by generate_assets. The pack is mapped (or read) once
+ * and stays in memory until vfs_shutdown(); files in it are not copied, their
+ * data points straight into the pack. Compressed files are decompressed on
+ * first use by vfs_get_file() or vfs_run_callbacks(). Files already mounted
+ * with the same name are replaced, and directories mounted afterwards replace
+ * files in the pack, so a development directory can be overlaid on a shipped
+ * pack.
+ *
+ * @param path	Path to the pack.
+ * @return		0 on success, -1 if the pack could not be read or is invalid.
+ */
+int vfs_mount_pack(const char* path)
+{
+	if (path == NULL)
+	{
+		vfs_error("Invalid mount argument\n");
+		return -1;
+	}
+
+	struct vfs_pack pack;
+	if (vfs_pack_load(path, &pack) != 0)
+	{
+		return -1;
+	}
+
+	if (vfs_pack_validate(path, &pack) != 0)
+	{
+		vfs_pack_unload(&pack);
+		return -1;
+	}
+
+	stb_arr_push(vfs_global->packs, pack);
+
+	const struct pack_header* header = (const struct pack_header*)pack.base;
+	const struct pack_entry* entries = (const struct pack_entry*)(header + 1);
+	const char* names = (const char*)(entries + header->count);
+
+	for (uint32_t i = 0; i < header->count; i++)
+	{
+		const struct pack_entry* e = &entries[i];
+		const char* simplename = names + e->name;
+
+		char name[MAX_FILENAME_LEN];
+		snprintf(name, sizeof(name), "%s/%s", path, simplename);
 
-		int replaced = 0;
-		for (int j = 0; j < vfs_global->file_count; j++)
+		struct vfs_file* f = NULL;
+		int j = vfs_find(simplename, e->hash);
+
+		if (j >= 0)
+		{
+			f = vfs_global->file_table[j];
+			vfs_release_data(f);
+			strcpy(f->name, name);
+		}
+		else
 		{
-			if (strcmp(vfs_global->file_table[j].simplename, new_file.simplename) == 0)
+			f = vfs_add_file(name, simplename, e->hash);
+			if (f == NULL)
 			{
-				stb_fclose(vfs_global->file_table[j].file, 0);
-				free(vfs_global->file_table[j].data);
-
-				strcpy(vfs_global->file_table[j].name, new_file.name);
-				vfs_global->file_table[j].file = stb_fopen(vfs_global->file_table[j].name, "rb");
-				vfs_global->file_table[j].lastChange = stb_ftimestamp(vfs_global->file_table[j].name);
-				vfs_global->file_table[j].size = stb_filelen(vfs_global->file_table[j].file);
-				vfs_global->file_table[j].data = malloc(vfs_global->file_table[j].size);
-				fread(vfs_global->file_table[j].data, 1, vfs_global->file_table[j].size, vfs_global->file_table[j].file);
-				stb_fclose(vfs_global->file_table[i].file, 0);
-
-				replaced = 1;
 				break;
 			}
 		}
 
-		if (!replaced)
-		{
-			new_file.read_callbacks = 0;
-			new_file.file = stb_fopen(new_file.name, "rb");
-			new_file.lastChange = stb_ftimestamp(new_file.name);
-			new_file.size = stb_filelen(new_file.file);
-			new_file.data = malloc(new_file.size);
-			fread(new_file.data, 1, new_file.size, new_file.file);
-			stb_fclose(new_file.file, 0);
-
-			vfs_global->file_table[vfs_global->file_count] = new_file;
-			vfs_global->file_count++;
-		}
+		f->packed = (char*)pack.base + e->offset;
+		f->packed_size = (size_t)e->size;
+		f->pack_flags = e->flags;
+		f->size = (size_t)e->raw_size;
+		f->content_hash = e->content_hash;
+		f->lastChange = 0;
 	}
+
+	return 0;
 }
 
 void* vfs_get_file(const char* filename, size_t* out_num_bytes)
 {
-	for (int i = 0; i < vfs_global->file_count; i++)
+	return vfs_get_file_hashed(filename, vfs_hash(filename), out_num_bytes);
+}
+
+void* vfs_get_file_hashed(const char* filename, uint32_t hash, size_t* out_num_bytes)
+{
+	int i = vfs_find(filename, hash);
+	if (i < 0)
 	{
-		if (strcmp(filename, vfs_global->file_table[i].simplename) == 0 && vfs_global->file_table[i].data != 0)
-		{
-			*out_num_bytes = vfs_global->file_table[i].size;
-			return vfs_global->file_table[i].data;
-		}
+		return 0;
+	}
+
+	struct vfs_file* f = vfs_global->file_table[i];
+
+	/* In lazy mode, the first use of a file requests it. The contents are
+	 * kept, the caller is about to use them. */
+	if (f->lazy && !f->requested)
+	{
+		vfs_file_request(f, 0);
+	}
+
+	if (vfs_file_data(f) != 0)
+	{
+		*out_num_bytes = f->size;
+		return f->data;
 	}
 
 	return 0;
 }
 
+/**
+ * Get the content hash (hash_xxh64() with seed 0) of a file, for loaders that
+ * cache their results. Reads the file if needed. Files are hashed before
+ * their callbacks run, so this is safe to call from decode stages.
+ *
+ * @return	The hash, or 0 if the file does not exist or could not be read.
+ */
+uint64_t vfs_get_content_hash(const char* filename)
+{
+	int i = vfs_find(filename, vfs_hash(filename));
+	if (i < 0)
+	{
+		return 0;
+	}
+
+	struct vfs_file* f = vfs_global->file_table[i];
+	if (f->content_hash == 0 && vfs_file_data(f) != 0)
+	{
+		vfs_file_hash(f);
+	}
+	return f->content_hash;
+}
+
+/**
+ * Release the contents of a file. Files from a pack can still be read again,
+ * they are decompressed (or pointed into the pack) on the next use.
+ */
 void vfs_free_memory(const char* filename)
 {
-	for (int i = 0; i < vfs_global->file_count; i++)
+	int i = vfs_find(filename, vfs_hash(filename));
+
+	if (i >= 0)
 	{
-		if (strcmp(filename, vfs_global->file_table[i].simplename) == 0)
-		{
-			free(vfs_global->file_table[i].data);
-			vfs_global->file_table[i].data = 0;
-		}
+		vfs_release_data(vfs_global->file_table[i]);
 	}
 }
 
@@ -237,17 +1810,21 @@ int vfs_file_count()
 
 const char* vfs_get_simple_name(const int index)
 {
-	return vfs_global->file_table[index].simplename;
+	return vfs_global->file_table[index]->simplename;
 }
 
+/**
+ * @return	The path of a file on disk, or NULL if it is not loaded or only
+ *			exists in a mounted pack (its name is not a real path then).
+ */
 const char* vfs_get_absolute_path(const char* filename)
 {
-	for (int i = 0; i < vfs_global->file_count; i++)
+	int i = vfs_find(filename, vfs_hash(filename));
+
+	if (i >= 0 && vfs_global->file_table[i]->packed == NULL
+		&& (vfs_global->file_table[i]->data != 0 || vfs_global->file_table[i]->lazy))
 	{
-		if (strcmp(filename, vfs_global->file_table[i].simplename) == 0 && vfs_global->file_table[i].data != 0)
-		{
-			return vfs_global->file_table[i].name;
-		}
+		return vfs_global->file_table[i]->name;
 	}
 
 	return 0;
@@ -3,17 +3,33 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <time.h>
 
 #define MAX_FILENAME_LEN 256
-#define MAX_NUM_FILES 256
+
+#define VFS_STORAGE_HEAP	0	/* data was read into memory owned by the file. */
+#define VFS_STORAGE_MAPPED	1	/* data is a read-only mapping of the file. */
+#define VFS_STORAGE_PACK	2	/* data points into a mounted pack. */
 
 typedef void(*read_callback_t)(const char* filename, unsigned int size, void* data, void* userdata);
 
+/**
+ * Two-stage loaders. The decode stage runs on a worker thread during
+ * vfs_run_callbacks() and must not touch GL, AL or the vfs; it returns the
+ * decoded asset, or NULL on failure. The upload stage then runs on the main
+ * thread with the decoded asset and takes ownership of it.
+ */
+typedef void*(*decode_callback_t)(const char* filename, unsigned int size, const void* data, void* userdata);
+typedef void(*upload_callback_t)(const char* filename, unsigned int size, void* decoded, void* userdata);
+
 struct read_callback
 {
-	read_callback_t fn;
+	read_callback_t fn;			/* Single stage callback, or NULL for a loader. */
+	decode_callback_t decode;
+	upload_callback_t upload;
 	void* userdata;
+	int keep;					/* Called vfs_keep_contents() when it last ran. */
 };
 
 struct vfs_file
@@ -25,12 +41,49 @@ struct vfs_file
 	struct read_callback* read_callbacks;
 	size_t size;
 	void* data;
+	uint32_t hash;
+	uint64_t reload_time;	/* When a queued reload is due (ms), 0 if not queued. */
+	int storage;			/* Where data lives (VFS_STORAGE_*). */
+	const void* packed;		/* Contents in a mounted pack, NULL if not from a pack. */
+	size_t packed_size;		/* Size of packed as stored. */
+	uint32_t pack_flags;	/* PACK_ENTRY_* of packed. */
+	int lazy;				/* Mounted lazily: read from disk on first use. */
+	int requested;			/* The callbacks have run. */
+	int resident;			/* Pinned: never released by the vfs. */
+	uint64_t last_use;		/* vfs clock when the contents were last used. */
+	uint64_t content_hash;	/* hash_xxh64() of the contents, 0 if not known yet. */
+};
+
+struct vfs_watch
+{
+	int wd;					/* inotify watch descriptor. */
+	char dir[MAX_FILENAME_LEN];
+};
+
+struct vfs_pack
+{
+	void* base;				/* Contents of the pack. */
+	size_t size;
+	int mapped;				/* If base is a read-only mapping of the pack. */
 };
 
 struct vfs
 {
-	struct vfs_file	file_table[MAX_NUM_FILES];
+	struct vfs_file	**file_table;		/* All files, in the order they were added. */
 	int				file_count;
+	int				file_table_size;	/* Number of entries allocated in file_table. */
+	int				*index;				/* Hash index of file_table by simplename (index + 1, 0 if empty). */
+	int				index_size;			/* Number of slots in index (power of two). */
+	int				watch_fd;			/* inotify instance, or -1 to poll file timestamps. */
+	int				watch_dirty;		/* Set when files were mounted since the watches were updated. */
+	struct vfs_watch*	watches;		/* Watched directories (stb_arr). */
+	int*			pending;			/* Files with a queued reload (stb_arr of file_table indices). */
+	int				mmap;				/* Map files instead of reading them into memory. */
+	struct vfs_pack*	packs;			/* Mounted packs (stb_arr). */
+	int				lazy;				/* Index files on mount, read them on first use. */
+	size_t			budget;				/* Bytes of contents to keep loaded, 0 for no limit. */
+	uint64_t		clock;				/* Incremented on every use of the contents of a file. */
+	int				keep;				/* Set by vfs_keep_contents() in the running callback. */
 };
 
 struct vfs* vfs_global;
@@ -38,8 +91,20 @@ struct vfs* vfs_global;
 void	vfs_init(const char *mount_path);
 void	vfs_shutdown();
 void	vfs_mount(const char* dir);
+int		vfs_mount_pack(const char* path);
+void	vfs_set_mmap(int enabled);
+void	vfs_set_lazy(int enabled);
+void	vfs_set_budget(size_t bytes);
+void	vfs_enforce_budget();
+void	vfs_set_resident(const char* filename, int resident);
+void	vfs_keep_contents();
+int		vfs_request(const char* filename);
+size_t	vfs_loaded_bytes();
 void	vfs_register_callback(const char* filename, read_callback_t fn, void* userdata);
+void	vfs_register_callback_hashed(const char* filename, uint32_t hash, read_callback_t fn, void* userdata);
 void	vfs_register_callback_filter(const char* filter, read_callback_t fn, void* userdata);
+void	vfs_register_loader(const char* filename, decode_callback_t decode, upload_callback_t upload, void* userdata);
+void	vfs_register_loader_hashed(const char* filename, uint32_t hash, decode_callback_t decode, upload_callback_t upload, void* userdata);
 void	vfs_run_callbacks();
 #ifdef VFS_ENABLE_FILEWATCH
 void	vfs_filewatch();
@@ -47,7 +112,10 @@ void	vfs_filewatch();
 #define vfs_filewatch(...)
 #endif
 
+uint32_t	vfs_hash(const char* filename);
 void*	vfs_get_file(const char* filename, size_t* out_num_bytes);
+void*	vfs_get_file_hashed(const char* filename, uint32_t hash, size_t* out_num_bytes);
+uint64_t	vfs_get_content_hash(const char* filename);
 void	vfs_free_memory(const char* filename);
 
 int			vfs_file_count();
@@ -0,0 +1,137 @@
+/**
+ * Virtual memory backed linear allocator.
+ *
+ * Address space is reserved with mmap(PROT_NONE) (VirtualAlloc(MEM_RESERVE)
+ * on Windows) and made accessible with mprotect() (VirtualAlloc(MEM_COMMIT))
+ * in steps of VMEM_COMMIT_SIZE as allocations need it. Emscripten has no
+ * virtual memory, so there the whole range is allocated up front.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(EMSCRIPTEN)
+#include <sys/mman.h>
+#endif
+
+#include "vmem.h"
+
+static uintptr_t vmem_align_up(uintptr_t n, size_t align)
+{
+	return (n + align - 1) & ~((uintptr_t) align - 1);
+}
+
+static void* vmem_reserve(size_t size)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#elif defined(EMSCRIPTEN)
+	return calloc(1, size);
+#else
+	void *p = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return (p == MAP_FAILED) ? NULL : p;
+#endif
+}
+
+static int vmem_commit(void *p, size_t size)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != NULL ? VMEM_OK : VMEM_ERROR;
+#elif defined(EMSCRIPTEN)
+	return VMEM_OK;
+#else
+	return mprotect(p, size, PROT_READ | PROT_WRITE) == 0 ? VMEM_OK : VMEM_ERROR;
+#endif
+}
+
+static void vmem_release(void *p, size_t size)
+{
+#if defined(_WIN32)
+	VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(EMSCRIPTEN)
+	free(p);
+#else
+	munmap(p, size);
+#endif
+}
+
+/**
+ * Reserve address space. No memory is committed until the first call to
+ * vmem_alloc().
+ *
+ * @param vm		The allocator to initialize.
+ * @param reserve	The number of bytes to reserve. Rounded up to a multiple of
+ *					VMEM_COMMIT_SIZE.
+ * @return			VMEM_OK on success, VMEM_ERROR if the address space could
+ *					not be reserved.
+ */
+int vmem_init(struct vmem *vm, size_t reserve)
+{
+	memset(vm, 0, sizeof(struct vmem));
+
+	reserve = vmem_align_up(reserve, VMEM_COMMIT_SIZE);
+	if(reserve == 0) {
+		vmem_error("Nothing to reserve\n");
+		return VMEM_ERROR;
+	}
+
+	vm->base = (char *) vmem_reserve(reserve);
+	if(vm->base == NULL) {
+		vmem_error("Could not reserve %lu bytes\n", (unsigned long) reserve);
+		return VMEM_ERROR;
+	}
+	vm->reserved = reserve;
+
+	return VMEM_OK;
+}
+
+/**
+ * Release the reserved range. All allocations are invalidated.
+ */
+void vmem_free(struct vmem *vm)
+{
+	if(vm->base != NULL) {
+		vmem_release(vm->base, vm->reserved);
+	}
+	memset(vm, 0, sizeof(struct vmem));
+}
+
+/**
+ * Allocate zeroed memory, committing more of the reserved range if needed.
+ *
+ * @param size	The number of bytes to allocate.
+ * @param align	Alignment of the returned pointer. Must be a power of two.
+ * @return		A pointer to the memory, or NULL if the reserved range is
+ *				exhausted or could not be committed.
+ */
+void* vmem_alloc(struct vmem *vm, size_t size, size_t align)
+{
+	uintptr_t start = vmem_align_up((uintptr_t) vm->base + vm->used, align);
+	size_t offset = start - (uintptr_t) vm->base;
+
+	if(offset > vm->reserved || size > vm->reserved - offset) {
+		vmem_error("Out of reserved memory (%lu of %lu bytes used, %lu requested)\n",
+				(unsigned long) vm->used, (unsigned long) vm->reserved,
+				(unsigned long) size);
+		return NULL;
+	}
+
+	size_t end = offset + size;
+	if(end > vm->committed) {
+		size_t commit_end = vmem_align_up(end, VMEM_COMMIT_SIZE);
+		if(commit_end > vm->reserved) {
+			commit_end = vm->reserved;
+		}
+		if(vmem_commit(vm->base + vm->committed, commit_end - vm->committed) != VMEM_OK) {
+			vmem_error("Could not commit %lu bytes\n",
+					(unsigned long) (commit_end - vm->committed));
+			return NULL;
+		}
+		vm->committed = commit_end;
+	}
+
+	vm->used = end;
+	return (void *) start;
+}
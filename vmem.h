@@ -0,0 +1,40 @@
+/**
+ * Virtual memory backed linear allocator.
+ */
+
+#ifndef _VMEM_H
+#define _VMEM_H
+
+#include <stdlib.h>
+
+#include "log.h"
+
+#define vmem_debug(...) debugf("VMem", __VA_ARGS__)
+#define vmem_error(...) errorf("VMem", __VA_ARGS__)
+
+#define VMEM_OK		0
+#define VMEM_ERROR	-1
+
+/* Pages are committed at least this many bytes at a time. */
+#define VMEM_COMMIT_SIZE	(64 * 1024)
+
+/**
+ * A range of address space is reserved up front, but only committed (backed
+ * by physical memory) as allocations reach into it. The base address never
+ * changes, so pointers into the range stay valid for its lifetime, and the
+ * resident size matches what is actually used rather than what is reserved.
+ *
+ * Memory is never handed out twice, so allocations are always zeroed.
+ */
+struct vmem {
+	char	*base;		/* Start of the reserved range. */
+	size_t	reserved;	/* Size of the reserved range. */
+	size_t	committed;	/* Bytes committed from base. */
+	size_t	used;		/* Bytes allocated from base (the high-water mark). */
+};
+
+int		vmem_init(struct vmem *vm, size_t reserve);
+void	vmem_free(struct vmem *vm);
+void*	vmem_alloc(struct vmem *vm, size_t size, size_t align);
+
+#endif